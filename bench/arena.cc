@@ -0,0 +1,124 @@
+///
+/// \file bench/arena.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Benchmark Arena bump allocation against new/delete.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <scsl/Arena.h>
+#include <scsl/Flags.h>
+
+#include "bench.h"
+
+
+using namespace scsl;
+
+
+// Each simulated request makes allocsPerRequest small allocations of
+// varying size, then releases all of them.
+static constexpr size_t	allocsPerRequest = 64;
+static constexpr size_t	maxAllocSize = 96;
+static volatile uint8_t	sink;
+
+
+static size_t
+allocSize(size_t i)
+{
+	return 8 + ((i * 37) % maxAllocSize);
+}
+
+
+static void
+benchNewDelete(size_t requests)
+{
+	std::vector<uint8_t *> ptrs(allocsPerRequest);
+
+	for (size_t r = 0; r < requests; r++) {
+		for (size_t i = 0; i < allocsPerRequest; i++) {
+			ptrs[i] = new uint8_t[allocSize(i)];
+			ptrs[i][0] = static_cast<uint8_t>(i);
+		}
+
+		for (size_t i = 0; i < allocsPerRequest; i++) {
+			sink = ptrs[i][0];
+			delete[] ptrs[i];
+		}
+	}
+}
+
+
+static void
+benchArena(Arena &arena, size_t requests)
+{
+	std::vector<uint8_t *> ptrs(allocsPerRequest);
+
+	for (size_t r = 0; r < requests; r++) {
+		auto mark = arena.Mark();
+		for (size_t i = 0; i < allocsPerRequest; i++) {
+			ptrs[i] = static_cast<uint8_t *>(arena.Alloc(allocSize(i)));
+			ptrs[i][0] = static_cast<uint8_t>(i);
+		}
+
+		for (size_t i = 0; i < allocsPerRequest; i++) {
+			sink = ptrs[i][0];
+		}
+		arena.Rewind(mark);
+	}
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int	requests = 100000;
+	auto		flags = new scsl::Flags("bench_arena",
+					"Compare Arena allocation to new/delete.");
+	flags->Register("-r", requests, "number of simulated requests");
+
+	auto parsed = flags->Parse(argc, argv);
+	if (parsed != scsl::Flags::ParseStatus::OK) {
+		std::cerr << "Failed to parse flags: "
+			  << scsl::Flags::ParseStatusToString(parsed) << "\n";
+		exit(1);
+	}
+	flags->GetUnsignedInteger("-r", requests);
+	delete flags;
+
+	Arena	arena;
+	size_t	n = static_cast<size_t>(requests);
+	if (arena.SetAlloc(allocsPerRequest * (maxAllocSize + 16) * 2) != 0) {
+		std::cerr << "[!] failed to set up arena\n";
+		exit(1);
+	}
+
+	auto allocs = n * allocsPerRequest;
+	scbench::Report("new/delete", allocs, scbench::Time([n]() {
+		benchNewDelete(n);
+	}));
+	scbench::Report("Arena::Alloc", allocs, scbench::Time([&arena, n]() {
+		benchArena(arena, n);
+	}));
+
+	return 0;
+}
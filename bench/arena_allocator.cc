@@ -0,0 +1,165 @@
+///
+/// \file bench/arena_allocator.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Benchmark ArenaAllocator on a container-heavy workload.
+///
+/// The workload mirrors SimpleConfig::Load: a configuration file is split
+/// into lines, and each key=value line is stored in a map. It's run once
+/// with the standard allocator and once with an ArenaAllocator whose arena
+/// is reset after every load.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <scsl/Arena.h>
+#include <scsl/ArenaAllocator.h>
+#include <scsl/Flags.h>
+
+#include "bench.h"
+
+
+using namespace scsl;
+
+
+static volatile size_t	sink;
+
+
+/// loadConfig splits text into lines and stores every key=value pair.
+template<typename String, typename Lines, typename Map>
+static void
+loadConfig(const std::string &text, Lines &lines, Map &config,
+	   const typename String::allocator_type &alloc)
+{
+	size_t	start = 0;
+
+	while (start < text.size()) {
+		auto end = text.find('\n', start);
+		if (end == std::string::npos) {
+			end = text.size();
+		}
+		lines.emplace_back(text.data() + start, end - start, alloc);
+		start = end + 1;
+	}
+
+	for (auto &line : lines) {
+		auto eq = line.find('=');
+		if (line.empty() || line[0] == '#' || eq == String::npos) {
+			continue;
+		}
+
+		config.emplace(String(line, 0, eq, alloc),
+			       String(line, eq + 1, String::npos, alloc));
+	}
+	sink = config.size();
+}
+
+
+static std::string
+buildConfig(size_t keys)
+{
+	std::string	text = "# generated configuration\n";
+
+	for (size_t i = 0; i < keys; i++) {
+		text += "configuration_key_number_" + std::to_string(i) +
+			"=a configuration value long enough to allocate " +
+			std::to_string(i * 7) + "\n";
+	}
+
+	return text;
+}
+
+
+static void
+benchStd(const std::string &text, size_t loads)
+{
+	std::allocator<char>	alloc;
+
+	for (size_t i = 0; i < loads; i++) {
+		std::vector<std::string>		lines;
+		std::map<std::string, std::string>	config;
+
+		loadConfig<std::string>(text, lines, config, alloc);
+	}
+}
+
+
+static void
+benchArena(Arena &arena, const std::string &text, size_t loads)
+{
+	using ArenaString = std::basic_string<char, std::char_traits<char>,
+					      ArenaAllocator<char>>;
+	using Pair = std::pair<const ArenaString, ArenaString>;
+
+	ArenaAllocator<char>	alloc(arena);
+
+	for (size_t i = 0; i < loads; i++) {
+		{
+			std::vector<ArenaString, ArenaAllocator<ArenaString>>	lines(alloc);
+			std::map<ArenaString, ArenaString, std::less<ArenaString>,
+				 ArenaAllocator<Pair>>				config(alloc);
+
+			loadConfig<ArenaString>(text, lines, config, alloc);
+		}
+		arena.Reset();
+	}
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int	loads = 2000;
+	unsigned int	keys = 64;
+	auto		flags = new scsl::Flags("bench_arena_allocator",
+						"Compare ArenaAllocator to std::allocator.");
+	flags->Register("-k", keys, "number of keys in the configuration");
+	flags->Register("-l", loads, "number of times to load the configuration");
+
+	auto parsed = flags->Parse(argc, argv);
+	if (parsed != scsl::Flags::ParseStatus::OK) {
+		std::cerr << "Failed to parse flags: "
+			  << scsl::Flags::ParseStatusToString(parsed) << "\n";
+		exit(1);
+	}
+	flags->GetUnsignedInteger("-k", keys);
+	flags->GetUnsignedInteger("-l", loads);
+	delete flags;
+
+	Arena	arena;
+	auto	text = buildConfig(keys);
+	if (arena.SetChunked(64 * 1024) != 0) {
+		std::cerr << "[!] failed to set up arena\n";
+		exit(1);
+	}
+
+	scbench::Report("std::allocator", loads, scbench::Time([&]() {
+		benchStd(text, loads);
+	}));
+	scbench::Report("ArenaAllocator", loads, scbench::Time([&]() {
+		benchArena(arena, text, loads);
+	}));
+
+	return 0;
+}
@@ -0,0 +1,70 @@
+///
+/// \file bench/bench.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Minimal timing helpers shared by the benchmarks.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#ifndef SCSL_BENCH_H
+#define SCSL_BENCH_H
+
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+
+namespace scbench {
+
+
+/// Time runs fn once and returns the wall-clock time it took.
+static std::chrono::duration<double, std::milli>
+Time(const std::function<void()> &fn)
+{
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	return std::chrono::steady_clock::now() - start;
+}
+
+
+/// Report prints the total time and the per-operation cost of a run.
+static void
+Report(const std::string &label, size_t ops,
+       std::chrono::duration<double, std::milli> elapsed)
+{
+	double perOp = 0.0;
+
+	if (ops > 0) {
+		perOp = (elapsed.count() * 1000000.0) / static_cast<double>(ops);
+	}
+
+	std::cout << std::left << std::setw(24) << label << std::right
+		  << std::setw(12) << std::fixed << std::setprecision(3)
+		  << elapsed.count() << "ms" << std::setw(12) << perOp
+		  << "ns/op (" << ops << " ops)\n";
+}
+
+
+} // namespace scbench
+
+
+#endif // SCSL_BENCH_H
@@ -0,0 +1,135 @@
+///
+/// \file bench/flush.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Benchmark the cost of flushing a memory-mapped arena.
+///
+/// Records are written into a memory-mapped arena in batches, and the dirty
+/// range is flushed after each batch. This shows how the flush cost is
+/// amortized as batches grow, compared to rewriting the whole arena with
+/// Arena::Write.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include <scsl/Arena.h>
+#include <scsl/Flags.h>
+#include <scsl/TLV.h>
+
+#include "bench.h"
+
+
+using namespace scsl;
+
+
+static const char	*benchFile = "bench_flush.bin";
+static const char	*benchCopy = "bench_flush.copy";
+static const char	 benchVal[] = "a record of a reasonable length";
+
+
+static bool
+writeBatches(Arena &arena, size_t records, size_t batch, ArenaFlush mode,
+	     bool rewrite, ArenaWrite writeMode)
+{
+	TLV::Record	 rec;
+	uint8_t		*cursor = arena.Start();
+
+	TLV::SetRecord(rec, 1, sizeof(benchVal), benchVal);
+	for (size_t i = 0; i < records; i++) {
+		cursor = TLV::WriteToMemory(arena, cursor, rec);
+		if (cursor == nullptr) {
+			return false;
+		}
+
+		if (((i + 1) % batch) != 0) {
+			continue;
+		}
+
+		if (rewrite) {
+			if (arena.Write(benchCopy, writeMode) != 0) {
+				return false;
+			}
+		} else if (arena.FlushDirty(mode) != 0) {
+			return false;
+		}
+	}
+
+	return arena.Barrier() == 0;
+}
+
+
+static void
+run(const std::string &label, size_t records, size_t batch, ArenaFlush mode,
+    bool rewrite, ArenaWrite writeMode = ArenaWrite::Full)
+{
+	Arena	arena;
+	bool	ok = true;
+	size_t	arenaSize = records * (sizeof(benchVal) + 2) + 1;
+
+	if (arena.Create(benchFile, arenaSize) != 0) {
+		std::cerr << "[!] failed to create " << benchFile << "\n";
+		exit(1);
+	}
+
+	auto elapsed = scbench::Time([&]() {
+		ok = writeBatches(arena, records, batch, mode, rewrite,
+				  writeMode);
+	});
+	if (!ok) {
+		std::cerr << "[!] " << label << " failed\n";
+		exit(1);
+	}
+
+	scbench::Report(label + "/" + std::to_string(batch), records, elapsed);
+	arena.Destroy();
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int	records = 4096;
+	auto		flags = new scsl::Flags("bench_flush",
+						"Measure arena flush cost against batch size.");
+	flags->Register("-r", records, "number of records to write");
+
+	auto parsed = flags->Parse(argc, argv);
+	if (parsed != scsl::Flags::ParseStatus::OK) {
+		std::cerr << "Failed to parse flags: "
+			  << scsl::Flags::ParseStatusToString(parsed) << "\n";
+		exit(1);
+	}
+	flags->GetUnsignedInteger("-r", records);
+	delete flags;
+
+	for (size_t batch = 1; batch <= records; batch *= 8) {
+		run("FlushDirty(sync)", records, batch, ArenaFlush::Sync, false);
+		run("FlushDirty(async)", records, batch, ArenaFlush::Async, false);
+		run("Write", records, batch, ArenaFlush::Sync, true);
+		run("Write(used)", records, batch, ArenaFlush::Sync, true,
+		    ArenaWrite::Used);
+	}
+
+	remove(benchFile);
+	remove(benchCopy);
+	return 0;
+}
@@ -0,0 +1,263 @@
+///
+/// \file bench/tlv.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Benchmark common operations on TLV records in an arena.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+
+#include <iostream>
+#include <string>
+
+#include <scsl/Arena.h>
+#include <scsl/Dictionary.h>
+#include <scsl/Flags.h>
+#include <scsl/TLV.h>
+
+#include "bench.h"
+
+
+using namespace scsl;
+
+
+static const char	benchVal[] = "a record of a reasonable length";
+
+
+static void
+setupArena(Arena &arena, size_t records, bool region)
+{
+	if (arena.SetAlloc(records * 64 + TLV::REGION_SIZE + 1) != 0) {
+		std::cerr << "[!] failed to set up arena\n";
+		exit(1);
+	}
+
+	if (region && (TLV::InitRegion(arena) != 0)) {
+		std::cerr << "[!] failed to add a region header\n";
+		exit(1);
+	}
+}
+
+
+static void
+benchAppend(const std::string &label, size_t records, bool region)
+{
+	Arena		arena;
+	TLV::Record	rec;
+
+	setupArena(arena, records, region);
+	TLV::SetRecord(rec, 1, sizeof(benchVal), benchVal);
+	scbench::Report(label, records, scbench::Time([&]() {
+		for (size_t i = 0; i < records; i++) {
+			if (TLV::WriteToMemory(arena, nullptr, rec) == nullptr) {
+				std::cerr << "[!] " << label << " failed\n";
+				exit(1);
+			}
+		}
+	}));
+}
+
+
+static void
+benchBatch(const std::string &label, size_t records, bool region)
+{
+	Arena				arena;
+	std::vector<TLV::Record>	recs(records);
+
+	setupArena(arena, records, region);
+	for (auto &rec : recs) {
+		TLV::SetRecord(rec, 1, sizeof(benchVal), benchVal);
+	}
+
+	scbench::Report(label, records, scbench::Time([&]() {
+		if (TLV::WriteBatch(arena, recs.data(), records) == nullptr) {
+			std::cerr << "[!] " << label << " failed\n";
+			exit(1);
+		}
+	}));
+}
+
+
+static void
+benchDictionary(const std::string &label, size_t records, bool region)
+{
+	Arena	arena;
+
+	setupArena(arena, records, region);
+	Dictionary	dict(arena);
+	scbench::Report(label, records, scbench::Time([&]() {
+		for (size_t i = 0; i < records; i++) {
+			auto	key = std::to_string(i);
+			auto	klen = static_cast<uint8_t>(key.size());
+			if (dict.Set(key.c_str(), klen, benchVal,
+				     sizeof(benchVal)) != 0) {
+				std::cerr << "[!] " << label << " failed\n";
+				exit(1);
+			}
+		}
+	}));
+}
+
+
+static void
+benchDelete(const std::string &label, size_t records, bool tombstone)
+{
+	Arena		arena;
+	TLV::Record	rec;
+
+	setupArena(arena, records, true);
+	TLV::SetRecord(rec, 1, sizeof(benchVal), benchVal);
+	for (size_t i = 0; i < records; i++) {
+		if (TLV::WriteToMemory(arena, nullptr, rec) == nullptr) {
+			std::cerr << "[!] " << label << " failed\n";
+			exit(1);
+		}
+	}
+
+	// Delete every other record, starting from the front, which is the
+	// worst case for shifting the records down.
+	auto	stride = sizeof(benchVal) + 2;
+	scbench::Report(label, records / 2, scbench::Time([&]() {
+		auto	*cursor = TLV::FirstRecord(arena);
+		for (size_t i = 0; i < records / 2; i++) {
+			if (tombstone) {
+				TLV::TombstoneRecord(arena, cursor);
+				cursor += 2 * stride;
+			} else {
+				TLV::DeleteRecord(arena, cursor);
+				cursor += stride;
+			}
+		}
+
+		if (tombstone) {
+			TLV::Compact(arena);
+		}
+	}));
+}
+
+
+static void
+benchVerify(const std::string &label, size_t records, uint16_t flags)
+{
+	Arena		arena;
+	TLV::Record	rec;
+	bool		ok = false;
+
+	if ((arena.SetAlloc(records * (64 + TLV::CHECKSUM_SIZE) +
+			    TLV::REGION_SIZE + 1) != 0) ||
+	    (TLV::InitRegion(arena, flags) != 0)) {
+		std::cerr << "[!] failed to set up arena\n";
+		exit(1);
+	}
+
+	TLV::SetRecord(rec, 1, sizeof(benchVal), benchVal);
+	for (size_t i = 0; i < records; i++) {
+		if (TLV::WriteToMemory(arena, nullptr, rec) == nullptr) {
+			std::cerr << "[!] " << label << " failed\n";
+			exit(1);
+		}
+	}
+
+	scbench::Report(label, records, scbench::Time([&]() {
+		ok = TLV::Verify(arena);
+	}));
+	if (!ok) {
+		std::cerr << "[!] " << label << " failed\n";
+		exit(1);
+	}
+}
+
+
+static void
+benchScan(const std::string &label, size_t records, size_t threads)
+{
+	Arena				arena;
+	std::vector<TLV::Record>	recs(records);
+	std::atomic<size_t>		visited(0);
+	bool				ok = false;
+
+	if ((arena.SetAlloc(records * (TLV::TLV_MAX_LEN + 16) +
+			    TLV::REGION_SIZE + 1) != 0) ||
+	    (TLV::InitRegion(arena, TLV::REGION_SYNC |
+				    TLV::REGION_CHECKSUMS) != 0)) {
+		std::cerr << "[!] failed to set up arena\n";
+		exit(1);
+	}
+
+	for (auto &rec : recs) {
+		rec.Tag = 1;
+		rec.Len = TLV::TLV_MAX_LEN;
+		memset(rec.Val, 0x42, rec.Len);
+	}
+	if (TLV::WriteBatch(arena, recs.data(), records) == nullptr) {
+		std::cerr << "[!] " << label << " failed\n";
+		exit(1);
+	}
+
+	scbench::Report(label, records, scbench::Time([&]() {
+		ok = TLV::ParallelScan(arena,
+		    [&visited](const TLV::RecordView &, size_t) {
+			visited.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		    }, threads);
+	}));
+	if (!ok || (visited != records)) {
+		std::cerr << "[!] " << label << " failed\n";
+		exit(1);
+	}
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int	records = 8192;
+	auto		flags = new scsl::Flags("bench_tlv",
+						"Measure the cost of common TLV operations.");
+	flags->Register("-r", records, "number of records to write");
+
+	auto parsed = flags->Parse(argc, argv);
+	if (parsed != scsl::Flags::ParseStatus::OK) {
+		std::cerr << "Failed to parse flags: "
+			  << scsl::Flags::ParseStatusToString(parsed) << "\n";
+		exit(1);
+	}
+	flags->GetUnsignedInteger("-r", records);
+	delete flags;
+
+	benchAppend("append", records, false);
+	benchAppend("append(region)", records, true);
+	benchBatch("WriteBatch", records, false);
+	benchBatch("WriteBatch(region)", records, true);
+	benchDictionary("Dictionary::Set", records, false);
+	benchDictionary("Dictionary::Set(region)", records, true);
+	benchDelete("DeleteRecord", records, false);
+	benchDelete("Tombstone+Compact", records, true);
+	benchVerify("Verify", records * 64, 0);
+	benchVerify("Verify(checksums)", records * 64, TLV::REGION_CHECKSUMS);
+	benchScan("ParallelScan(1)", records * 32, 1);
+	benchScan("ParallelScan", records * 32, 0);
+	return 0;
+}
@@ -26,6 +26,8 @@
 #define KIMODEM_ARENA_H
 
 
+#include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
@@ -58,6 +60,179 @@ enum class ArenaType
 	Alloc,
 	/// MemoryMapped is an arena backed by a memory-mapped file.
 	MemoryMapped,
+	/// Chunked is an arena backed by a chain of allocated chunks that
+	/// grows as #Alloc needs more memory; TLV records don't grow it.
+	Chunked,
+	/// SharedMemory is an arena backed by anonymous shared memory that
+	/// other processes can map.
+	SharedMemory,
+	/// Ring is a circular buffer whose memory is mapped twice, back to
+	/// back, so that data wrapping past the end is still contiguous.
+	Ring,
+};
+
+
+/// \enum ArenaAccess
+///
+/// ArenaAccess describes how the memory in an \class Arena is expected to be
+/// accessed, and is passed to the kernel as a hint.
+enum class ArenaAccess
+    : uint8_t {
+	/// Normal gives no particular hint.
+	Normal,
+	/// Sequential memory is read from start to finish, so the kernel
+	/// should read ahead aggressively.
+	Sequential,
+	/// Random memory is read in no particular order, so read-ahead is
+	/// wasted.
+	Random,
+};
+
+
+/// \enum ArenaNuma
+///
+/// ArenaNuma describes where an \class Arena's memory should be placed on a
+/// machine with more than one NUMA node.
+enum class ArenaNuma
+    : uint8_t {
+	/// Default leaves placement to the kernel, which normally puts
+	/// each page on the node of the thread that first touches it.
+	Default,
+	/// Bind places all of the memory on ArenaOptions::NumaNode.
+	Bind,
+	/// Preferred places the memory on ArenaOptions::NumaNode when it
+	/// has free memory, and elsewhere when it doesn't.
+	Preferred,
+	/// Interleave spreads the memory across every node a page at a
+	/// time, so that threads on all nodes see the same average
+	/// latency.
+	Interleave,
+};
+
+
+/// \enum ArenaFlush
+///
+/// ArenaFlush selects whether Arena::Flush waits for data to be written.
+enum class ArenaFlush
+    : uint8_t {
+	/// Sync waits until the data has been written to the backing file.
+	Sync,
+	/// Async schedules the write and returns immediately.
+	Async,
+};
+
+
+/// \enum ArenaWrite
+///
+/// ArenaWrite selects how much of the arena Arena::Write copies.
+enum class ArenaWrite
+    : uint8_t {
+	/// Full copies the whole arena.
+	Full,
+	/// Used copies only the arena's memory below its high-water mark;
+	/// the rest of the file is left as a hole that reads back as
+	/// zeroes, which is what the arena holds there.
+	Used,
+};
+
+
+/// \brief Options for setting up an Arena's backing memory.
+///
+/// Most of these are hints to the kernel about how the memory will be used,
+/// and are only acted on for allocated and memory-mapped arenas on
+/// platforms that support them. The defaults leave the memory alone. Hints
+/// the kernel rejects are ignored; only a failure to lock the memory is
+/// treated as an error.
+///
+/// ReadOnly and Private change how a file is mapped, and only apply to
+/// memory-mapped arenas.
+struct ArenaOptions {
+	/// Prefault faults in every page when the arena is set up, so
+	/// that the first access doesn't take a page fault.
+	bool		Prefault = false;
+	/// HugePages asks the kernel to back the arena with transparent
+	/// huge pages.
+	bool		HugePages = false;
+	/// WillNeed asks the kernel to start reading the arena in ahead
+	/// of use.
+	bool		WillNeed = false;
+	/// Lock locks the arena into memory so it is never paged out.
+	bool		Lock = false;
+	/// Access describes the expected access pattern.
+	ArenaAccess	Access = ArenaAccess::Normal;
+	/// ReadOnly opens and maps the file read-only. TLV and Dictionary
+	/// writes to a read-only arena fail.
+	bool		ReadOnly = false;
+	/// Private maps the file copy-on-write (MAP_PRIVATE): changes made
+	/// through the arena are never written back to the file. Pages
+	/// the arena hasn't written to may still show changes other
+	/// processes make to the file; use Arena::Snapshot for a stable
+	/// image.
+	bool		Private = false;
+	/// Numa selects which NUMA node the memory is placed on. This
+	/// is ignored on machines with a single node, and if the kernel
+	/// rejects the policy. The policy takes effect as pages are
+	/// faulted in, so it applies to allocated and shared memory
+	/// arenas; file pages already in the page cache stay where they
+	/// are.
+	ArenaNuma	Numa = ArenaNuma::Default;
+	/// NumaNode is the node used by the Bind and Preferred policies.
+	unsigned int	NumaNode = 0;
+};
+
+
+/// \brief A snapshot of an Arena's usage and activity.
+///
+/// The sizes describe the arena at the time Arena::Stats was called. The
+/// counters and times accumulate from when the arena was set up, or from
+/// the last call to Arena::ResetStats, and only count calls that did
+/// something.
+struct ArenaStats {
+	/// Size is the size of the arena's contiguous memory.
+	size_t		Size = 0;
+	/// Reserved is the total backing memory held by the arena.
+	size_t		Reserved = 0;
+	/// Used is the number of bytes currently handed out by Alloc.
+	size_t		Used = 0;
+	/// HighWater is the arena's high-water mark.
+	size_t		HighWater = 0;
+
+	/// Allocs counts successful calls to Alloc.
+	uint64_t	Allocs = 0;
+	/// FailedAllocs counts calls to Alloc that returned nullptr.
+	uint64_t	FailedAllocs = 0;
+	/// AllocBytes is the total number of bytes requested from Alloc.
+	uint64_t	AllocBytes = 0;
+	/// PaddingBytes is the total number of bytes Alloc skipped over to
+	/// align allocations or move to a new chunk. Compared against
+	/// AllocBytes, it shows how much of the arena is lost to
+	/// fragmentation.
+	uint64_t	PaddingBytes = 0;
+	/// Grows counts the times the arena was grown, including new chunks
+	/// added to a chunked arena.
+	uint64_t	Grows = 0;
+
+	/// Clears counts calls to Clear.
+	uint64_t			Clears = 0;
+	/// ClearTime is the time spent in Clear.
+	std::chrono::nanoseconds	ClearTime{0};
+	/// Writes counts calls to Write.
+	uint64_t			Writes = 0;
+	/// WriteTime is the time spent in Write.
+	std::chrono::nanoseconds	WriteTime{0};
+	/// Flushes counts flushes and barriers that reached the backing
+	/// file.
+	uint64_t			Flushes = 0;
+	/// FlushTime is the time spent in flushes and barriers.
+	std::chrono::nanoseconds	FlushTime{0};
+
+	/// Pages is the number of pages spanned by a page-aligned arena
+	/// (allocated, memory-mapped, shared memory or ring). It is zero
+	/// for other arena types, or if residency couldn't be determined.
+	size_t		Pages = 0;
+	/// ResidentPages is the number of those pages that are resident in
+	/// memory, as reported by mincore(2).
+	size_t		ResidentPages = 0;
 };
 
 
@@ -71,6 +246,12 @@ enum class ArenaType
 /// SetAlloc) or one of the file-based options (Create, Open, MemoryMap). At
 /// this point, no further memory management should be done until the end of the
 /// arena's life, At which point Destroy should be called.
+///
+/// Alternatively, the arena can be used as a bump allocator: #Alloc hands out
+/// aligned chunks of the arena's memory by advancing an internal offset, and
+/// #Mark, #Rewind, and #Reset release them in O(1). This works the same way
+/// regardless of the backing memory. The bump allocator knows nothing about
+/// TLV records; an arena should be used for one or the other, not both.
 class Arena {
 public:
 	/// An Arena is initialized with no backing memory.
@@ -90,13 +271,123 @@ public:
 	int SetStatic(uint8_t *mem, size_t memSize);
 
 	/// SetAlloc allocates a chunk of memory for the arena; the arena takes
-	/// ownership. If the arena is already backed, then #Destroy will be
-	/// called first.
+	/// ownership. The memory is zero-filled by the kernel as it is first
+	/// used, so setting up a large arena doesn't touch every page. If the
+	/// arena is already backed, then #Destroy will be called first.
 	///
-	/// \param allocSize The size of memory to allocate.
+	/// \param allocSize The size of memory to allocate; this must not
+	///    be zero.
+	/// \param options Hints for how the memory will be used.
 	/// \return Returns 0 on success and -1 on error.
-	int SetAlloc(size_t allocSize);
+	int SetAlloc(size_t allocSize,
+		     const ArenaOptions &options = ArenaOptions());
+
+	/// SetChunked backs the arena with a chain of allocated chunks; the
+	/// arena takes ownership. When #Alloc can't satisfy a request from
+	/// the current chunk, a new chunk is added to the chain. Chunks are
+	/// never moved or copied, so pointers returned from #Alloc remain
+	/// valid as the arena grows. Chunks released by #Rewind or #Reset
+	/// are kept for reuse until #Destroy is called.
+	///
+	/// Only #Alloc grows the arena: #Start, #End, #Size and #Write refer
+	/// to the first chunk, which is the contiguous region used by TLV
+	/// records. TLV and Dictionary writes still fail once the first
+	/// chunk is full, so a chunked arena isn't a fix for TLV stores that
+	/// run out of space; for those, use a memory-mapped or shared memory
+	/// arena with #EnableAutoGrow, which grows it in place with #Grow.
+	///
+	/// If the arena is already backed, then #Destroy will be called
+	/// first.
+	///
+	/// \param chunkSize The size of the first chunk.
+	/// \param growth Each new chunk is this many times larger than the
+	///    previous one; 1 gives fixed-size chunks.
+	/// \param limit The maximum number of bytes the arena may reserve
+	///    across all chunks, or 0 for no limit.
+	/// \return Returns 0 on success and -1 on error.
+	int SetChunked(size_t chunkSize, unsigned int growth = 2,
+		       size_t limit = 0);
+
+
+	/// SetRing backs the arena with a circular buffer for streaming
+	/// data from a producer to a consumer. The buffer's memory is
+	/// mapped twice, back to back, so a write or read of up to #Size
+	/// bytes starting anywhere in the first copy is contiguous, even
+	/// if it wraps past the end; no split copies are needed. The ring
+	/// is used through #RingReserve and #RingCommit on the producer
+	/// side, and #RingPeek and #RingConsume on the consumer side. One
+	/// producer thread and one consumer thread may use the ring at the
+	/// same time without locking. If the arena is already backed, then
+	/// #Destroy will be called first.
+	///
+	/// \param ringSize The size of the ring; this is rounded up to a
+	///    whole number of pages, and must not be zero.
+	/// \return Returns 0 on success and -1 on error.
+	int SetRing(size_t ringSize);
+
+	/// RingReserve returns a pointer to len contiguous bytes of free
+	/// space at the tail of a ring arena. Nothing is added to the ring
+	/// until #RingCommit is called.
+	///
+	/// \param len The number of bytes to reserve.
+	/// \return A pointer to the free space, or nullptr if this isn't a
+	///    ring arena or there isn't enough free space.
+	uint8_t	*RingReserve(size_t len);
+
+	/// RingCommit adds len bytes, written to the space returned by
+	/// #RingReserve, to the tail of the ring.
+	///
+	/// \param len The number of bytes written.
+	/// \return Returns 0 on success and -1 if there isn't that much
+	///    free space.
+	int	 RingCommit(size_t len);
+
+	/// RingPeek returns a pointer to the len contiguous bytes at the
+	/// head of a ring arena, without removing them.
+	///
+	/// \param len The number of bytes to look at.
+	/// \return A pointer to the data, or nullptr if this isn't a ring
+	///    arena or there are fewer than len bytes in the ring.
+	uint8_t	*RingPeek(size_t len);
+
+	/// RingConsume removes len bytes from the head of the ring.
+	///
+	/// \param len The number of bytes to remove.
+	/// \return Returns 0 on success and -1 if there aren't that many
+	///    bytes in the ring.
+	int	 RingConsume(size_t len);
 
+	/// RingWrite copies len bytes onto the tail of the ring.
+	///
+	/// \param data The data to copy.
+	/// \param len The number of bytes to copy.
+	/// \return Returns 0 on success and -1 if there isn't enough free
+	///    space.
+	int	 RingWrite(const uint8_t *data, size_t len);
+
+	/// RingRead copies len bytes from the head of the ring and removes
+	/// them.
+	///
+	/// \param data The buffer to copy the data into.
+	/// \param len The number of bytes to copy.
+	/// \return Returns 0 on success and -1 if there aren't that many
+	///    bytes in the ring.
+	int	 RingRead(uint8_t *data, size_t len);
+
+	/// RingUsed returns the number of bytes waiting in the ring.
+	///
+	/// \return The number of bytes between the head and tail.
+	size_t RingUsed() const
+	{ return this->ringTail.load(std::memory_order_acquire) -
+		 this->ringHead.load(std::memory_order_acquire); }
+
+	/// RingFree returns the number of bytes that can be added to the
+	/// ring.
+	///
+	/// \return The free space in the ring.
+	size_t RingFree() const
+	{ return (this->arenaType == ArenaType::Ring) ?
+		 this->size - this->RingUsed() : 0; }
 
 	/// MemoryMap points the arena to a memory-mapped file. This is
 	/// currently only supported on Linux. If the arena is already backed,
@@ -104,13 +395,16 @@ public:
 	///
 	/// \param memFileDes File descriptor to map into memory.
 	/// \param memSize The size of memory to map.
+	/// \param options Hints for how the memory will be used.
 	/// \return Returns 0 on success and -1 on error.
 #if defined(__posix__) || defined(__linux__) || defined(__APPLE__)
-	int 	 MemoryMap(int memFileDes, size_t memSize);
+	int 	 MemoryMap(int memFileDes, size_t memSize,
+			   const ArenaOptions &options = ArenaOptions());
 #else
 
-	int MemoryMap(int memFileDes, size_t memSize)
-	{ (void)memFileDes; (void)memSize; throw NotImplemented("WIN32"); }
+	int MemoryMap(int memFileDes, size_t memSize,
+		      const ArenaOptions &options = ArenaOptions())
+	{ (void)memFileDes; (void)memSize; (void)options; throw NotImplemented("WIN32"); }
 
 #endif
 	/// Create creates a new file, truncating it if it already exists. On
@@ -120,8 +414,10 @@ public:
 	///
 	/// \param path The path to the file that should be created.
 	/// \param fileSize The size of the file to create.
+	/// \param options Hints for how the memory will be used.
 	/// \return Returns 0 on success and -1 on error.
-	int	 Create(const char *path, size_t fileSize);
+	int	 Create(const char *path, size_t fileSize,
+			const ArenaOptions &options = ArenaOptions());
 
 	/// Open reads a file into the arena; the file must already exist. On
 	/// Unix-based platforms, the arena will be backed by a memory via
@@ -131,8 +427,165 @@ public:
 	/// sync changes to disk.
 	///
 	/// \param path The path to the file to be loaded.
+	/// \param options Hints for how the memory will be used.
 	/// \return Returns 0 on success and -1 on error.
-	int 	 Open(const char *path);
+	int 	 Open(const char *path,
+		      const ArenaOptions &options = ArenaOptions());
+
+	/// Snapshot maps a point-in-time, read-only image of a file into
+	/// the arena. The file is mapped privately and every page is
+	/// copied on write as it's mapped, so changes other processes make
+	/// to the file afterwards aren't seen and no locks are needed. This
+	/// costs memory equal to the file's size, but no file I/O beyond
+	/// what the page cache already holds. Writers that are part-way
+	/// through an update when the snapshot is taken may leave it
+	/// inconsistent at the page level.
+	///
+	/// If the arena is already backed, then #Destroy will be called
+	/// first.
+	///
+	/// \param path The path to the file to snapshot.
+	/// \param options Hints for how the memory will be used; the
+	///    ReadOnly and Private options are set automatically.
+	/// \return Returns 0 on success and -1 on error.
+	int	 Snapshot(const char *path,
+			  const ArenaOptions &options = ArenaOptions());
+
+#if defined(__posix__) || defined(__linux__) || defined(__APPLE__)
+	/// CreateShared backs the arena with a new block of shared memory
+	/// that other processes can map with #OpenShared or #MapShared.
+	/// Nothing is written to a filesystem: without a name, the memory
+	/// comes from memfd_create(2) (or an immediately unlinked POSIX
+	/// shared memory object where that isn't available) and can only
+	/// be shared by passing the descriptor returned by #Descriptor, e.g.
+	/// across fork(2) or over a Unix socket; the descriptor is closed
+	/// on exec(3), so clear FD_CLOEXEC before handing it to a program
+	/// that is exec'd. With a name, a POSIX shared memory object is
+	/// created with shm_open(3), replacing any existing object with
+	/// that name; it stays around until #UnlinkShared is called. The
+	/// memory is zero-filled. If the arena is already backed, then
+	/// #Destroy will be called first.
+	///
+	/// \param name The name of the shared memory object, which should
+	///    start with a slash, or nullptr for an anonymous one.
+	/// \param memSize The size of the shared memory.
+	/// \param options Hints for how the memory will be used; ReadOnly
+	///    and Private are ignored.
+	/// \return Returns 0 on success and -1 on error.
+	int	 CreateShared(const char *name, size_t memSize,
+			      const ArenaOptions &options = ArenaOptions());
+
+	/// MapShared maps shared memory from a descriptor received from
+	/// another process. If the mapping succeeds, the arena takes
+	/// ownership of the descriptor and closes it in #Destroy. The size
+	/// is taken from the shared memory object.
+	///
+	/// \param memFileDes A descriptor for a memfd or shared memory
+	///    object.
+	/// \param options Hints for how the memory will be used; ReadOnly
+	///    maps it read-only, and Private maps it copy-on-write.
+	/// \return Returns 0 on success and -1 on error.
+	int	 MapShared(int memFileDes,
+			   const ArenaOptions &options = ArenaOptions());
+
+	/// OpenShared maps an existing named shared memory object created
+	/// by #CreateShared.
+	///
+	/// \param name The name of the shared memory object.
+	/// \param options Hints for how the memory will be used; ReadOnly
+	///    maps it read-only, and Private maps it copy-on-write.
+	/// \return Returns 0 on success and -1 on error.
+	int	 OpenShared(const char *name,
+			    const ArenaOptions &options = ArenaOptions());
+
+	/// UnlinkShared removes a named shared memory object. Arenas that
+	/// already have it mapped keep working, and the memory is freed
+	/// once the last of them is destroyed.
+	///
+	/// \param name The name of the shared memory object.
+	/// \return Returns 0 on success and -1 on error.
+	static int UnlinkShared(const char *name);
+#else
+
+	int CreateShared(const char *name, size_t memSize,
+			 const ArenaOptions &options = ArenaOptions())
+	{ (void)name; (void)memSize; (void)options; throw NotImplemented("WIN32"); }
+
+	int MapShared(int memFileDes,
+		      const ArenaOptions &options = ArenaOptions())
+	{ (void)memFileDes; (void)options; throw NotImplemented("WIN32"); }
+
+	int OpenShared(const char *name,
+		       const ArenaOptions &options = ArenaOptions())
+	{ (void)name; (void)options; throw NotImplemented("WIN32"); }
+
+	static int UnlinkShared(const char *name)
+	{ (void)name; throw NotImplemented("WIN32"); }
+
+#endif
+
+	/// NumaNodes returns the number of NUMA nodes on the machine;
+	/// nodes are numbered from 0 to NumaNodes() - 1. Machines without
+	/// NUMA support report a single node.
+	///
+	/// \return The number of NUMA nodes.
+	static unsigned int NumaNodes();
+
+	/// CurrentNumaNode returns the NUMA node the calling thread is
+	/// running on. The thread may be moved to another node at any
+	/// time, so this is only a hint.
+	///
+	/// \return The calling thread's NUMA node, or 0 if it can't be
+	///    determined.
+	static unsigned int CurrentNumaNode();
+
+	/// Descriptor returns the file descriptor backing a memory-mapped
+	/// or shared memory arena, which can be handed to another process
+	/// so that it can map the same memory with #MapShared.
+	///
+	/// \return The arena's file descriptor, or -1 if it doesn't have
+	///    one.
+	int Descriptor() const;
+
+	/// Grow extends a memory-mapped or shared memory arena so that it
+	/// is at least minSize bytes, extending the backing file and
+	/// remapping it. To keep repeated growth cheap, the arena at least
+	/// doubles in size. The new memory is zeroed, and the options the
+	/// arena was mapped with are applied to it on a best-effort basis;
+	/// if they can't be, the arena has still grown. Other arena types,
+	/// and read-only or private mappings, can't be grown. Other
+	/// processes sharing the memory only see the new space once they
+	/// map the arena again.
+	///
+	/// \warning The mapping may move when the arena grows, which
+	/// invalidates every pointer into the arena, including those
+	/// returned by #Alloc. Cursors must be saved as offsets from #Start
+	/// before growing and recomputed from the new #Start afterwards.
+	/// TLV and Dictionary functions that grow the arena do this
+	/// internally, and any cursor they return is valid after growth.
+	///
+	/// \param minSize The minimum size the arena should have.
+	/// \return Returns 0 on success and -1 on error.
+	int Grow(size_t minSize);
+
+	/// EnableAutoGrow allows TLV and Dictionary writes to call #Grow
+	/// when the arena runs out of space. It only has an effect on
+	/// arenas that can #Grow, and is disabled by default.
+	void EnableAutoGrow()
+	{ this->autoGrow = true; }
+
+	/// DisableAutoGrow stops writes from growing the arena.
+	void DisableAutoGrow()
+	{ this->autoGrow = false; }
+
+	/// AutoGrowIsEnabled returns true if the arena will grow when
+	/// writes run out of space.
+	///
+	/// \return True if the arena can be grown on demand.
+	bool AutoGrowIsEnabled() const
+	{ return this->autoGrow && ((this->arenaType == ArenaType::MemoryMapped) ||
+				    (this->arenaType == ArenaType::SharedMemory)) &&
+	      !this->options.ReadOnly && !this->options.Private; }
 
 	/// Start returns a pointer to the start of the memory in the arena.
 	///
@@ -159,6 +612,13 @@ public:
 	size_t Size() const
 	{ return this->size; }
 
+	/// Reserved returns the total amount of backing memory held by the
+	/// arena. This is the same as #Size except for chunked arenas,
+	/// where it includes every chunk in the chain.
+	///
+	/// \return The number of bytes reserved by the arena.
+	size_t Reserved() const;
+
 	/// Type returns an ArenaType describing the arena.
 	///
 	/// \return An ArenaType describing the backing memory for the arena.
@@ -169,22 +629,147 @@ public:
 	bool Ready() const
 	{ return this->Type() != ArenaType::Uninit; };
 
-	/// Clear zeroizes the memory in the arena.
+	/// Writable returns whether the arena's memory can be modified.
+	bool Writable() const
+	{ return this->Ready() && !this->options.ReadOnly; }
+
+	/// Clear zeroizes all of the memory in the arena. Large allocated
+	/// and memory-mapped arenas hand whole pages back to the kernel
+	/// (via MADV_DONTNEED or by punching a hole in the file) to be
+	/// zeroed lazily. Clearing a ring arena also empties the ring.
 	void Clear();
 
+	/// ClearUsed zeroizes the memory in the arena below the #HighWater
+	/// mark, so the cost depends on how much of the arena was used
+	/// rather than its size. Anything written through #Start without
+	/// a call to #MarkDirty isn't covered by the mark and may survive;
+	/// use #Clear when that matters.
+	void ClearUsed();
+
+	/// HighWater returns the offset just past the highest byte that
+	/// may have been written since the arena was set up or cleared.
+	/// Allocations, TLV writes, #MarkDirty and #operator[] raise it;
+	/// code that writes to the arena directly through #Start must call
+	/// #MarkDirty for #ClearUsed to see the write. Arenas set up over
+	/// existing memory (SetStatic, MemoryMap, Open) start with the
+	/// mark at the end of the arena.
+	///
+	/// \return The arena's high-water mark.
+	size_t HighWater() const
+	{ return this->highWater; }
+
+	/// Alloc carves out allocSize bytes of arena memory aligned to a
+	/// multiple of align. The memory is not cleared; if the arena was
+	/// rewound, it may contain data from previous allocations.
+	///
+	/// \param allocSize The number of bytes to allocate.
+	/// \param align The required alignment; this must be a power of two.
+	/// \return A pointer to the allocated memory, or nullptr if the
+	///    arena isn't ready or isn't writable, align isn't a power of
+	///    two, or there isn't enough space left in the arena.
+	void	*Alloc(size_t allocSize,
+		       size_t align = alignof(std::max_align_t));
+
+	/// Mark returns the current allocation offset, which can later be
+	/// passed to #Rewind to release everything allocated since.
+	///
+	/// \return The number of bytes currently allocated.
+	size_t Mark() const
+	{ return this->used; }
+
+	/// Rewind releases all allocations made since mark was taken. Marks
+	/// past the current allocation offset are ignored.
+	///
+	/// \param mark A value previously returned by #Mark.
+	void Rewind(size_t mark);
+
+	/// Reset releases every allocation made with #Alloc. It is
+	/// equivalent to Rewind(0), and does not clear the memory.
+	void Reset()
+	{ this->Rewind(0); }
+
+	/// Used returns the number of bytes handed out by #Alloc,
+	/// including any alignment padding. In a chunked arena, the unused
+	/// tail of a chunk that was skipped over also counts.
+	///
+	/// \return The number of bytes allocated from the arena.
+	size_t Used() const
+	{ return this->used; }
+
+	/// Stats reports how much of the arena is in use and what it has
+	/// been doing. Counting resident pages walks the arena's page
+	/// table, so this shouldn't be called on a hot path for very
+	/// large arenas.
+	///
+	/// \return A snapshot of the arena's statistics.
+	ArenaStats Stats() const;
+
+	/// ResetStats zeroes the arena's counters and times.
+	void ResetStats();
+
 	/// Destroy removes any backing memory (e.g. from SetAlloc or
 	/// MemoryMap). This does not call Clear; if the arena was backed by a
 	/// file that should be persisted, it would wipe out the file.
 	void Destroy();
 
+	/// Flush writes len bytes of the arena starting at offset back to
+	/// the arena's backing file. The range is widened to whole pages.
+	/// Arenas that aren't memory-mapped have no backing file, and
+	/// private mappings never write back to theirs, so flushing them
+	/// does nothing.
+	///
+	/// \param offset The offset of the first byte to flush.
+	/// \param len The number of bytes to flush.
+	/// \param mode Whether to wait for the write to finish.
+	/// \return Returns 0 on success and -1 on error, including if the
+	///    range extends past the end of the arena.
+	int Flush(size_t offset, size_t len,
+		  ArenaFlush mode = ArenaFlush::Sync);
+
+	/// MarkDirty records that a range of the arena has been modified
+	/// and should be written out by the next #FlushDirty. TLV writes
+	/// and deletes mark the ranges they touch. Marking a range dirty
+	/// also raises the #HighWater mark to cover it.
+	///
+	/// \param offset The offset of the first modified byte.
+	/// \param len The number of modified bytes.
+	void MarkDirty(size_t offset, size_t len);
+
+	/// FlushDirty flushes the range covering everything marked dirty
+	/// since the last successful FlushDirty. This lets a writer make a
+	/// batch of changes and then persist just the part of the arena
+	/// that changed.
+	///
+	/// \param mode Whether to wait for the write to finish.
+	/// \return Returns 0 on success and -1 on error.
+	int FlushDirty(ArenaFlush mode = ArenaFlush::Sync);
+
+	/// Barrier waits until every change to the arena, including any
+	/// asynchronous flushes, has reached stable storage along with the
+	/// backing file's size. Writes made after the barrier returns are
+	/// ordered after everything before it.
+	///
+	/// \return Returns 0 on success and -1 on error.
+	int Barrier();
+
 	/// Write dumps the arena to a file suitable for loading by Open.
+	/// The arena is written to a temporary file next to path, which is
+	/// synced to disk and then renamed over path, so a crash part-way
+	/// through leaves either the old file or the new one in place.
+	/// Memory-mapped and shared memory arenas are copied by the kernel
+	/// with copy_file_range(2) where it's supported; otherwise the
+	/// arena's memory is written directly, without buffering.
 	///
-	/// \warning DANGER: if arena is memory-mapped, DO NOT WRITE TO THE
-	/// BACKING FILE!
+	/// \note Writing to the arena's own backing file replaces the file
+	/// at path; the arena stays mapped to the old file, so later
+	/// changes to the arena won't appear in the new one.
 	///
-	/// \param path
+	/// \param path The path to write the arena to.
+	/// \param mode Whether to copy the whole arena or only the part
+	///    below the #HighWater mark. Either way, the file is the size
+	///    of the arena.
 	/// \return Returns 0 on success and -1 on error.
-	int Write(const char *path);
+	int Write(const char *path, ArenaWrite mode = ArenaWrite::Full);
 
 	/// This operator allows the data in the arena to be accessed
 	/// as if it were an array. If the index is out of bounds, it
@@ -197,10 +782,33 @@ public:
 	uint8_t &operator[](size_t index);
 
 private:
+	struct Chunk;
+
+	void	*allocChunked(size_t allocSize, size_t align);
+	bool	 growChunks(size_t minSize);
+	int	 applyOptions(uint8_t *mem, size_t len);
+	void	 clearRange(size_t offset, size_t len);
+	void	 clearTo(size_t clearSize);
+
 	uint8_t *store;
 	size_t size;
+	size_t used;
+	size_t highWater;
 	int fd;
 	ArenaType arenaType;
+
+	Chunk		*chunks;
+	Chunk		*current;
+	unsigned int	 growth;
+	size_t		 limit;
+	bool		 autoGrow;
+	ArenaOptions	 options;
+	size_t		 dirtyStart;
+	size_t		 dirtyEnd;
+	ArenaStats	 stats;
+
+	std::atomic<size_t>	ringHead;
+	std::atomic<size_t>	ringTail;
 };
 
 
@@ -220,6 +828,14 @@ private:
 std::ostream &operator<<(std::ostream &os, Arena &arena);
 
 
+/// Write ArenaStats out to the output stream, one statistic per line.
+///
+/// \param os
+/// \param stats
+/// \return
+std::ostream &operator<<(std::ostream &os, const ArenaStats &stats);
+
+
 } // namespace scsl
 
 
@@ -0,0 +1,133 @@
+///
+/// \file include/scsl/ArenaAllocator.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Standard library allocator backed by an Arena.
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that
+/// the above copyright notice and this permission notice appear in all /// copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+/// AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+/// DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+/// OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+/// TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+/// PERFORMANCE OF THIS SOFTWARE.
+///
+
+#ifndef SCSL_ARENAALLOCATOR_H
+#define SCSL_ARENAALLOCATOR_H
+
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "Arena.h"
+
+
+namespace scsl {
+
+
+/// \brief An allocator for standard containers that draws from an Arena.
+///
+/// Memory comes from Arena::Alloc, and deallocation is a no-op: memory is
+/// only returned to the arena by Arena::Rewind, Arena::Reset, or destroying
+/// the arena. This makes it suitable for scratch containers whose contents
+/// all share one lifetime, such as the data for a single request. Any
+/// containers using the allocator must be destroyed, or at least never
+/// touched again, before the arena memory they used is released.
+///
+/// A chunked arena (see Arena::SetChunked) is usually the best backing, as
+/// it grows instead of running out of memory. If the arena can't satisfy an
+/// allocation, std::bad_alloc is thrown, or the program is aborted if
+/// exceptions are disabled.
+///
+/// \tparam T The type of object being allocated.
+template<typename T>
+class ArenaAllocator {
+public:
+	/// The type of object allocated.
+	using value_type = T;
+
+	/// An ArenaAllocator must always be given an arena.
+	///
+	/// \param backing The arena to allocate from.
+	explicit ArenaAllocator(Arena &backing) noexcept
+	    : arena(&backing)
+	{}
+
+	/// Containers rebind the allocator to allocate their own internal
+	/// types; the rebound allocator uses the same arena.
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U> &other) noexcept
+	    : arena(other.Backing())
+	{}
+
+	/// Allocate storage for n objects of type T.
+	///
+	/// \throws std::bad_alloc.
+	///
+	/// \param n The number of objects to allocate storage for.
+	/// \return A pointer to the storage.
+	T *allocate(std::size_t n)
+	{
+		void *mem = nullptr;
+
+		if (n <= (static_cast<std::size_t>(-1) / sizeof(T))) {
+			mem = this->arena->Alloc(n * sizeof(T), alignof(T));
+		}
+
+		if (mem == nullptr) {
+#if defined(SCSL_DESKTOP_BUILD) and !defined(SCSL_NOEXCEPT)
+			throw std::bad_alloc();
+#else
+			abort();
+#endif
+		}
+
+		return static_cast<T *>(mem);
+	}
+
+	/// deallocate does nothing; the memory is released with the arena.
+	void deallocate(T *p, std::size_t n) noexcept
+	{ (void)p; (void)n; }
+
+	/// Backing returns the arena this allocator draws from.
+	///
+	/// \return A pointer to the backing arena.
+	Arena *Backing() const noexcept
+	{ return this->arena; }
+
+private:
+	Arena *arena;
+};
+
+
+/// Two ArenaAllocators are equal if they draw from the same arena.
+template<typename T, typename U>
+bool
+operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) noexcept
+{
+	return a.Backing() == b.Backing();
+}
+
+
+/// Two ArenaAllocators are unequal if they draw from different arenas.
+template<typename T, typename U>
+bool
+operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) noexcept
+{
+	return a.Backing() != b.Backing();
+}
+
+
+} // namespace scsl
+
+
+#endif // SCSL_ARENAALLOCATOR_H
@@ -0,0 +1,110 @@
+///
+/// \file include/scsl/ArenaReplicas.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Per-NUMA-node copies of an Arena.
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that
+/// the above copyright notice and this permission notice appear in all /// copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+/// AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+/// DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+/// OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+/// TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+/// PERFORMANCE OF THIS SOFTWARE.
+///
+
+#ifndef SCSL_ARENAREPLICAS_H
+#define SCSL_ARENAREPLICAS_H
+
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "Arena.h"
+
+
+namespace scsl {
+
+
+/// \brief ArenaReplicas keeps a copy of an arena on each NUMA node.
+///
+/// Read-mostly data, such as a Dictionary that many threads look things up
+/// in, is slower to read from a remote node. ArenaReplicas copies an arena
+/// into one allocated arena per node, each bound to its node, so that
+/// readers can use the copy local to them:
+///
+/// ```
+/// ArenaReplicas replicas;
+/// replicas.Replicate(arena);
+/// ...
+/// Dictionary dict(replicas.Local());
+/// ```
+///
+/// The replicas are independent: changes made to one aren't seen in the
+/// others. To update them, change the source arena and call #Replicate
+/// again, once no readers are using the old replicas. On machines with a
+/// single node there is a single replica.
+class ArenaReplicas {
+public:
+	ArenaReplicas() = default;
+
+	~ArenaReplicas()
+	{ this->Destroy(); }
+
+	ArenaReplicas(const ArenaReplicas &) = delete;
+	ArenaReplicas &operator=(const ArenaReplicas &) = delete;
+
+	/// Replicate copies source into a new arena on each NUMA node,
+	/// replacing any existing replicas. Only the part of source below
+	/// its high-water mark is copied; the rest of each replica is
+	/// zeroed, as it is in source.
+	///
+	/// \param source The arena to copy.
+	/// \return Returns 0 on success and -1 on error.
+	int Replicate(const Arena &source);
+
+	/// Count returns the number of replicas, which is the number of
+	/// NUMA nodes once #Replicate has succeeded.
+	///
+	/// \return The number of replicas.
+	size_t Count() const
+	{ return this->replicas.size(); }
+
+	/// Replica returns the copy placed on a NUMA node. If there is no
+	/// replica for node, it will throw a range_error.
+	///
+	/// \throws std::range_error.
+	///
+	/// \param node The NUMA node.
+	/// \return The replica on that node.
+	Arena &Replica(size_t node);
+
+	/// Local returns the replica on the NUMA node the calling thread is
+	/// running on. If #Replicate hasn't been called, it will throw a
+	/// range_error.
+	///
+	/// \throws std::range_error.
+	///
+	/// \return The replica closest to the calling thread.
+	Arena &Local();
+
+	/// Destroy releases every replica.
+	void Destroy();
+
+private:
+	std::vector<std::unique_ptr<Arena>>	replicas;
+};
+
+
+} // namespace scsl
+
+
+#endif
@@ -0,0 +1,67 @@
+///
+/// \file include/scsl/CRC32C.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief CRC-32C checksums.
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that
+/// the above copyright notice and this permission notice appear in all /// copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+/// AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+/// DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+/// OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+/// TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+/// PERFORMANCE OF THIS SOFTWARE.
+///
+
+#ifndef SCSL_CRC32C_H
+#define SCSL_CRC32C_H
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace scsl {
+
+
+/// CRC32C computes the CRC-32C (Castagnoli) checksum of a buffer. It uses
+/// the CPU's CRC32 instruction when one is available (SSE4.2 on x86-64,
+/// the CRC extension on ARMv8), and a table-driven implementation
+/// otherwise; both give the same results.
+///
+/// A checksum can be computed over several buffers by passing the result
+/// for the earlier buffers as crc.
+///
+/// \param data The data to checksum.
+/// \param len The number of bytes in data.
+/// \param crc The checksum of any preceding data, or 0.
+/// \return The checksum of the data.
+uint32_t CRC32C(const void *data, size_t len, uint32_t crc = 0);
+
+/// CRC32CPortable computes the same checksum as CRC32C without using any
+/// special instructions.
+///
+/// \param data The data to checksum.
+/// \param len The number of bytes in data.
+/// \param crc The checksum of any preceding data, or 0.
+/// \return The checksum of the data.
+uint32_t CRC32CPortable(const void *data, size_t len, uint32_t crc = 0);
+
+/// CRC32CHardware reports whether CRC32C uses a hardware instruction on
+/// this machine.
+///
+/// \return True if the checksum is computed in hardware.
+bool CRC32CHardware();
+
+
+} // namespace scsl
+
+
+#endif // SCSL_CRC32C_H
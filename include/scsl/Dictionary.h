@@ -57,6 +57,9 @@ public:
 	{};
 
 	/// A Dictionary can also be configured with custom key and value types.
+	/// The tags can't be ones reserved in the arena, such as
+	/// TLV::TAG_TOMBSTONE in an arena with a region header; Set fails
+	/// if they are. \see TLV::IsReserved.
 	///
 	/// \param arena The backing arena for the Dictionary.
 	/// \param kt The value to use for key tags.
@@ -84,6 +87,9 @@ public:
 	/// store the new Val, the Dictionary will not contain either key
 	/// or value.
 	///
+	/// If the arena runs out of space, deleted pairs are compacted away;
+	/// if there still isn't room and Arena::AutoGrowIsEnabled, the arena
+	/// is grown to make room for the new pair.
 	///
 	/// \param key The key to associate.
 	/// \param klen The length of the key.
@@ -100,7 +106,11 @@ public:
 	/// \return True if the key is in the Dictionary, otherwise false.
 	bool Contains(const char *key, uint8_t klen);
 
-	/// Delete removes the key from the Dictionary.
+	/// Delete removes the key from the Dictionary. If the arena has a
+	/// region header, the pair is marked with tombstones, and the arena
+	/// is compacted once tombstones take up TLV::COMPACT_RATIO of it;
+	/// otherwise, the pair is deleted outright. \see
+	/// TLV::TombstoneRecord.
 	///
 	/// \param key The key to look up.
 	/// \param klen The length of the key.
@@ -124,6 +134,7 @@ public:
 	    const Dictionary &dictionary);
 private:
 	uint8_t *seek(const char *key, uint8_t klen);
+	void remove(uint8_t *cursor);
 
 	bool spaceAvailable(uint8_t klen, uint8_t vlen);
 
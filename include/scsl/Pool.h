@@ -0,0 +1,309 @@
+///
+/// \file include/scsl/Pool.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Fixed-size object pools built on Arena.
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that
+/// the above copyright notice and this permission notice appear in all /// copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+/// AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+/// DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+/// OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+/// TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+/// PERFORMANCE OF THIS SOFTWARE.
+///
+
+#ifndef SCSL_POOL_H
+#define SCSL_POOL_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include "Arena.h"
+
+
+namespace scsl {
+
+
+/// \brief Pool hands out fixed-size objects carved from an Arena.
+///
+/// Objects are carved out of slabs allocated from the arena, and released
+/// objects are kept on an intrusive free list, so both #Acquire and
+/// #Release are O(1) and never touch the global allocator. Objects from the
+/// same slab sit next to each other in memory.
+///
+/// The pool never returns memory to the arena; the slabs live until the
+/// arena is reset or destroyed, which must not happen while any objects
+/// are still in use. The arena shouldn't be used by anything else from
+/// other threads while the pool is in use.
+///
+/// A pool can be shared between threads. Its free list and slab carving
+/// are protected by a mutex; threads that acquire and release often should
+/// each use a Pool::Cache to avoid contending for it.
+///
+/// \tparam T The type of object in the pool.
+template<typename T>
+class Pool {
+	/// A Slot holds either a live object or a free-list link.
+	union Slot {
+		Slot	*next;
+		alignas(T) uint8_t object[sizeof(T)];
+	};
+
+public:
+	/// A Pool is created on top of an Arena.
+	///
+	/// \param backing The arena that slabs are allocated from.
+	/// \param objectsPerSlab The number of objects in each slab.
+	explicit Pool(Arena &backing, size_t objectsPerSlab = 64)
+	    : arena(backing), slabObjects(objectsPerSlab > 0 ? objectsPerSlab : 1),
+	      freeList(nullptr), slabCursor(nullptr), slabEnd(nullptr),
+	      slabs(0), inUse(0)
+	{}
+
+	Pool(const Pool &) = delete;
+	Pool &operator=(const Pool &) = delete;
+
+	/// Acquire constructs a new object in the pool.
+	///
+	/// \param args The arguments to pass to T's constructor.
+	/// \return A pointer to the new object, or nullptr if the arena
+	///    is out of memory.
+	template<typename... Args>
+	T *Acquire(Args &&...args)
+	{
+		void	*slot;
+
+		{
+			std::lock_guard<std::mutex>	lock(this->mtx);
+			slot = this->take();
+		}
+
+		if (slot == nullptr) {
+			return nullptr;
+		}
+
+		return construct(slot, [this, slot]() {
+			std::lock_guard<std::mutex>	lock(this->mtx);
+			this->give(slot);
+		}, std::forward<Args>(args)...);
+	}
+
+	/// Release destroys an object acquired from this pool and returns
+	/// its memory to the free list.
+	///
+	/// \param obj The object to release; nullptr is ignored.
+	void Release(T *obj)
+	{
+		if (obj == nullptr) {
+			return;
+		}
+
+		obj->~T();
+		std::lock_guard<std::mutex>	lock(this->mtx);
+		this->give(obj);
+	}
+
+	/// InUse returns the number of objects currently acquired from the
+	/// pool, including objects held free in a Cache.
+	size_t InUse() const
+	{
+		std::lock_guard<std::mutex>	lock(this->mtx);
+		return this->inUse;
+	}
+
+	/// Slabs returns the number of slabs allocated from the arena.
+	size_t Slabs() const
+	{
+		std::lock_guard<std::mutex>	lock(this->mtx);
+		return this->slabs;
+	}
+
+	/// \brief A per-thread cache of free objects for a Pool.
+	///
+	/// A Cache keeps a small stack of free slots that only its owning
+	/// thread uses, refilling it from the pool and spilling it back in
+	/// batches so that the pool's lock is only taken once per batch.
+	/// Each worker thread should have its own Cache, e.g. as a local
+	/// or thread_local variable; a Cache must not be shared between
+	/// threads. Objects may be released through any Cache of the same
+	/// pool, or through the pool itself.
+	class Cache {
+	public:
+		/// Create a cache for a pool.
+		///
+		/// \param pool The pool to cache objects from.
+		/// \param batch The number of objects moved between the
+		///    cache and the pool at once.
+		explicit Cache(Pool &pool, size_t batch = 32)
+		    : pool(pool), batch(batch > 0 ? batch : 1), slots(nullptr),
+		      count(0)
+		{}
+
+		Cache(const Cache &) = delete;
+		Cache &operator=(const Cache &) = delete;
+
+		/// The cache's free objects are returned to the pool when
+		/// it's destroyed.
+		~Cache()
+		{ this->spill(this->count); }
+
+		/// Acquire constructs a new object, using the cache if
+		/// possible. \see Pool::Acquire.
+		template<typename... Args>
+		T *Acquire(Args &&...args)
+		{
+			if (this->count == 0) {
+				this->refill();
+			}
+
+			if (this->count == 0) {
+				return nullptr;
+			}
+
+			auto	*slot = this->slots;
+			this->slots = slot->next;
+			this->count--;
+			return Pool::construct(slot, [this, slot]() {
+				slot->next = this->slots;
+				this->slots = slot;
+				this->count++;
+			}, std::forward<Args>(args)...);
+		}
+
+		/// Release destroys an object and keeps its memory in the
+		/// cache. \see Pool::Release.
+		void Release(T *obj)
+		{
+			if (obj == nullptr) {
+				return;
+			}
+
+			obj->~T();
+			auto	*slot = reinterpret_cast<Slot *>(obj);
+			slot->next = this->slots;
+			this->slots = slot;
+			this->count++;
+
+			if (this->count >= this->batch * 2) {
+				this->spill(this->batch);
+			}
+		}
+
+	private:
+		void refill()
+		{
+			std::lock_guard<std::mutex>	lock(this->pool.mtx);
+			for (size_t i = 0; i < this->batch; i++) {
+				auto *slot = static_cast<Slot *>(this->pool.take());
+				if (slot == nullptr) {
+					break;
+				}
+
+				slot->next = this->slots;
+				this->slots = slot;
+				this->count++;
+			}
+		}
+
+		void spill(size_t n)
+		{
+			std::lock_guard<std::mutex>	lock(this->pool.mtx);
+			while ((n > 0) && (this->slots != nullptr)) {
+				auto	*slot = this->slots;
+				this->slots = slot->next;
+				this->count--;
+				this->pool.give(slot);
+				n--;
+			}
+		}
+
+		Pool	&pool;
+		size_t	 batch;
+		Slot	*slots;
+		size_t	 count;
+	};
+
+private:
+	/// construct builds a T in slot. If T's constructor throws, undo is
+	/// called to give the slot back before the exception is passed on.
+	template<typename Undo, typename... Args>
+	static T *construct(void *slot, Undo undo, Args &&...args)
+	{
+		struct Guard {
+			Undo	&undo;
+			bool	 armed;
+
+			~Guard()
+			{ if (this->armed) { this->undo(); } }
+		} guard{undo, true};
+
+		auto	*obj = new (slot) T(std::forward<Args>(args)...);
+		guard.armed = false;
+		return obj;
+	}
+
+	/// take returns a free slot; the pool's mutex must be held.
+	void *take()
+	{
+		Slot	*slot = this->freeList;
+
+		if (slot != nullptr) {
+			this->freeList = slot->next;
+			this->inUse++;
+			return slot;
+		}
+
+		if (this->slabCursor == this->slabEnd) {
+			auto *slab = static_cast<Slot *>(this->arena.Alloc(
+			    sizeof(Slot) * this->slabObjects, alignof(Slot)));
+			if (slab == nullptr) {
+				return nullptr;
+			}
+
+			this->slabCursor = slab;
+			this->slabEnd = slab + this->slabObjects;
+			this->slabs++;
+		}
+
+		this->inUse++;
+		return this->slabCursor++;
+	}
+
+	/// give puts a slot back on the free list; the pool's mutex must
+	/// be held.
+	void give(void *mem)
+	{
+		auto	*slot = static_cast<Slot *>(mem);
+
+		slot->next = this->freeList;
+		this->freeList = slot;
+		this->inUse--;
+	}
+
+	Arena			&arena;
+	size_t			 slabObjects;
+	Slot			*freeList;
+	Slot			*slabCursor;
+	Slot			*slabEnd;
+	size_t			 slabs;
+	size_t			 inUse;
+	mutable std::mutex	 mtx;
+};
+
+
+} // namespace scsl
+
+
+#endif // SCSL_POOL_H
@@ -4,9 +4,15 @@
 /// \date 2023-10-06
 /// \brief TLV.h implements basic tag-length-value records.
 ///
-/// TLV implements tag-length-value (TLV) records. Each record can have
-/// a maximum length of 253 bytes; each TLV record occupies a fixed 255
-/// bytes in memory. TLV records don't allocate memory.
+/// TLV implements tag-length-value (TLV) records. A Record can have a
+/// maximum length of 253 bytes, and occupies a fixed 255 bytes in memory.
+/// TLV records don't allocate memory.
+///
+/// Values longer than that can be stored with WriteValue, which uses an
+/// extended encoding: the length byte is set to TLV_LEN_EXTENDED and is
+/// followed by the real length as a varint. Records that fit in 253 bytes
+/// are always written in the original one-byte form, so existing arenas
+/// read the same as they always have.
 ///
 /// This system uses an Arena as a backing store.
 ///
@@ -15,9 +21,13 @@
 #define KIMODEM_TLV_H
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <iterator>
 
 #include "Arena.h"
+#include "Buffer.h"
 
 
 namespace scsl {
@@ -32,6 +42,13 @@ static constexpr size_t TLV_MAX_LEN = 253;
 
 static constexpr uint8_t TAG_EMPTY = 0;
 
+/// TLV_LEN_EXTENDED is the length byte of a record that uses the extended
+/// encoding, where the real length follows as a varint.
+static constexpr uint8_t TLV_LEN_EXTENDED = 0xff;
+
+static_assert(TLV_MAX_LEN < TLV_LEN_EXTENDED,
+	      "TLV_MAX_LEN must leave room for the extended length marker");
+
 
 /// \brief Tag-length-value record with single byte tags and lengths.
 ///
@@ -48,21 +65,289 @@ struct Record {
 	uint8_t Val[TLV_MAX_LEN];
 };
 
+/// \brief Header describes how a record is laid out in an arena.
+///
+/// Unlike a Record, a Header doesn't hold the record's value, so it can
+/// describe records of any length.
+struct Header {
+	/// Tag identifies the type of the record.
+	uint8_t	Tag;
+	/// Len is the number of bytes in the record's value.
+	size_t	Len;
+	/// Size is the number of bytes taken by the tag and length; the
+	/// value starts this many bytes into the record.
+	size_t	Size;
+};
+
+/// HEADER_MAX is the most bytes a record's tag and length can take.
+static constexpr size_t HEADER_MAX = 2 + (sizeof(size_t) * 8 + 6) / 7;
+
+/// DecodeHeader decodes a record header from memory that isn't in an
+/// arena, such as a stream buffer. Unlike ReadHeader, it doesn't check
+/// that the record's value is available.
+///
+/// \param cursor A pointer to the start of a record.
+/// \param avail The number of bytes available at cursor.
+/// \param hdr The header to be filled in.
+/// \return True if a complete header was decoded; false if more bytes
+///     are needed or the length is invalid.
+bool DecodeHeader(const uint8_t *cursor, size_t avail, Header &hdr);
+
+/// EncodeHeader writes the tag and length of a record, using the
+/// extended encoding if len is longer than TLV_MAX_LEN.
+///
+/// \param dst Where to write the header; it must have room for
+///     HEADER_MAX bytes.
+/// \param tag The record's tag.
+/// \param len The length of the record's value.
+/// \return The number of bytes written.
+size_t EncodeHeader(uint8_t *dst, uint8_t tag, size_t len);
+
+/// ReadHeader decodes the header of the record at cursor.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param cursor A pointer to a record in the arena.
+/// \param hdr The header to be filled in.
+/// \return True if the cursor points to a record that fits in the arena.
+bool ReadHeader(Arena &arena, const uint8_t *cursor, Header &hdr);
+
+/// WriteValue writes a record holding len bytes of val into the arena at the
+/// location pointed to by the cursor, using the extended encoding if the
+/// value is longer than TLV_MAX_LEN. The cursor, growth and dirty-tracking
+/// behaviour is the same as for WriteToMemory.
+///
+/// \param arena The backing memory store.
+/// \param cursor Pointer into the arena's memory, or nullptr to write the
+///     record into the first empty space.
+/// \param tag The record's tag.
+/// \param val The record's value.
+/// \param len The length of the value.
+/// \return A pointer the memory after the record, or nullptr if it
+///     couldn't be written or its tag is reserved in the arena.
+///     \see IsReserved
+uint8_t *WriteValue(Arena &arena, uint8_t *cursor, uint8_t tag,
+		    const uint8_t *val, size_t len);
+
+/// WriteBatch appends n records after the last record in the arena. The
+/// space for the whole batch is found and checked once, so this is much
+/// cheaper than calling WriteToMemory for each record.
+///
+/// The batch is all-or-nothing: if there isn't room for every record, and
+/// the arena can't grow to make room, nothing is written.
+///
+/// \param arena The backing memory store.
+/// \param recs The records to write.
+/// \param n The number of records.
+/// \return A pointer to the memory after the last record, or nullptr if
+///     the batch couldn't be written or one of its tags is reserved in
+///     the arena.
+uint8_t *WriteBatch(Arena &arena, const Record *recs, size_t n);
+
+/// ReadValue copies the value of the record at cursor into val, replacing
+/// its contents. This works for records of any length.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param cursor A pointer to a record in the arena.
+/// \param tag Filled in with the record's tag.
+/// \param val Filled in with the record's value.
+/// \return A pointer to the next record, or nullptr if the cursor doesn't
+///     point to a record that fits in the arena.
+uint8_t *ReadValue(Arena &arena, uint8_t *cursor, uint8_t &tag, Buffer &val);
+
+/// LocateValue finds the next record with the given tag, of any length.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param cursor A pointer to memory inside the arena; if it's NULL, the
+///     search starts At the beginning of the arena.
+/// \param tag The tag to look for.
+/// \param hdr Filled in with the found record's header.
+/// \return If the tag is found, a cursor pointing to the record is
+///     returned; otherwise nullptr is returned.
+uint8_t *LocateValue(Arena &arena, uint8_t *cursor, uint8_t tag, Header &hdr);
+
+/// TAG_REGION is the tag of the region header record. \see InitRegion.
+static constexpr uint8_t TAG_REGION = 0xff;
+
+/// REGION_VERSION is the version of the region header layout.
+static constexpr uint16_t REGION_VERSION = 1;
+
+/// REGION_SIZE is the number of bytes the region header record occupies
+/// at the start of an arena.
+static constexpr size_t REGION_SIZE = 34;
+
+/// TAG_TOMBSTONE marks a record that has been deleted but whose space
+/// hasn't been reclaimed yet. \see TombstoneRecord.
+///
+/// The tombstone, checksum and sync tags are only reserved in arenas that
+/// use them: TAG_TOMBSTONE in any arena with a region header, TAG_CHECKSUM
+/// with REGION_CHECKSUMS, and TAG_SYNC with REGION_SYNC. Records with a
+/// reserved tag can't be written, and are skipped when reading records;
+/// in any other arena, these are ordinary tags. \see IsReserved.
+static constexpr uint8_t TAG_TOMBSTONE = 0xfe;
+
+/// TAG_CHECKSUM is the tag of a checksum record. \see REGION_CHECKSUMS.
+static constexpr uint8_t TAG_CHECKSUM = 0xfd;
+
+/// CHECKSUM_SIZE is the number of bytes a checksum record occupies.
+static constexpr size_t CHECKSUM_SIZE = 6;
+
+/// REGION_CHECKSUMS is a region flag that makes every record written to
+/// the arena be followed by a checksum record holding the CRC-32C of the
+/// record's tag, length and value. \see Verify.
+static constexpr uint16_t REGION_CHECKSUMS = 0x0001;
+
+/// TAG_SYNC is the tag of a sync marker record. \see REGION_SYNC.
+static constexpr uint8_t TAG_SYNC = 0xfc;
+
+/// SYNC_SIZE is the number of bytes a sync marker occupies.
+static constexpr size_t SYNC_SIZE = 14;
+
+/// SYNC_INTERVAL is the spacing, in bytes, between sync markers.
+static constexpr size_t SYNC_INTERVAL = 1024 * 1024;
+
+/// REGION_SYNC is a region flag that makes appends write a sync marker
+/// before the first record to cross each SYNC_INTERVAL boundary. A sync
+/// marker holds a magic number and its own offset in the arena, so it can
+/// be found without walking the records before it; ParallelScan uses them
+/// to split the arena into pieces that can be read independently.
+///
+/// Markers moved by DeleteRecord no longer match their offset and are
+/// ignored until the next Compact, which fixes them up.
+static constexpr uint16_t REGION_SYNC = 0x0002;
+
+/// REGION_CONTAINERS is a region flag that WriteContainer sets once the
+/// arena holds a container. Records nested in a container are read-only:
+/// changing one would leave the container's length and checksum stale.
+/// With this flag set, or without a region header, DeleteRecord,
+/// TombstoneRecord and WriteValue walk the records before a cursor to
+/// check that it points to a top-level record, and refuse it otherwise.
+static constexpr uint16_t REGION_CONTAINERS = 0x0004;
+
+/// COMPACT_RATIO is the default share of the records' space that
+/// tombstones may take before NeedsCompact says to compact.
+static constexpr double COMPACT_RATIO = 0.25;
+
+/// \brief Region describes the records in an arena with a region header.
+struct Region {
+	/// Version is the layout version of the header.
+	uint16_t	Version;
+	/// Flags holds options for the region, such as REGION_CHECKSUMS.
+	uint16_t	Flags;
+	/// Tail is the offset of the empty space following the last
+	/// record; it equals the arena's size if the arena is full.
+	size_t		Tail;
+	/// Count is the number of records, not including the header or
+	/// any tombstones.
+	size_t		Count;
+	/// Dead is the number of bytes taken by tombstones.
+	size_t		Dead;
+};
+
+/// InitRegion adds a region header to the start of an arena.
+///
+/// Without a header, finding the end of the records means walking every
+/// record from the start of the arena, so appending to an arena is O(n).
+/// The header is a record with the tag TAG_REGION that stores a magic
+/// number, a version, the offset of the end of the records, the number of
+/// records, and the space taken by tombstones. Appending with WriteValue
+/// or WriteToMemory, finding empty space, and deleting records all keep
+/// it up to date, which makes appends O(1). Because it is stored in the
+/// arena, an arena loaded from a file that has a header doesn't need to
+/// be scanned either.
+///
+/// Since the header is itself a record, code that walks the records
+/// without knowing about it will just see a record with the TAG_REGION
+/// tag. Any records already in the arena are moved down to make room.
+///
+/// Writing a record at a cursor other than the end of the records makes
+/// the next lookup of the header rescan the arena.
+///
+/// If the arena already has a header, any new flags are added to it.
+/// Flags only affect records written after they are set.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param flags Options for the region, such as REGION_CHECKSUMS.
+/// \return Returns 0 on success, or -1 if the arena isn't writable,
+///     doesn't have room for the header, or already has records using a
+///     tag the region would reserve. \see TAG_TOMBSTONE
+int InitRegion(Arena &arena, uint16_t flags = 0);
+
+/// IsReserved checks whether tag is reserved for bookkeeping records in
+/// the arena. \see TAG_TOMBSTONE
+///
+/// \param arena The backing memory for the TLV store.
+/// \param tag The tag to check.
+/// \return True if records with tag can't be written to the arena.
+bool IsReserved(Arena &arena, uint8_t tag);
+
+/// IsRegionHeader checks whether the bytes at cursor hold a region header
+/// that this version understands: a TAG_REGION record of REGION_SIZE
+/// bytes with the right magic number and REGION_VERSION. A record that
+/// merely has the TAG_REGION tag is an ordinary record.
+///
+/// \param cursor A pointer to the record.
+/// \param avail The number of bytes available at cursor.
+/// \return True if cursor points to a region header.
+bool IsRegionHeader(const uint8_t *cursor, size_t avail);
+
+/// ReadRegion reads an arena's region header.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param region Filled in with the contents of the header.
+/// \return True if the arena has a region header.
+bool ReadRegion(Arena &arena, Region &region);
+
+/// FirstRecord returns a pointer to the first record in the arena, which
+/// follows the region header if there is one.
+///
+/// \param arena The backing memory for the TLV store.
+/// \return A pointer to the first record.
+uint8_t *FirstRecord(Arena &arena);
+
 /// WriteToMemory writes the TLV record into the arena At the location pointed
 /// to in the arena.
 ///
+/// If the arena doesn't have room for the record and
+/// Arena::AutoGrowIsEnabled, the arena is grown first. Growing may move
+/// the arena's memory, so the cursor passed in must not be used afterwards;
+/// the returned cursor points into the grown arena.
+///
+/// The bytes written are marked dirty in the arena; see Arena::FlushDirty.
+///
 /// \param arena The backing memory store.
 /// \param cursor Pointer into the arena's memory.
 /// \param rec A TLV record to be serialized.
-/// \return A pointer the memory after the record.
+/// \return A pointer the memory after the record, or nullptr if it
+///     couldn't be written or its tag is reserved in the arena.
 uint8_t *WriteToMemory(Arena &arena, uint8_t *cursor, Record &rec);
 
 /// ReadFromMemory reads a record from the memory pointed to by the cursor.
+/// A record using the extended encoding can't be held in a Record; its
+/// tag is read, but its length is set to zero. Use ReadValue for arenas
+/// that may hold long values.
 ///
 /// \param rec The TLV record to be filled in.
 /// \param cursor A pointer into an arena's memory store.
 void ReadFromMemory(Record &rec, uint8_t *cursor);
 
+/// WriteToRing appends the TLV record to the tail of a ring arena (see
+/// Arena::SetRing). Records that wrap past the end of the ring are written
+/// in one piece.
+///
+/// \param arena A ring arena.
+/// \param rec A TLV record to be serialized.
+/// \return True if the record was written, or false if there isn't room
+///     for it in the ring.
+bool WriteToRing(Arena &arena, Record &rec);
+
+/// ReadFromRing removes the record at the head of a ring arena.
+///
+/// \param arena A ring arena.
+/// \param rec The TLV record to be filled in.
+/// \return True if a record was read, or false if the ring doesn't hold
+///     a complete record.
+bool ReadFromRing(Arena &arena, Record &rec);
+
 /// SetRecord sets a record.
 ///
 /// \param rec The record to be set.
@@ -71,10 +356,44 @@ void ReadFromMemory(Record &rec, uint8_t *cursor);
 /// \param data The data to fill the record with.
 void SetRecord(Record &rec, uint8_t tag, uint8_t length, const char *data);
 
-/// DeleteRecord removes the record from the arena. All records ahead of this
-/// record are shifted backwards so that there are no gaps.
+/// DeleteRecord removes the record from the arena. All records ahead of
+/// this record are shifted backwards so that there are no gaps, and the
+/// shifted range is marked dirty in the arena. If the region has
+/// REGION_CHECKSUMS, the checksum record following it is removed along
+/// with it. The cost is proportional to the size of the records that
+/// follow; TombstoneRecord is O(1).
 void DeleteRecord(Arena &arena, uint8_t *cursor);
 
+/// TombstoneRecord deletes a record in place by changing its tag to
+/// TAG_TOMBSTONE, without moving any other records. If the region has
+/// REGION_CHECKSUMS, the checksum record following it is also marked as
+/// a tombstone. Tombstones are skipped by lookups and by the record
+/// iterator; their space is reclaimed by Compact.
+///
+/// Tombstones need a region header to keep track of them; in an arena
+/// without one, the record is removed with DeleteRecord instead.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param cursor A pointer to the record to delete.
+void TombstoneRecord(Arena &arena, uint8_t *cursor);
+
+/// Compact removes every tombstone from the arena in a single pass, moving
+/// the live records down to close the gaps and zeroing the freed space.
+/// Cursors into the arena are invalidated.
+///
+/// \param arena The backing memory for the TLV store.
+/// \return The number of bytes freed.
+size_t Compact(Arena &arena);
+
+/// NeedsCompact checks whether tombstones take up at least ratio of the
+/// space used by records. This is O(1); an arena without a region header
+/// never has tombstones.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param ratio The share of the records' space, from 0 to 1.
+/// \return True if the arena should be compacted.
+bool NeedsCompact(Arena &arena, double ratio = COMPACT_RATIO);
+
 /*
 * returns a pointer to memory where the record was found,
 * e.g. LocateTag(...)[0] is the tag of the found record.
@@ -84,7 +403,8 @@ void DeleteRecord(Arena &arena, uint8_t *cursor);
 /// FindTag finds the next occurrence of the record's tag.
 ///
 /// The record must have a tag set, which tells FindTag which tag to look for.
-/// If found, it fills the record. \see LocateTag.
+/// If found, it fills the record. Records too long to fit in a Record are
+/// skipped; use LocateValue to find them. \see LocateTag.
 ///
 /// \param arena The backing memory for the TLV store.
 /// \param cursor A pointer to memory inside the arena; if it's NULL, the
@@ -125,6 +445,295 @@ uint8_t *FindEmpty(Arena &arena, uint8_t *cursor);
 uint8_t *SkipRecord(Record &rec, uint8_t *cursor);
 
 
+/// Verify checks the integrity of the records in an arena: every record
+/// must fit in the arena, every checksum record must match the record
+/// before it, and a region header must agree with the records. Records
+/// without a checksum are only checked for structure. Verify reads the
+/// arena once, and the checksums are computed in hardware where possible,
+/// so it is cheap enough to run whenever an arena is opened.
+///
+/// \param arena The backing memory for the TLV store.
+/// \return True if the arena passed every check.
+bool Verify(Arena &arena);
+
+
+/// \brief RecordView refers to a record in place in an arena.
+///
+/// Where a Record holds a copy of a record's value, a RecordView points
+/// at the value in the arena, so looking at a record doesn't copy it. The
+/// view is only valid until the arena is changed, grown, or destroyed.
+struct RecordView {
+	/// Tag identifies the type of the record.
+	uint8_t		 Tag;
+	/// Len is the number of bytes in the record's value.
+	size_t		 Len;
+	/// Val points to the record's value in the arena.
+	const uint8_t	*Val;
+};
+
+/// ReadView fills in a view of the record at cursor without copying it.
+/// This works for records of any length.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param cursor A pointer to a record in the arena.
+/// \param view The view to be filled in.
+/// \return A pointer to the next record, or nullptr if the cursor doesn't
+///     point to a record that fits in the arena.
+uint8_t *ReadView(Arena &arena, uint8_t *cursor, RecordView &view);
+
+/// CopyView copies the record a view refers to into rec.
+///
+/// \param view The view of the record to copy.
+/// \param rec The record to be filled in.
+/// \return True if the value fit in a Record and was copied.
+bool CopyView(const RecordView &view, Record &rec);
+
+/// ViewEquals checks whether a view's value is the same as val.
+///
+/// \param view The view of the record to compare.
+/// \param val The value to compare against.
+/// \param len The length of val.
+/// \return True if the lengths and contents match.
+bool ViewEquals(const RecordView &view, const void *val, size_t len);
+
+/// WriteBatch appends n records, given as views, after the last record in
+/// the arena. This is the same as the Record version, but values can be
+/// longer than TLV_MAX_LEN. The views can't point into the arena itself,
+/// since it may be grown to fit the batch.
+///
+/// \param arena The backing memory store.
+/// \param views The records to write.
+/// \param n The number of records.
+/// \return A pointer to the memory after the last record, or nullptr if
+///     the batch couldn't be written or one of its tags is reserved in
+///     the arena.
+uint8_t *WriteBatch(Arena &arena, const RecordView *views, size_t n);
+
+
+/// \brief Scope is a run of records inside an arena, such as the records
+/// nested in a container. \see EnterContainer.
+struct Scope {
+	/// Start points to the first record in the scope.
+	uint8_t	*Start;
+	/// End points just past the last record in the scope.
+	uint8_t	*End;
+};
+
+
+/// \brief RecordIterator walks the records in an arena in order.
+///
+/// Iteration stops at the first empty tag, which marks the end of the
+/// records, or at a record that doesn't fit in the arena. Records with a
+/// tag reserved in the arena, such as tombstones, are skipped.
+/// Dereferencing the iterator gives a RecordView, so no values are
+/// copied:
+///
+/// ```
+/// for (auto &view : TLV::Records(arena)) {
+///     if (view.Tag == 1 && TLV::ViewEquals(view, "key", 3)) {
+///         ...
+///     }
+/// }
+/// ```
+///
+/// The records nested in a container can be walked by iterating over
+/// its Scope.
+///
+/// Changing the arena invalidates any iterators over it.
+class RecordIterator {
+public:
+	using iterator_category = std::forward_iterator_tag;
+	using value_type = RecordView;
+	using difference_type = std::ptrdiff_t;
+	using pointer = const RecordView *;
+	using reference = const RecordView &;
+
+	/// A default RecordIterator is the end of every arena.
+	RecordIterator();
+
+	/// Start iterating over the records in arena at cursor.
+	///
+	/// \param arena The backing memory for the TLV store.
+	/// \param cursor The first record to visit; if it's NULL, iteration
+	///     starts at the arena's FirstRecord.
+	/// \param limit If it isn't NULL, iteration stops at limit, and
+	///     records that run past it aren't visited. \see Scope.
+	RecordIterator(Arena &arena, uint8_t *cursor, uint8_t *limit = nullptr);
+
+	reference operator*() const
+	{ return this->view; }
+
+	pointer operator->() const
+	{ return &this->view; }
+
+	RecordIterator &operator++();
+	RecordIterator operator++(int);
+
+	bool operator==(const RecordIterator &other) const
+	{ return this->cursor == other.cursor; }
+
+	bool operator!=(const RecordIterator &other) const
+	{ return this->cursor != other.cursor; }
+
+	/// Cursor returns a pointer to the current record in the arena,
+	/// suitable for passing to the cursor-based functions such as
+	/// DeleteRecord. At the end, it returns nullptr.
+	uint8_t *Cursor() const
+	{ return this->cursor; }
+
+private:
+	void load(uint8_t *at);
+
+	Arena		*arena;
+	uint8_t		*cursor;
+	uint8_t		*next;
+	uint8_t		*limit;
+	RecordView	 view;
+	uint8_t		 reserved;
+};
+
+/// \brief RecordRange is the range of records in an arena.
+///
+/// The range is evaluated each time #begin is called, so it sees records
+/// written after it was created.
+struct RecordRange {
+	/// begin returns an iterator at the first record.
+	RecordIterator begin() const
+	{ return RecordIterator(*this->arena, this->cursor, this->limit); }
+
+	/// end returns the end iterator.
+	RecordIterator end() const
+	{ return RecordIterator(); }
+
+	Arena	*arena;
+	uint8_t	*cursor;
+	uint8_t	*limit;
+};
+
+/// Records returns the records in an arena as a range, for use with
+/// range-based for loops and the standard algorithms.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param cursor The first record in the range; if it's NULL, the range
+///     starts at the arena's FirstRecord.
+/// \return The records from cursor to the end of the arena's records.
+inline RecordRange
+Records(Arena &arena, uint8_t *cursor = nullptr)
+{
+	return RecordRange{&arena, cursor, nullptr};
+}
+
+/// Records returns the records in a scope as a range.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param scope The records to visit.
+/// \return The records in the scope.
+inline RecordRange
+Records(Arena &arena, const Scope &scope)
+{
+	return RecordRange{&arena, scope.Start, scope.End};
+}
+
+
+/// WriteContainer writes a container record: a record whose value is
+/// itself a run of TLV records. The nested records are copied from
+/// children, which is usually a scratch arena they were written to;
+/// containers can be nested by writing one container into another's
+/// children.
+///
+/// A container's tag is chosen by the caller, like any other tag. Since
+/// its length covers everything nested in it, code that walks the records
+/// without looking inside it skips the whole group in one step.
+///
+/// \param arena The backing memory store.
+/// \param cursor Pointer into the arena's memory, or nullptr to append.
+/// \param tag The container's tag.
+/// \param children The arena holding the nested records. Only its
+///     records are copied: not its region header, tombstones, checksum
+///     records or sync markers. It can't be the same arena.
+/// \return A pointer to the memory after the container, or nullptr if it
+///     couldn't be written or one of the children's tags is reserved in
+///     the arena. \see IsReserved
+uint8_t *WriteContainer(Arena &arena, uint8_t *cursor, uint8_t tag,
+			Arena &children);
+
+/// ArenaScope returns the scope holding all the top-level records in the
+/// arena.
+///
+/// \param arena The backing memory for the TLV store.
+/// \return The arena's records.
+Scope ArenaScope(Arena &arena);
+
+/// EnterContainer gets the scope of the records nested in the container
+/// record at cursor.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param cursor A pointer to a container record.
+/// \param scope Filled in with the container's records.
+/// \return False if the cursor doesn't point to a record that fits in
+///     the arena.
+bool EnterContainer(Arena &arena, uint8_t *cursor, Scope &scope);
+
+/// LocateIn finds the next record with the given tag in a scope. Only
+/// the scope's own records are looked at: a nested container that
+/// doesn't match is skipped over in one step, however much it holds.
+///
+/// A cursor to a nested record can be read, but not passed to the
+/// functions that change records. \see REGION_CONTAINERS
+///
+/// \param arena The backing memory for the TLV store.
+/// \param scope The records to search.
+/// \param cursor The record to start at; if it's NULL, the search starts
+///     at the start of the scope.
+/// \param tag The tag to look for.
+/// \param view Filled in with the found record.
+/// \return A pointer to the found record, or nullptr if it wasn't found.
+uint8_t *LocateIn(Arena &arena, const Scope &scope, uint8_t *cursor,
+		  uint8_t tag, RecordView &view);
+
+/// LocatePath follows a path of tags down through nested containers: the
+/// first tag is looked up among the arena's records, each of the rest in
+/// the container found by the tag before it.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param path The tags to follow.
+/// \param depth The number of tags in path.
+/// \param view Filled in with the record at the end of the path.
+/// \return A pointer to the record at the end of the path, or nullptr
+///     if any tag along the way wasn't found.
+uint8_t *LocatePath(Arena &arena, const uint8_t *path, size_t depth,
+		    RecordView &view);
+
+
+/// ScanFunc is called by ParallelScan for each record. It's given a view
+/// of the record and the record's offset in the arena, and returns false
+/// to stop the scan.
+using ScanFunc = std::function<bool (const RecordView &, size_t)>;
+
+/// ParallelScan visits every record in the arena, splitting the work
+/// across threads. If the arena has a region header with REGION_SYNC set,
+/// the records are split into segments at the sync markers and each
+/// segment is read by one of the worker threads; otherwise the records
+/// are read in order on the calling thread.
+///
+/// Records within a segment are visited in order, but segments are
+/// visited concurrently, so visit must be safe to call from several
+/// threads at once. Tombstones, checksum records and sync markers aren't
+/// visited. Checksums are checked as the records are read, so a scan
+/// that visits nothing is a parallel version of the record checks in
+/// Verify.
+///
+/// The arena must not be changed during the scan.
+///
+/// \param arena The backing memory for the TLV store.
+/// \param visit The function to call for each record.
+/// \param threads The number of worker threads; 0 uses one per core.
+/// \return True if every record was read and visited; false if a visit
+///     returned false, or if a record was malformed or failed its
+///     checksum.
+bool ParallelScan(Arena &arena, const ScanFunc &visit, size_t threads = 0);
+
+
 } // namespace TLV
 } // namespace scsl
 
@@ -0,0 +1,380 @@
+///
+/// \file include/scsl/TLVSchema.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Compile-time schemas for storing structs as TLV records.
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that
+/// the above copyright notice and this permission notice appear in all /// copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+/// AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+/// DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+/// OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+/// TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+/// PERFORMANCE OF THIS SOFTWARE.
+///
+
+#ifndef SCSL_TLVSCHEMA_H
+#define SCSL_TLVSCHEMA_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Arena.h"
+#include "TLV.h"
+#include "TLVTypes.h"
+
+
+namespace scsl {
+namespace TLV {
+
+
+/// \brief FieldCodec converts a member of type T to and from a record
+/// value.
+///
+/// Encode fills in the view's value, using scratch (VARINT_MAX bytes) if
+/// it needs somewhere to put the encoded bytes; Decode returns false if
+/// the value isn't a valid T. The encodings are the ones in TLVTypes.h:
+///
+///  - unsigned integers are varints, and signed integers zigzag varints;
+///  - enums are stored as their underlying type;
+///  - bool is one byte, 0 or 1;
+///  - float and double are their IEEE 754 bits, little-endian;
+///  - std::string is stored as is.
+///
+/// Other types can be supported by specialising FieldCodec.
+template <typename T, typename Enable = void>
+struct FieldCodec;
+
+template <typename T>
+struct FieldCodec<T, typename std::enable_if<std::is_integral<T>::value &&
+					     std::is_unsigned<T>::value &&
+					     !std::is_same<T, bool>::value>::type> {
+	static void Encode(const T &value, uint8_t *scratch, RecordView &view)
+	{
+		view.Len = EncodeVarint(scratch, value);
+		view.Val = scratch;
+	}
+
+	static bool Decode(const RecordView &view, T &value)
+	{
+		uint64_t	raw;
+
+		if (!ReadVarint(view, raw) ||
+		    (raw > std::numeric_limits<T>::max())) {
+			return false;
+		}
+
+		value = static_cast<T>(raw);
+		return true;
+	}
+};
+
+template <typename T>
+struct FieldCodec<T, typename std::enable_if<std::is_integral<T>::value &&
+					     std::is_signed<T>::value>::type> {
+	static void Encode(const T &value, uint8_t *scratch, RecordView &view)
+	{
+		view.Len = EncodeVarint(scratch, ZigZagEncode(value));
+		view.Val = scratch;
+	}
+
+	static bool Decode(const RecordView &view, T &value)
+	{
+		int64_t	raw;
+
+		if (!ReadSigned(view, raw) ||
+		    (raw < std::numeric_limits<T>::min()) ||
+		    (raw > std::numeric_limits<T>::max())) {
+			return false;
+		}
+
+		value = static_cast<T>(raw);
+		return true;
+	}
+};
+
+template <typename T>
+struct FieldCodec<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+	using Underlying = typename std::underlying_type<T>::type;
+
+	static void Encode(const T &value, uint8_t *scratch, RecordView &view)
+	{
+		FieldCodec<Underlying>::Encode(static_cast<Underlying>(value),
+					       scratch, view);
+	}
+
+	static bool Decode(const RecordView &view, T &value)
+	{
+		Underlying	raw;
+
+		if (!FieldCodec<Underlying>::Decode(view, raw)) {
+			return false;
+		}
+
+		value = static_cast<T>(raw);
+		return true;
+	}
+};
+
+template <>
+struct FieldCodec<bool> {
+	static void Encode(const bool &value, uint8_t *scratch, RecordView &view)
+	{
+		scratch[0] = value ? 1 : 0;
+		view.Len = 1;
+		view.Val = scratch;
+	}
+
+	static bool Decode(const RecordView &view, bool &value)
+	{
+		uint8_t	raw;
+
+		if (!ReadU8(view, raw) || (raw > 1)) {
+			return false;
+		}
+
+		value = (raw == 1);
+		return true;
+	}
+};
+
+template <>
+struct FieldCodec<float> {
+	static void Encode(const float &value, uint8_t *scratch, RecordView &view)
+	{
+		uint32_t	bits;
+
+		memcpy(&bits, &value, sizeof(bits));
+		EncodeLE(scratch, bits, sizeof(bits));
+		view.Len = sizeof(bits);
+		view.Val = scratch;
+	}
+
+	static bool Decode(const RecordView &view, float &value)
+	{
+		return ReadFloat(view, value);
+	}
+};
+
+template <>
+struct FieldCodec<double> {
+	static void Encode(const double &value, uint8_t *scratch, RecordView &view)
+	{
+		uint64_t	bits;
+
+		memcpy(&bits, &value, sizeof(bits));
+		EncodeLE(scratch, bits, sizeof(bits));
+		view.Len = sizeof(bits);
+		view.Val = scratch;
+	}
+
+	static bool Decode(const RecordView &view, double &value)
+	{
+		return ReadDouble(view, value);
+	}
+};
+
+template <>
+struct FieldCodec<std::string> {
+	static void Encode(const std::string &value, uint8_t *, RecordView &view)
+	{
+		view.Len = value.size();
+		view.Val = reinterpret_cast<const uint8_t *>(value.data());
+	}
+
+	static bool Decode(const RecordView &view, std::string &value)
+	{
+		value.assign(reinterpret_cast<const char *>(view.Val), view.Len);
+		return true;
+	}
+};
+
+
+/// \brief Field ties a tag to a member of S.
+template <typename S, typename T>
+struct Field {
+	/// Tag is the tag of the member's record.
+	uint8_t	 Tag;
+	/// Member points to the member.
+	T S::	*Member;
+};
+
+/// MakeField creates a Field for a schema.
+///
+/// \param tag The tag of the member's record.
+/// \param member A pointer to the member.
+/// \return The field.
+template <typename S, typename T>
+constexpr Field<S, T>
+MakeField(uint8_t tag, T S::*member)
+{
+	return Field<S, T>{tag, member};
+}
+
+
+/// \brief Schema stores a struct as a run of TLV records, one per field.
+///
+/// A schema is declared once, as a constexpr list of fields, and the code
+/// to encode and decode each field is generated at compile time; there's
+/// no lookup by tag or type at run time, and values are encoded straight
+/// into the arena rather than through a Record, so they can be longer
+/// than TLV_MAX_LEN.
+///
+/// ```
+/// struct Point {
+///     int32_t		X;
+///     int32_t		Y;
+///     std::string	Label;
+/// };
+///
+/// static constexpr auto pointSchema = TLV::MakeSchema(
+///     TLV::MakeField(1, &Point::X),
+///     TLV::MakeField(2, &Point::Y),
+///     TLV::MakeField(3, &Point::Label));
+///
+/// pointSchema.Write(arena, point);
+/// ```
+///
+/// The records are written in the order the fields are listed, and are
+/// read back in the same order, so the stored format only depends on the
+/// tags and types of the fields. Fields should only ever be added at the
+/// end of a schema.
+///
+/// \tparam S The struct the schema describes.
+/// \tparam Ts The types of the struct's fields.
+template <typename S, typename... Ts>
+class Schema {
+public:
+	static_assert(sizeof...(Ts) > 0, "a schema needs at least one field");
+
+	/// Fields is the number of fields in the schema.
+	static constexpr size_t Fields = sizeof...(Ts);
+
+	/// Create a schema from its fields. \see MakeSchema.
+	constexpr explicit Schema(Field<S, Ts>... fields)
+	    : fields(fields...)
+	{}
+
+	/// Write appends value's fields to the arena, as a batch: either
+	/// all of the fields are written, or none are. \see WriteBatch.
+	///
+	/// \param arena The backing memory store.
+	/// \param value The struct to write.
+	/// \return A pointer to the memory after the last record, or
+	///     nullptr if the struct couldn't be written.
+	uint8_t *Write(Arena &arena, const S &value) const
+	{
+		RecordView	views[Fields];
+		uint8_t		scratch[Fields][VARINT_MAX];
+
+		this->encode(value, views, scratch,
+			     std::index_sequence_for<Ts...>());
+		return WriteBatch(arena, views, Fields);
+	}
+
+	/// Read decodes a struct from the records starting at cursor.
+	/// Each field's record has to be present, in order, with the right
+	/// tag and a valid value.
+	///
+	/// \param arena The backing memory for the TLV store.
+	/// \param cursor The first record of the struct; if it's NULL,
+	///     reading starts at the arena's FirstRecord.
+	/// \param value Filled in with the struct. If the read fails, some
+	///     of its fields may have been changed.
+	/// \return A pointer to the memory after the struct's last record,
+	///     suitable for reading the next struct, or nullptr if the
+	///     records don't match the schema.
+	uint8_t *Read(Arena &arena, uint8_t *cursor, S &value) const
+	{
+		RecordIterator	 it(arena, cursor);
+		uint8_t		*end = nullptr;
+
+		if (!this->decode(it, value, end,
+				  std::index_sequence_for<Ts...>())) {
+			return nullptr;
+		}
+
+		return end;
+	}
+
+private:
+	template <size_t... I>
+	void encode(const S &value, RecordView *views,
+		    uint8_t (*scratch)[VARINT_MAX],
+		    std::index_sequence<I...>) const
+	{
+		using expand = int[];
+		(void)expand{0, (encodeField(std::get<I>(this->fields), value,
+					     views[I], scratch[I]), 0)...};
+	}
+
+	template <size_t... I>
+	bool decode(RecordIterator &it, S &value, uint8_t *&end,
+		    std::index_sequence<I...>) const
+	{
+		bool	ok = true;
+
+		using expand = int[];
+		(void)expand{0, (ok = ok && decodeField(std::get<I>(this->fields),
+							it, value, end), 0)...};
+		return ok;
+	}
+
+	template <typename T>
+	static void encodeField(const Field<S, T> &field, const S &value,
+				RecordView &view, uint8_t *scratch)
+	{
+		view.Tag = field.Tag;
+		FieldCodec<T>::Encode(value.*(field.Member), scratch, view);
+	}
+
+	template <typename T>
+	static bool decodeField(const Field<S, T> &field, RecordIterator &it,
+				S &value, uint8_t *&end)
+	{
+		if ((it == RecordIterator()) || (it->Tag != field.Tag) ||
+		    !FieldCodec<T>::Decode(*it, value.*(field.Member))) {
+			return false;
+		}
+
+		end = const_cast<uint8_t *>(it->Val) + it->Len;
+		++it;
+		return true;
+	}
+
+	std::tuple<Field<S, Ts>...>	fields;
+};
+
+
+/// MakeSchema creates a schema from a list of fields, which must all
+/// belong to the same struct.
+///
+/// \param fields The struct's fields, made with MakeField.
+/// \return The schema.
+template <typename S, typename... Ts>
+constexpr Schema<S, Ts...>
+MakeSchema(Field<S, Ts>... fields)
+{
+	return Schema<S, Ts...>(fields...);
+}
+
+
+} // namespace TLV
+} // namespace scsl
+
+
+#endif // SCSL_TLVSCHEMA_H
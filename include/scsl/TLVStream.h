@@ -0,0 +1,209 @@
+///
+/// \file include/scsl/TLVStream.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Streaming TLV records to and from file descriptors.
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that
+/// the above copyright notice and this permission notice appear in all /// copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+/// AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+/// DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+/// OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+/// TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+/// PERFORMANCE OF THIS SOFTWARE.
+///
+
+#ifndef SCSL_TLVSTREAM_H
+#define SCSL_TLVSTREAM_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "TLV.h"
+
+
+namespace scsl {
+namespace TLV {
+
+
+/// STREAM_WINDOW is the default size of a stream's buffer.
+static constexpr size_t STREAM_WINDOW = 64 * 1024;
+
+
+/// \brief StreamWriter appends TLV records to a file descriptor.
+///
+/// Records are encoded the same way as in an arena, so a file written by
+/// a StreamWriter can be loaded into an arena as well as streamed back
+/// with a StreamReader. Records are collected in a fixed-size window and
+/// written out when it fills, so memory use doesn't depend on how much
+/// is written; records larger than the window are written directly.
+///
+/// The writer doesn't own the file descriptor. Records still in the
+/// window are written out when the writer is destroyed, but errors are
+/// only reported by #Flush and #Sync.
+class StreamWriter {
+public:
+	/// Create a writer for a file descriptor opened for writing.
+	///
+	/// \param fd The file descriptor to append to.
+	/// \param window The size of the write buffer.
+	/// \param checksums If true, each record is followed by a checksum
+	///     record, as with REGION_CHECKSUMS, and TAG_CHECKSUM can't be
+	///     used as a record's tag.
+	explicit StreamWriter(int fd, size_t window = STREAM_WINDOW,
+			      bool checksums = false);
+
+	~StreamWriter();
+
+	StreamWriter(const StreamWriter &) = delete;
+	StreamWriter &operator=(const StreamWriter &) = delete;
+
+	/// Write appends a record with a value of any length.
+	///
+	/// \param tag The record's tag; it can't be TAG_EMPTY.
+	/// \param val The record's value.
+	/// \param len The length of the value.
+	/// \return Returns 0 on success and -1 on failure.
+	int Write(uint8_t tag, const uint8_t *val, size_t len);
+
+	/// Write appends a record.
+	///
+	/// \param rec The record to append.
+	/// \return Returns 0 on success and -1 on failure.
+	int Write(const Record &rec);
+
+	/// Flush writes out any records in the window.
+	///
+	/// \return Returns 0 on success and -1 on failure.
+	int Flush();
+
+	/// Sync flushes the window and syncs the file to disk.
+	///
+	/// \return Returns 0 on success and -1 on failure.
+	int Sync();
+
+	/// Written returns the number of bytes written so far, including
+	/// any still in the window.
+	size_t Written() const
+	{ return this->written; }
+
+private:
+	int append(const uint8_t *data, size_t len);
+
+	int			fd;
+	std::vector<uint8_t>	window;
+	size_t			used;
+	size_t			written;
+	bool			checksums;
+	bool			failed;
+};
+
+
+/// \brief StreamReader reads TLV records from a file descriptor in order.
+///
+/// Records are read through a fixed-size window, so a stream of any
+/// length can be scanned in one pass. The window only grows if a single
+/// record is larger than it; memory use is bounded by the larger of the
+/// window and the largest record. The file descriptor can be a pipe, as
+/// the reader never seeks.
+///
+/// The stream ends at end of file or at an empty tag, so arena files,
+/// which are padded with zeros, can be read too. A region header at the
+/// start of the stream is skipped, and its flags say which tags are
+/// reserved, as in an arena: tombstones, checksum records and sync
+/// markers are only skipped in streams that use them. If checksums are
+/// on, a record followed by a checksum record is verified before it is
+/// returned.
+///
+/// ```
+/// TLV::StreamReader	reader(fd);
+/// TLV::RecordView		view;
+///
+/// while (reader.Next(view)) {
+///     ...
+/// }
+/// if (reader.Failed()) {
+///     ...
+/// }
+/// ```
+class StreamReader {
+public:
+	/// Create a reader for a file descriptor opened for reading.
+	///
+	/// \param fd The file descriptor to read from.
+	/// \param window The size of the read buffer.
+	/// \param checksums If true, records are checked against the
+	///     checksum records following them, as written by a StreamWriter
+	///     with checksums. Streams that start with a region header with
+	///     REGION_CHECKSUMS are always checked.
+	explicit StreamReader(int fd, size_t window = STREAM_WINDOW,
+			      bool checksums = false);
+
+	StreamReader(const StreamReader &) = delete;
+	StreamReader &operator=(const StreamReader &) = delete;
+
+	/// Next reads the next record. The view points into the reader's
+	/// window and is valid until the next call to Next.
+	///
+	/// \param view Filled in with the record.
+	/// \return True if a record was read; false at the end of the
+	///     stream or on an error. \see Failed.
+	bool Next(RecordView &view);
+
+	/// Next reads the next record into a Record. A record that is too
+	/// long for a Record is an error.
+	///
+	/// \param rec Filled in with the record.
+	/// \return True if a record was read.
+	bool Next(Record &rec);
+
+	/// Failed reports whether the stream ended because of an error: a
+	/// read error, a truncated or malformed record, or a checksum
+	/// mismatch.
+	///
+	/// \return True if an error stopped the reader.
+	bool Failed() const
+	{ return this->failed; }
+
+	/// Offset returns the position in the stream of the last record
+	/// read by #Next.
+	///
+	/// \return The record's offset from the start of the stream.
+	size_t Offset() const
+	{ return this->offset; }
+
+private:
+	bool fill(size_t need);
+	bool parse(Header &hdr);
+	bool reserved(uint8_t tag) const;
+	bool verify(size_t size);
+
+	int			fd;
+	std::vector<uint8_t>	window;
+	size_t			base;
+	size_t			keep;
+	size_t			pos;
+	size_t			end;
+	size_t			offset;
+	uint16_t		flags;
+	bool			region;
+	bool			eof;
+	bool			done;
+	bool			failed;
+};
+
+
+} // namespace TLV
+} // namespace scsl
+
+
+#endif // SCSL_TLVSTREAM_H
@@ -0,0 +1,179 @@
+///
+/// \file include/scsl/TLVTypes.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Typed values for TLV records.
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that
+/// the above copyright notice and this permission notice appear in all /// copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+/// AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+/// DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+/// OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+/// TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+/// PERFORMANCE OF THIS SOFTWARE.
+///
+
+#ifndef SCSL_TLVTYPES_H
+#define SCSL_TLVTYPES_H
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Arena.h"
+#include "TLV.h"
+
+
+namespace scsl {
+namespace TLV {
+
+
+/// VARINT_MAX is the most bytes a varint-encoded 64-bit value can take.
+static constexpr size_t VARINT_MAX = 10;
+
+
+/// EncodeLE stores the low n bytes of value at dst, least significant
+/// byte first.
+///
+/// \param dst The buffer to write to; it must hold at least n bytes.
+/// \param value The value to store.
+/// \param n The number of bytes to store, up to 8.
+void EncodeLE(uint8_t *dst, uint64_t value, size_t n);
+
+/// DecodeLE loads an n-byte little-endian value from src.
+///
+/// \param src The buffer to read from.
+/// \param n The number of bytes to load, up to 8.
+/// \return The value.
+uint64_t DecodeLE(const uint8_t *src, size_t n);
+
+/// EncodeVarint stores value at dst as a LEB128 varint: seven bits per
+/// byte, least significant first, with the high bit set on every byte but
+/// the last.
+///
+/// \param dst The buffer to write to; it must hold VARINT_MAX bytes.
+/// \param value The value to store.
+/// \return The number of bytes written.
+size_t EncodeVarint(uint8_t *dst, uint64_t value);
+
+/// DecodeVarint loads a varint from the first avail bytes of src.
+///
+/// \param src The buffer to read from.
+/// \param avail The number of bytes available at src.
+/// \param value Filled in with the value.
+/// \return The number of bytes read, or 0 if the varint runs past avail
+///     or doesn't fit in 64 bits.
+size_t DecodeVarint(const uint8_t *src, size_t avail, uint64_t &value);
+
+/// ZigZagEncode maps a signed value to an unsigned one so that values
+/// near zero, positive or negative, have short varints: 0, -1, 1, -2, ...
+/// become 0, 1, 2, 3, ...
+inline uint64_t
+ZigZagEncode(int64_t value)
+{
+	return (static_cast<uint64_t>(value) << 1) ^
+	       static_cast<uint64_t>(value >> 63);
+}
+
+/// ZigZagDecode undoes ZigZagEncode.
+inline int64_t
+ZigZagDecode(uint64_t value)
+{
+	return static_cast<int64_t>(value >> 1) ^
+	       -static_cast<int64_t>(value & 1);
+}
+
+
+/// WriteU8 writes a record holding a one-byte value. Like the other typed
+/// writers, it's a wrapper around WriteValue, so the cursor, growth and
+/// region behaviour are the same.
+///
+/// \param arena The backing memory store.
+/// \param cursor Pointer into the arena's memory, or nullptr to append.
+/// \param tag The record's tag.
+/// \param value The value to store.
+/// \return A pointer to the memory after the record, or nullptr if it
+///     couldn't be written.
+uint8_t *WriteU8(Arena &arena, uint8_t *cursor, uint8_t tag, uint8_t value);
+
+/// WriteU16 writes a record holding a two-byte little-endian value.
+/// \see WriteU8.
+uint8_t *WriteU16(Arena &arena, uint8_t *cursor, uint8_t tag,
+		  uint16_t value);
+
+/// WriteU32 writes a record holding a four-byte little-endian value.
+/// \see WriteU8.
+uint8_t *WriteU32(Arena &arena, uint8_t *cursor, uint8_t tag,
+		  uint32_t value);
+
+/// WriteU64 writes a record holding an eight-byte little-endian value.
+/// \see WriteU8.
+uint8_t *WriteU64(Arena &arena, uint8_t *cursor, uint8_t tag,
+		  uint64_t value);
+
+/// WriteVarint writes a record holding an unsigned value as a varint,
+/// which takes one byte for values below 128 and up to VARINT_MAX bytes
+/// for the largest. \see WriteU8.
+uint8_t *WriteVarint(Arena &arena, uint8_t *cursor, uint8_t tag,
+		     uint64_t value);
+
+/// WriteSigned writes a record holding a signed value as a zigzag
+/// varint. \see WriteVarint.
+uint8_t *WriteSigned(Arena &arena, uint8_t *cursor, uint8_t tag,
+		     int64_t value);
+
+/// WriteFloat writes a record holding the four-byte IEEE 754 encoding of
+/// a float, stored little-endian. \see WriteU8.
+uint8_t *WriteFloat(Arena &arena, uint8_t *cursor, uint8_t tag,
+		    float value);
+
+/// WriteDouble writes a record holding the eight-byte IEEE 754 encoding
+/// of a double, stored little-endian. \see WriteU8.
+uint8_t *WriteDouble(Arena &arena, uint8_t *cursor, uint8_t tag,
+		     double value);
+
+
+/// ReadU8 decodes a record written by WriteU8. Like the other typed
+/// readers, it works on a view, so the value is decoded straight from
+/// the arena.
+///
+/// \param view The record to decode.
+/// \param value Filled in with the value.
+/// \return True if the record's value has the right length for the type.
+bool ReadU8(const RecordView &view, uint8_t &value);
+
+/// ReadU16 decodes a record written by WriteU16. \see ReadU8.
+bool ReadU16(const RecordView &view, uint16_t &value);
+
+/// ReadU32 decodes a record written by WriteU32. \see ReadU8.
+bool ReadU32(const RecordView &view, uint32_t &value);
+
+/// ReadU64 decodes a record written by WriteU64. \see ReadU8.
+bool ReadU64(const RecordView &view, uint64_t &value);
+
+/// ReadVarint decodes a record written by WriteVarint. The varint has to
+/// take up the whole value. \see ReadU8.
+bool ReadVarint(const RecordView &view, uint64_t &value);
+
+/// ReadSigned decodes a record written by WriteSigned. \see ReadVarint.
+bool ReadSigned(const RecordView &view, int64_t &value);
+
+/// ReadFloat decodes a record written by WriteFloat. \see ReadU8.
+bool ReadFloat(const RecordView &view, float &value);
+
+/// ReadDouble decodes a record written by WriteDouble. \see ReadU8.
+bool ReadDouble(const RecordView &view, double &value);
+
+
+} // namespace TLV
+} // namespace scsl
+
+
+#endif // SCSL_TLVTYPES_H
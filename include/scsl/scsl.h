@@ -29,13 +29,20 @@
 
 
 #include <scsl/Arena.h>
+#include <scsl/ArenaAllocator.h>
+#include <scsl/ArenaReplicas.h>
 #include <scsl/Buffer.h>
 #include <scsl/Commander.h>
+#include <scsl/CRC32C.h>
 #include <scsl/Dictionary.h>
 #include <scsl/Exceptions.h>
 #include <scsl/Flags.h>
+#include <scsl/Pool.h>
 #include <scsl/StringUtil.h>
 #include <scsl/TLV.h>
+#include <scsl/TLVSchema.h>
+#include <scsl/TLVStream.h>
+#include <scsl/TLVTypes.h>
 #include <scsl/Test.h>
 
 
@@ -118,6 +118,31 @@ putKey(std::vector<std::string> argv)
 }
 
 
+static bool
+showStats(std::vector<std::string> argv)
+{
+	(void) argv; // provided for interface compatibility.
+	cout << "[+] arena stats for '" << pbFile << "':\n";
+	cout << arena.Stats();
+	return true;
+}
+
+
+static bool
+verifyPhonebook(std::vector<std::string> argv)
+{
+	(void) argv; // provided for interface compatibility.
+	cout << "[+] verifying '" << pbFile << "': ";
+	if (!TLV::Verify(arena)) {
+		cout << "corrupt\n";
+		return false;
+	}
+
+	cout << "ok\n";
+	return true;
+}
+
+
 static void
 usage(ostream &os, int exc)
 {
@@ -129,7 +154,9 @@ usage(ostream &os, int exc)
 	os << "\tphonebook [-f file] del key\n";
 	os << "\tphonebook [-f file] has key\n";
 	os << "\tphonebook [-f file] get key\n";
-	os << "\tphonebook [-f file] put key value\n";
+	os << "\tphonebook [-f file] [-g] put key value\n";
+	os << "\tphonebook [-f file] stats\n";
+	os << "\tphonebook [-f file] verify\n";
 	os << "\n";
 
 	exit(exc);
@@ -140,11 +167,13 @@ main(int argc, char *argv[])
 {
 	int retc = 1;
 	bool help = false;
+	bool grow = false;
 	std::string fileName(pbFile);
 
 	auto *flags = new scsl::Flags("phonebook",
 				      "A tool for interacting with Arena-backed dictionary files.");
 	flags->Register("-f", pbFile, "path to a phonebook file");
+	flags->Register("-g", false, "grow the phonebook file as needed");
 	flags->Register("-h", false, "print a help message");
 
 	auto parsed = flags->Parse(argc, argv);
@@ -155,6 +184,7 @@ main(int argc, char *argv[])
 	}
 
 	flags->GetString("-f", fileName);
+	flags->GetBool("-g", grow);
 	flags->GetBool("-h", help);
 
 	pbFile = fileName;
@@ -174,14 +204,32 @@ main(int argc, char *argv[])
 	commander.Register(Subcommand("has", 1, hasKey));
 	commander.Register(Subcommand("get", 1, getKey));
 	commander.Register(Subcommand("put", 2, putKey));
+	commander.Register(Subcommand("stats", 0, showStats));
+	commander.Register(Subcommand("verify", 0, verifyPhonebook));
 
 	auto command = flags->Arg(0);
-	if (command != "new") {
+	if (command == "list") {
+		// Listing works from a snapshot so that it sees a stable
+		// image of the phonebook while it's being written to.
+		cout << "[+] loading phonebook snapshot from " << pbFile << "\n";
+		if (arena.Snapshot(pbFile.c_str()) != 0) {
+			cerr << "Failed to open " << pbFile << "\n";
+			exit(1);
+		}
+	} else if (command != "new") {
+		ArenaOptions	options;
+
+		options.ReadOnly = (command == "has") || (command == "get") ||
+				   (command == "stats") || (command == "verify");
 		cout << "[+] loading phonebook from " << pbFile << "\n";
-		if (arena.Open(pbFile.c_str()) != 0) {
+		if (arena.Open(pbFile.c_str(), options) != 0) {
 			cerr << "Failed to open " << pbFile << "\n";
 			exit(1);
 		}
+
+		if (grow) {
+			arena.EnableAutoGrow();
+		}
 	}
 
 	auto args = flags->Args();
@@ -191,6 +239,10 @@ main(int argc, char *argv[])
 
 	switch (result) {
 	case Subcommand::Status::OK:
+		if (arena.FlushDirty() != 0) {
+			cerr << "[!] failed to flush " << pbFile << "\n";
+			break;
+		}
 		std::cout << "[+] OK\n";
 		retc = 0;
 		break;
@@ -24,155 +24,1317 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ios>
+#include <new>
+#include <string>
+#include <vector>
 
 #include <scsl/Arena.h>
 
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
 #define PROT_RW                (PROT_WRITE|PROT_READ)
 
 
-namespace scsl {
+namespace scsl {
+
+
+/// Chunk is the header for a single chunk in a chunked arena; the chunk's
+/// memory immediately follows the header.
+struct alignas(std::max_align_t) Arena::Chunk {
+	Chunk	*next;
+	size_t	 base;
+	size_t	 size;
+
+	uint8_t *Data()
+	{ return reinterpret_cast<uint8_t *>(this + 1); }
+};
+
+
+/// bumpOffset finds the offset into mem at which an aligned allocation of
+/// allocSize bytes can be made, starting the search at offset.
+static bool
+bumpOffset(const uint8_t *mem, size_t memSize, size_t &offset,
+	   size_t allocSize, size_t align)
+{
+	uintptr_t	base = reinterpret_cast<uintptr_t>(mem);
+	uintptr_t	aligned;
+	size_t		next;
+
+	aligned = (base + offset + (align - 1)) & ~(uintptr_t)(align - 1);
+	next = static_cast<size_t>(aligned - base);
+
+	if ((next > memSize) || (allocSize > (memSize - next))) {
+		return false;
+	}
+
+	offset = next;
+	return true;
+}
+
+
+/// adviseRange passes advice to the kernel for the whole pages inside mem;
+/// allocated memory isn't necessarily page-aligned. Advice is only a hint,
+/// so failures are ignored.
+static void
+adviseRange(uint8_t *mem, size_t len, int advice)
+{
+	auto		pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+	uintptr_t	start = reinterpret_cast<uintptr_t>(mem);
+	uintptr_t	end = start + len;
+
+	start = (start + pageSize - 1) & ~(pageSize - 1);
+	end &= ~(pageSize - 1);
+	if (start >= end) {
+		return;
+	}
+
+	(void)madvise(reinterpret_cast<void *>(start), end - start, advice);
+}
+
+
+/// prefault faults in the pages in mem. File mappings are read-faulted, so
+/// pages aren't dirtied; anonymous memory has to be write-faulted, or it
+/// would all be backed by the shared zero page.
+static void
+prefault(uint8_t *mem, size_t len, bool write)
+{
+	auto	pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+#if defined(MADV_POPULATE_READ) && defined(MADV_POPULATE_WRITE)
+	if (madvise(mem, len, write ? MADV_POPULATE_WRITE : MADV_POPULATE_READ) == 0) {
+		return;
+	}
+#endif
+
+	for (size_t i = 0; i < len; i += pageSize) {
+		auto *page = static_cast<volatile uint8_t *>(mem + i);
+		if (write) {
+			*page = *page;
+		} else {
+			(void)*page;
+		}
+	}
+}
+
+
+/// maxNumaNodes is the number of NUMA nodes that arenas can be placed on.
+static constexpr unsigned int	maxNumaNodes = 1024;
+static constexpr size_t		nodeMaskBits = sizeof(unsigned long) * 8;
+static constexpr size_t		nodeMaskWords = maxNumaNodes / nodeMaskBits;
+
+
+/// onlineNodes reads the list of online NUMA nodes (e.g. "0-1,4") into
+/// mask, returning one more than the highest online node, or 0 if the list
+/// can't be read.
+static unsigned int
+onlineNodes(unsigned long *mask)
+{
+	unsigned int	 first;
+	unsigned int	 last;
+	unsigned int	 count = 0;
+	int		 sep;
+	FILE		*nodeList;
+
+	nodeList = fopen("/sys/devices/system/node/online", "r");
+	if (nodeList == nullptr) {
+		return 0;
+	}
+
+	while (fscanf(nodeList, "%u", &first) == 1) {
+		last = first;
+		sep = fgetc(nodeList);
+		if (sep == '-') {
+			if (fscanf(nodeList, "%u", &last) != 1) {
+				break;
+			}
+			sep = fgetc(nodeList);
+		}
+
+		for (auto node = first; (node <= last) && (node < maxNumaNodes); node++) {
+			mask[node / nodeMaskBits] |= 1UL << (node % nodeMaskBits);
+			if (node >= count) {
+				count = node + 1;
+			}
+		}
+
+		if (sep != ',') {
+			break;
+		}
+	}
+
+	fclose(nodeList);
+	return count;
+}
+
+
+/// placeRange applies a NUMA policy to mem, which must be page-aligned.
+/// Like the other hints, a policy the kernel rejects is ignored, and
+/// nothing is done on machines with a single node.
+static void
+placeRange(uint8_t *mem, size_t len, ArenaNuma numa, unsigned int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+	unsigned long	online[nodeMaskWords] = {};
+	unsigned long	nodes[nodeMaskWords] = {};
+	int		mode;
+
+	if ((numa == ArenaNuma::Default) || (onlineNodes(online) < 2)) {
+		return;
+	}
+
+	switch (numa) {
+	case ArenaNuma::Bind:
+		mode = MPOL_BIND;
+		break;
+	case ArenaNuma::Preferred:
+		mode = MPOL_PREFERRED;
+		break;
+	default:
+		mode = MPOL_INTERLEAVE;
+		break;
+	}
+
+	if (mode == MPOL_INTERLEAVE) {
+		memcpy(nodes, online, sizeof(nodes));
+	} else if (node < maxNumaNodes) {
+		nodes[node / nodeMaskBits] = 1UL << (node % nodeMaskBits);
+	} else {
+		return;
+	}
+
+	// The kernel reads one less than maxnode bits from the mask.
+	(void)syscall(SYS_mbind, mem, len, mode, nodes, maxNumaNodes + 1, 0);
+#else
+	(void)mem;
+	(void)len;
+	(void)numa;
+	(void)node;
+#endif
+}
+
+
+/// sharedMemoryFile creates a shared memory object, returning a descriptor
+/// for it. Named objects replace any existing object with the same name.
+/// Anonymous objects come from memfd_create where it's available; elsewhere,
+/// a uniquely-named object is created and unlinked straight away so that
+/// the descriptor is the only reference to it.
+static int
+sharedMemoryFile(const char *name)
+{
+	if (name != nullptr) {
+		return shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	}
+
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+	return memfd_create("scsl-arena", MFD_CLOEXEC);
+#else
+	static unsigned int	sequence = 0;
+	char			tmpName[64];
+	int			shmFileDes;
+
+	snprintf(tmpName, sizeof(tmpName), "/scsl-arena-%ld-%u",
+		 static_cast<long>(getpid()), sequence++);
+	shmFileDes = shm_open(tmpName, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (shmFileDes != -1) {
+		(void)shm_unlink(tmpName);
+	}
+	return shmFileDes;
+#endif
+}
+
+
+/// elapsed returns the time since start, for the arena's statistics.
+static std::chrono::nanoseconds
+elapsed(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+	    std::chrono::steady_clock::now() - start);
+}
+
+
+/// openTempFile creates a new file next to path for Write to fill in and
+/// rename into place, storing its name in tmpPath. If path already exists,
+/// the new file is given the same permissions.
+static int
+openTempFile(const char *path, std::string &tmpPath)
+{
+	static std::atomic<unsigned int>	sequence{0};
+	struct stat				st{};
+	int					tmpFileDes = -1;
+
+	for (int attempt = 0; attempt < 16; attempt++) {
+		tmpPath = std::string(path) + ".tmp." + std::to_string(getpid()) +
+			  "." + std::to_string(sequence++);
+		tmpFileDes = open(tmpPath.c_str(),
+				  O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+		if ((tmpFileDes != -1) || (errno != EEXIST)) {
+			break;
+		}
+	}
+
+	if ((tmpFileDes != -1) && (stat(path, &st) == 0)) {
+		(void)fchmod(tmpFileDes, st.st_mode & 07777);
+	}
+	return tmpFileDes;
+}
+
+
+/// copyToFile copies the first len bytes of an arena into dstFileDes. If
+/// the arena's memory is backed by srcFileDes, the kernel copies the data
+/// across without it passing through user space; anything it can't copy is
+/// written straight from the arena's memory.
+static int
+copyToFile(int dstFileDes, int srcFileDes, const uint8_t *mem, size_t len)
+{
+	size_t	copied = 0;
+
+#if defined(__linux__)
+	loff_t	inOffset = 0;
+	loff_t	outOffset = 0;
+
+	while ((srcFileDes != -1) && (copied < len)) {
+		auto n = copy_file_range(srcFileDes, &inOffset, dstFileDes,
+					 &outOffset, len - copied, 0);
+		if (n <= 0) {
+			break;
+		}
+		copied += static_cast<size_t>(n);
+	}
+#else
+	(void)srcFileDes;
+#endif
+
+	while (copied < len) {
+		auto n = pwrite(dstFileDes, mem + copied, len - copied,
+				static_cast<off_t>(copied));
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		copied += static_cast<size_t>(n);
+	}
+
+	return 0;
+}
+
+
+/// syncParent syncs the directory containing path, so that a file renamed
+/// into it survives a crash.
+static int
+syncParent(const char *path)
+{
+	std::string	dir(path);
+	auto		slash = dir.rfind('/');
+	int		dirFileDes;
+	int		retc;
+
+	if (slash == std::string::npos) {
+		dir = ".";
+	} else if (slash == 0) {
+		dir = "/";
+	} else {
+		dir.resize(slash);
+	}
+
+	dirFileDes = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirFileDes == -1) {
+		return -1;
+	}
+
+	retc = fsync(dirFileDes);
+	close(dirFileDes);
+	return retc;
+}
+
+
+/// lazyClearSize is the size above which Clear hands whole pages back to
+/// the kernel to be zeroed on next use, rather than zeroing them itself.
+static constexpr size_t	lazyClearSize = 64 * 1024;
+
+
+Arena::Arena()
+    : store(nullptr), size(0), used(0), highWater(0), fd(-1), arenaType(ArenaType::Uninit),
+      chunks(nullptr), current(nullptr), growth(0), limit(0), autoGrow(false),
+      dirtyStart(0), dirtyEnd(0), ringHead(0), ringTail(0)
+{
+}
+
+
+Arena::~Arena()
+{
+	this->Destroy();
+}
+
+
+int
+Arena::SetStatic(uint8_t *mem, size_t memSize)
+{
+	this->store = mem;
+	this->size = memSize;
+	this->used = 0;
+	this->highWater = memSize;
+	this->arenaType = ArenaType::Static;
+	return 0;
+}
+
+
+int
+Arena::SetAlloc(size_t allocSize, const ArenaOptions &arenaOptions)
+{
+	int	 flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	bool	 populated = false;
+	void	*mem;
+
+	if (this->size > 0) {
+		this->Destroy();
+	}
+
+	if (allocSize == 0) {
+		return -1;
+	}
+
+	// Anonymous memory is zero-filled by the kernel as it's first
+	// touched, so the arena doesn't need to be cleared up front.
+#if defined(MAP_POPULATE)
+	if (arenaOptions.Prefault && !arenaOptions.HugePages &&
+	    (arenaOptions.Numa == ArenaNuma::Default)) {
+		flags |= MAP_POPULATE;
+		populated = true;
+	}
+#endif
+
+	mem = mmap(nullptr, allocSize, PROT_RW, flags, -1, 0);
+	if (mem == MAP_FAILED) {
+		return -1;
+	}
+
+	this->arenaType = ArenaType::Alloc;
+	this->size = allocSize;
+	this->used = 0;
+	this->highWater = 0;
+	this->store = static_cast<uint8_t *>(mem);
+	this->options = arenaOptions;
+
+	if (this->applyOptions(this->store, this->size) != 0) {
+		this->Destroy();
+		return -1;
+	}
+
+	if (this->options.Prefault && !populated) {
+		prefault(this->store, this->size, true);
+	}
+	return 0;
+}
+
+
+int
+Arena::SetChunked(size_t chunkSize, unsigned int growthFactor,
+		  size_t maxReserved)
+{
+	if (this->size > 0) {
+		this->Destroy();
+	}
+
+	if ((chunkSize == 0) || (growthFactor == 0)) {
+		return -1;
+	}
+
+	if ((maxReserved != 0) && (chunkSize > maxReserved)) {
+		return -1;
+	}
+
+	this->growth = growthFactor;
+	this->limit = maxReserved;
+	if (!this->growChunks(chunkSize)) {
+		return -1;
+	}
+
+	this->arenaType = ArenaType::Chunked;
+	this->current = this->chunks;
+	this->store = this->chunks->Data();
+	this->size = chunkSize;
+	this->used = 0;
+	this->highWater = 0;
+	return 0;
+}
+
+
+int
+Arena::SetRing(size_t ringSize)
+{
+	auto	 pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	int	 ringFileDes;
+	uint8_t	*base;
+	void	*mem;
+
+	if (this->size > 0) {
+		this->Destroy();
+	}
+
+	if (ringSize == 0) {
+		return -1;
+	}
+
+	// Each copy has to be mapped on a page boundary.
+	ringSize = (ringSize + pageSize - 1) & ~(pageSize - 1);
+
+	ringFileDes = sharedMemoryFile(nullptr);
+	if (ringFileDes == -1) {
+		return -1;
+	}
+
+	if (ftruncate(ringFileDes, static_cast<off_t>(ringSize)) != 0) {
+		close(ringFileDes);
+		return -1;
+	}
+
+	// Reserve room for both copies first, so that nothing else can be
+	// mapped between them, then map the memory over each half.
+	mem = mmap(nullptr, ringSize * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+		   -1, 0);
+	if (mem == MAP_FAILED) {
+		close(ringFileDes);
+		return -1;
+	}
+
+	base = static_cast<uint8_t *>(mem);
+	if ((mmap(base, ringSize, PROT_RW, MAP_SHARED | MAP_FIXED,
+		  ringFileDes, 0) == MAP_FAILED) ||
+	    (mmap(base + ringSize, ringSize, PROT_RW, MAP_SHARED | MAP_FIXED,
+		  ringFileDes, 0) == MAP_FAILED)) {
+		munmap(base, ringSize * 2);
+		close(ringFileDes);
+		return -1;
+	}
+
+	// The mappings keep the memory alive.
+	close(ringFileDes);
+
+	this->arenaType = ArenaType::Ring;
+	this->store = base;
+	this->size = ringSize;
+	this->used = 0;
+	this->highWater = 0;
+	this->ringHead.store(0);
+	this->ringTail.store(0);
+	return 0;
+}
+
+
+uint8_t *
+Arena::RingReserve(size_t len)
+{
+	if ((this->arenaType != ArenaType::Ring) || (len > this->RingFree())) {
+		return nullptr;
+	}
+
+	return this->store +
+	       (this->ringTail.load(std::memory_order_relaxed) % this->size);
+}
+
+
+int
+Arena::RingCommit(size_t len)
+{
+	if ((this->arenaType != ArenaType::Ring) || (len > this->RingFree())) {
+		return -1;
+	}
+
+	auto	tail = this->ringTail.load(std::memory_order_relaxed);
+	auto	end = (tail % this->size) + len;
+
+	// Once the ring has wrapped, any of it may have been written.
+	if (end > this->size) {
+		end = this->size;
+	}
+
+	if (end > this->highWater) {
+		this->highWater = end;
+	}
+
+	this->ringTail.store(tail + len, std::memory_order_release);
+	return 0;
+}
+
+
+uint8_t *
+Arena::RingPeek(size_t len)
+{
+	if ((this->arenaType != ArenaType::Ring) || (len > this->RingUsed())) {
+		return nullptr;
+	}
+
+	return this->store +
+	       (this->ringHead.load(std::memory_order_relaxed) % this->size);
+}
+
+
+int
+Arena::RingConsume(size_t len)
+{
+	if ((this->arenaType != ArenaType::Ring) || (len > this->RingUsed())) {
+		return -1;
+	}
+
+	auto	head = this->ringHead.load(std::memory_order_relaxed);
+	this->ringHead.store(head + len, std::memory_order_release);
+	return 0;
+}
+
+
+int
+Arena::RingWrite(const uint8_t *data, size_t len)
+{
+	auto	*tail = this->RingReserve(len);
+
+	if (tail == nullptr) {
+		return -1;
+	}
+
+	memcpy(tail, data, len);
+	return this->RingCommit(len);
+}
+
+
+int
+Arena::RingRead(uint8_t *data, size_t len)
+{
+	auto	*head = this->RingPeek(len);
+
+	if (head == nullptr) {
+		return -1;
+	}
+
+	memcpy(data, head, len);
+	return this->RingConsume(len);
+}
+
+
+int
+Arena::MemoryMap(int memFileDes, size_t memSize,
+		 const ArenaOptions &arenaOptions)
+{
+	int	flags = MAP_SHARED;
+	int	prot = PROT_RW;
+	bool	populated = false;
+
+	if (this->size > 0) {
+		this->Destroy();
+	}
+
+	if (arenaOptions.Private) {
+		flags = MAP_PRIVATE;
+	}
+
+	if (arenaOptions.ReadOnly) {
+		prot = PROT_READ;
+	}
+
+	// Huge page and placement advice have to be given before the
+	// pages are faulted in, so MAP_POPULATE can only be used without
+	// them.
+#if defined(MAP_POPULATE)
+	if (arenaOptions.Prefault && !arenaOptions.HugePages &&
+	    (arenaOptions.Numa == ArenaNuma::Default)) {
+		flags |= MAP_POPULATE;
+		populated = true;
+	}
+#endif
+
+	// Nothing is known about what's in the file, so all of it has to
+	// be treated as used.
+	this->arenaType = ArenaType::MemoryMapped;
+	this->size = memSize;
+	this->used = 0;
+	this->highWater = memSize;
+	this->options = arenaOptions;
+	this->store = static_cast<uint8_t *>(mmap(nullptr, memSize, prot, flags,
+				       memFileDes, 0));
+	if (static_cast<void *>(this->store) == MAP_FAILED) {
+		// Leave the arena uninitialized so that Destroy doesn't
+		// try to unmap it.
+		this->arenaType = ArenaType::Uninit;
+		this->size = 0;
+		this->highWater = 0;
+		this->store = nullptr;
+		this->options = ArenaOptions();
+		return -1;
+	}
+	this->fd = memFileDes;
+
+	if (this->applyOptions(this->store, this->size) != 0) {
+		// The caller still owns the descriptor on failure.
+		this->fd = -1;
+		this->Destroy();
+		return -1;
+	}
+
+	if (this->options.Prefault && !populated) {
+		prefault(this->store, this->size, false);
+	}
+	return 0;
+}
+
+
+int
+Arena::applyOptions(uint8_t *mem, size_t len)
+{
+	if (len == 0) {
+		return 0;
+	}
+
+	// Placement and huge page advice have to be given before the
+	// pages are faulted in.
+	placeRange(mem, len, this->options.Numa, this->options.NumaNode);
+
+#if defined(MADV_HUGEPAGE)
+	if (this->options.HugePages) {
+		adviseRange(mem, len, MADV_HUGEPAGE);
+	}
+#endif
+
+	switch (this->options.Access) {
+	case ArenaAccess::Sequential:
+		adviseRange(mem, len, MADV_SEQUENTIAL);
+		break;
+	case ArenaAccess::Random:
+		adviseRange(mem, len, MADV_RANDOM);
+		break;
+	default:
+		break;
+	}
+
+	if (this->options.WillNeed) {
+		adviseRange(mem, len, MADV_WILLNEED);
+	}
+
+	if (this->options.Lock) {
+		if (mlock(mem, len) != 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+int
+Arena::Open(const char *path, const ArenaOptions &arenaOptions)
+{
+	struct stat st{};
+
+	if (this->size > 0) {
+		this->Destroy();
+	}
+
+	this->fd = open(path, arenaOptions.ReadOnly ? O_RDONLY : O_RDWR);
+	if (this->fd == -1) {
+		return -1;
+	}
+
+	if (stat(path, &st) != 0) {
+		return -1;
+	}
+
+	return this->MemoryMap(this->fd, static_cast<size_t>(st.st_size),
+			       arenaOptions);
+}
+
+
+int
+Arena::Snapshot(const char *path, const ArenaOptions &arenaOptions)
+{
+	ArenaOptions	 snapOptions = arenaOptions;
+	auto		 pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	struct stat	 st{};
+	int		 snapFileDes;
+
+	if (this->size > 0) {
+		this->Destroy();
+	}
+
+	snapFileDes = open(path, O_RDONLY);
+	if (snapFileDes == -1) {
+		return -1;
+	}
+
+	if (fstat(snapFileDes, &st) != 0) {
+		close(snapFileDes);
+		return -1;
+	}
+
+	// The mapping has to be writable while the pages are copied; it's
+	// made read-only afterwards.
+	snapOptions.Private = true;
+	snapOptions.ReadOnly = false;
+	snapOptions.Prefault = false;
+	if (this->MemoryMap(snapFileDes, static_cast<size_t>(st.st_size),
+			    snapOptions) != 0) {
+		close(snapFileDes);
+		return -1;
+	}
+
+	// Write-faulting every page gives the arena its own copy, which
+	// detaches it from later changes to the file.
+#if defined(MADV_POPULATE_WRITE)
+	if (madvise(this->store, this->size, MADV_POPULATE_WRITE) != 0)
+#endif
+	{
+		for (size_t i = 0; i < this->size; i += pageSize) {
+			auto *page = static_cast<volatile uint8_t *>(this->store + i);
+			*page = *page;
+		}
+	}
+
+	if (mprotect(this->store, this->size, PROT_READ) != 0) {
+		this->Destroy();
+		return -1;
+	}
+
+	this->options.ReadOnly = true;
+	return 0;
+}
+
+
+int
+Arena::CreateShared(const char *name, size_t memSize,
+		    const ArenaOptions &arenaOptions)
+{
+	ArenaOptions	shmOptions = arenaOptions;
+	int		shmFileDes;
+
+	if (this->size > 0) {
+		this->Destroy();
+	}
+
+	if (memSize == 0) {
+		return -1;
+	}
+
+	shmFileDes = sharedMemoryFile(name);
+	if (shmFileDes == -1) {
+		return -1;
+	}
+
+	// The new object is empty; extending it zero-fills it without
+	// touching any memory.
+	shmOptions.ReadOnly = false;
+	shmOptions.Private = false;
+	if ((ftruncate(shmFileDes, static_cast<off_t>(memSize)) != 0) ||
+	    (this->MapShared(shmFileDes, shmOptions) != 0)) {
+		close(shmFileDes);
+		if (name != nullptr) {
+			(void)shm_unlink(name);
+		}
+		return -1;
+	}
+
+	this->highWater = 0;
+	return 0;
+}
+
+
+int
+Arena::MapShared(int memFileDes, const ArenaOptions &arenaOptions)
+{
+	struct stat st{};
+
+	if (this->size > 0) {
+		this->Destroy();
+	}
+
+	if ((fstat(memFileDes, &st) != 0) || (st.st_size <= 0)) {
+		return -1;
+	}
+
+	if (this->MemoryMap(memFileDes, static_cast<size_t>(st.st_size),
+			    arenaOptions) != 0) {
+		return -1;
+	}
+
+	this->arenaType = ArenaType::SharedMemory;
+	return 0;
+}
+
+
+int
+Arena::OpenShared(const char *name, const ArenaOptions &arenaOptions)
+{
+	int	shmFileDes;
+
+	if (this->size > 0) {
+		this->Destroy();
+	}
+
+	shmFileDes = shm_open(name, arenaOptions.ReadOnly ? O_RDONLY : O_RDWR, 0);
+	if (shmFileDes == -1) {
+		return -1;
+	}
+
+	if (this->MapShared(shmFileDes, arenaOptions) != 0) {
+		close(shmFileDes);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+int
+Arena::UnlinkShared(const char *name)
+{
+	return shm_unlink(name);
+}
+
+
+unsigned int
+Arena::NumaNodes()
+{
+	unsigned long	online[nodeMaskWords] = {};
+	auto		nodes = onlineNodes(online);
+
+	return (nodes == 0) ? 1 : nodes;
+}
+
+
+unsigned int
+Arena::CurrentNumaNode()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+	unsigned int	cpu = 0;
+	unsigned int	node = 0;
+
+	if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+		return node;
+	}
+#endif
+	return 0;
+}
+
+
+int
+Arena::Descriptor() const
+{
+	switch (this->arenaType) {
+	case ArenaType::MemoryMapped:
+	case ArenaType::SharedMemory:
+		return this->fd;
+	default:
+		return -1;
+	}
+}
+
+
+int
+Arena::Create(const char *path, size_t fileSize,
+	      const ArenaOptions &arenaOptions)
+{
+	int 	ret = -1;
+
+	if (this->size > 0) {
+		this->Destroy();
+	}
+
+
+	auto *fHandle = fopen(path, "w");
+	if (fHandle != nullptr) {
+		auto newFileDes = fileno(fHandle);
+		if (ftruncate(newFileDes, static_cast<off_t>(fileSize)) == 0) {
+			ret = this->Open(path, arenaOptions);
+		}
+
+		// The file was just created, so it's all zeroes.
+		if (ret == 0) {
+			this->highWater = 0;
+		}
+
+		close(newFileDes);
+		fclose(fHandle);
+	}
+
+	return ret;
+}
+
+
+int
+Arena::Grow(size_t minSize)
+{
+	size_t	 newSize = this->size * 2;
+	void	*newStore;
+
+	if (((this->arenaType != ArenaType::MemoryMapped) &&
+	     (this->arenaType != ArenaType::SharedMemory)) ||
+	    this->options.ReadOnly || this->options.Private) {
+		return -1;
+	}
+
+	if (minSize <= this->size) {
+		return 0;
+	}
+
+	if (newSize < minSize) {
+		newSize = minSize;
+	}
+
+	if (ftruncate(this->fd, static_cast<off_t>(newSize)) != 0) {
+		return -1;
+	}
+
+#if defined(__linux__)
+	newStore = mremap(this->store, this->size, newSize, MREMAP_MAYMOVE);
+#else
+	newStore = mmap(nullptr, newSize, PROT_RW, MAP_SHARED, this->fd, 0);
+#endif
+	if (newStore == MAP_FAILED) {
+		// Put the file back the way it was; the old mapping is
+		// still in place.
+		(void)ftruncate(this->fd, static_cast<off_t>(this->size));
+		return -1;
+	}
+
+#if !defined(__linux__)
+	if (munmap(this->store, this->size) == -1) {
+		abort();
+	}
+#endif
+
+	auto	oldSize = this->size;
+	this->store = static_cast<uint8_t *>(newStore);
+	this->size = newSize;
+	this->stats.Grows++;
 
+	// The arena has already grown, so the options are best-effort
+	// here: failing to lock or place the new pages (for example, past
+	// RLIMIT_MEMLOCK) doesn't undo the growth.
+	(void)this->applyOptions(this->store, this->size);
 
-Arena::Arena()
-    : store(nullptr), size(0), fd(0), arenaType(ArenaType::Uninit)
+	if (this->options.Prefault) {
+		prefault(this->store + oldSize, this->size - oldSize, false);
+	}
+	return 0;
+}
+
+
+bool
+Arena::CursorInArena(const uint8_t *cursor)
 {
+	if (cursor == nullptr) {
+		return false;
+	}
+
+	if (cursor < this->store) {
+		return false;
+	}
+
+	if (cursor >= this->End()) {
+		return false;
+	}
+
+	return true;
 }
 
 
-Arena::~Arena()
+size_t
+Arena::Reserved() const
 {
-	this->Destroy();
+	size_t	 reserved = 0;
+	Chunk	*chunk = this->chunks;
+
+	if (this->arenaType != ArenaType::Chunked) {
+		return this->size;
+	}
+
+	while (chunk != nullptr) {
+		reserved += chunk->size;
+		chunk = chunk->next;
+	}
+
+	return reserved;
 }
 
 
-int
-Arena::SetStatic(uint8_t *mem, size_t memSize)
+/*
+ * ClearArena clears the memory being used, removing any data
+ * present. It does not free the memory.
+ */
+void
+Arena::Clear()
 {
-	this->store = mem;
-	this->size = memSize;
-	this->arenaType = ArenaType::Static;
-	return 0;
+	// A chunked arena's size only covers its first chunk.
+	this->clearTo(SIZE_MAX);
 }
 
 
-int
-Arena::SetAlloc(size_t allocSize)
+void
+Arena::ClearUsed()
 {
-	if (this->size > 0) {
-		this->Destroy();
+	this->clearTo(this->highWater);
+}
+
+
+/*
+ * clearTo zeroes the first clearSize bytes of the arena and resets
+ * the high-water mark.
+ */
+void
+Arena::clearTo(size_t clearSize)
+{
+	auto	start = std::chrono::steady_clock::now();
+
+	if ((this->size == 0) || !this->Writable()) {
+		return;
 	}
 
-	this->arenaType = ArenaType::Alloc;
-	this->size = allocSize;
-	this->store = new uint8_t[allocSize];
+	if (this->arenaType == ArenaType::Chunked) {
+		for (auto *chunk = this->chunks; chunk != nullptr; chunk = chunk->next) {
+			if (chunk->base >= clearSize) {
+				break;
+			}
 
-	this->Clear();
-	return 0;
+			auto	chunkClear = clearSize - chunk->base;
+			if (chunkClear > chunk->size) {
+				chunkClear = chunk->size;
+			}
+			memset(chunk->Data(), 0, chunkClear);
+		}
+	} else {
+		if (clearSize > this->size) {
+			clearSize = this->size;
+		}
+
+		this->clearRange(0, clearSize);
+
+		// Only the range actually cleared needs to be flushed; this
+		// can't go through MarkDirty, which would raise the
+		// high-water mark.
+		if (clearSize > 0) {
+			this->dirtyStart = 0;
+			if (this->dirtyEnd < clearSize) {
+				this->dirtyEnd = clearSize;
+			}
+		}
+	}
+
+	this->highWater = 0;
+	this->ringHead.store(0);
+	this->ringTail.store(0);
+	this->stats.Clears++;
+	this->stats.ClearTime += elapsed(start);
 }
 
 
-int
-Arena::MemoryMap(int memFileDes, size_t memSize)
+void
+Arena::clearRange(size_t offset, size_t len)
 {
-	if (this->size > 0) {
-		this->Destroy();
+	auto		 pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	uint8_t		*start = this->store + offset;
+	uint8_t		*end = start + len;
+	uint8_t		*pageStart;
+	uint8_t		*pageEnd;
+	bool		 released = false;
+
+	if (len < lazyClearSize) {
+		memset(start, 0, len);
+		return;
 	}
 
-	this->arenaType = ArenaType::MemoryMapped;
-	this->size = memSize;
-	this->store = static_cast<uint8_t *>(mmap(nullptr, memSize, PROT_RW, MAP_SHARED,
-				       memFileDes, 0));
-	if (static_cast<void *>(this->store) == MAP_FAILED) {
-		return -1;
+	pageStart = reinterpret_cast<uint8_t *>(
+	    (reinterpret_cast<uintptr_t>(start) + pageSize - 1) & ~(pageSize - 1));
+	pageEnd = reinterpret_cast<uint8_t *>(
+	    reinterpret_cast<uintptr_t>(end) & ~(pageSize - 1));
+
+	switch (this->arenaType) {
+	case ArenaType::Alloc:
+		// Private anonymous pages read back as zero once they've
+		// been dropped.
+		released = madvise(pageStart, static_cast<size_t>(pageEnd - pageStart),
+				   MADV_DONTNEED) == 0;
+		break;
+	case ArenaType::MemoryMapped:
+	case ArenaType::SharedMemory:
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+		// Punching a hole in the file frees its blocks and zeroes
+		// the mapped pages; shared memory is freed the same way.
+		// Private mappings would fall back to the file's contents,
+		// so they have to be cleared by hand.
+		if (!this->options.Private) {
+			released = fallocate(this->fd,
+					     FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+					     static_cast<off_t>(pageStart - this->store),
+					     static_cast<off_t>(pageEnd - pageStart)) == 0;
+		}
+#endif
+		break;
+	default:
+		break;
 	}
-	this->fd = memFileDes;
-	return 0;
+
+	if (!released) {
+		memset(start, 0, len);
+		return;
+	}
+
+	memset(start, 0, static_cast<size_t>(pageStart - start));
+	memset(pageEnd, 0, static_cast<size_t>(end - pageEnd));
 }
 
 
-int
-Arena::Open(const char *path)
+void *
+Arena::Alloc(size_t allocSize, size_t align)
 {
-	struct stat st{};
+	size_t	 before = this->used;
+	size_t	 offset = this->used;
+	void	*mem = nullptr;
 
-	if (this->size > 0) {
-		this->Destroy();
+	if ((this->store == nullptr) || !this->Writable() ||
+	    (align == 0) || ((align & (align - 1)) != 0)) {
+		this->stats.FailedAllocs++;
+		return nullptr;
 	}
 
-	this->fd = open(path, O_RDWR);
-	if (this->fd == -1) {
-		return -1;
+	if (this->arenaType == ArenaType::Chunked) {
+		mem = this->allocChunked(allocSize, align);
+	} else if (bumpOffset(this->store, this->size, offset, allocSize, align)) {
+		mem = this->store + offset;
+		this->used = offset + allocSize;
+		if (this->used > this->highWater) {
+			this->highWater = this->used;
+		}
 	}
 
-	if (stat(path, &st) != 0) {
-		return -1;
+	if (mem == nullptr) {
+		this->stats.FailedAllocs++;
+		return nullptr;
 	}
 
-	return this->MemoryMap(this->fd, static_cast<size_t>(st.st_size));
+	// Anything between the old offset and the new allocation was
+	// skipped over for alignment or to move to a new chunk.
+	this->stats.Allocs++;
+	this->stats.AllocBytes += allocSize;
+	this->stats.PaddingBytes += this->used - allocSize - before;
+	return mem;
 }
 
 
-int
-Arena::Create(const char *path, size_t fileSize)
+void *
+Arena::allocChunked(size_t allocSize, size_t align)
 {
-	int 	ret = -1;
+	size_t	offset;
 
-	if (this->size > 0) {
-		this->Destroy();
-	}
+	while (true) {
+		offset = this->used - this->current->base;
+		if (bumpOffset(this->current->Data(), this->current->size,
+			       offset, allocSize, align)) {
+			break;
+		}
 
+		// Skip to the next chunk, adding one if this is the last
+		// chunk in the chain. Chunk memory is aligned for any
+		// fundamental type, so only over-aligned requests need
+		// room for padding.
+		if (this->current->next == nullptr) {
+			auto minSize = allocSize;
+			if (align > alignof(std::max_align_t)) {
+				minSize += align;
+			}
 
-	auto *fHandle = fopen(path, "w");
-	if (fHandle != nullptr) {
-		auto newFileDes = fileno(fHandle);
-		if (ftruncate(newFileDes, static_cast<off_t>(fileSize)) == 0) {
-			ret = this->Open(path);
+			if (!this->growChunks(minSize)) {
+				return nullptr;
+			}
+			this->stats.Grows++;
 		}
 
-		close(newFileDes);
-		fclose(fHandle);
+		this->current = this->current->next;
+		this->used = this->current->base;
 	}
 
-	return ret;
+	this->used = this->current->base + offset + allocSize;
+	if (this->used > this->highWater) {
+		this->highWater = this->used;
+	}
+	return this->current->Data() + offset;
 }
 
 
 bool
-Arena::CursorInArena(const uint8_t *cursor)
+Arena::growChunks(size_t minSize)
 {
-	if (cursor == nullptr) {
-		return false;
+	Chunk	*last = this->chunks;
+	size_t	 chunkSize = minSize;
+	size_t	 base = 0;
+
+	while ((last != nullptr) && (last->next != nullptr)) {
+		last = last->next;
 	}
 
-	if (cursor < this->store) {
-		return false;
+	if (last != nullptr) {
+		base = last->base + last->size;
+		if (last->size * this->growth > chunkSize) {
+			chunkSize = last->size * this->growth;
+		}
 	}
 
-	if (cursor >= this->End()) {
+	if (this->limit != 0) {
+		if (base + minSize > this->limit) {
+			return false;
+		}
+
+		if (base + chunkSize > this->limit) {
+			chunkSize = this->limit - base;
+		}
+	}
+
+	// Chunks are zeroed so that everything past the high-water mark
+	// is known to be clear.
+	auto *mem = new (std::nothrow) uint8_t[sizeof(Chunk) + chunkSize]();
+	if (mem == nullptr) {
 		return false;
 	}
 
+	auto *chunk = reinterpret_cast<Chunk *>(mem);
+	chunk->next = nullptr;
+	chunk->base = base;
+	chunk->size = chunkSize;
+
+	if (last == nullptr) {
+		this->chunks = chunk;
+	} else {
+		last->next = chunk;
+	}
+
 	return true;
 }
 
 
-/*
- * ClearArena clears the memory being used, removing any data
- * present. It does not free the memory; it is effectively a
- * wrapper around memset.
- */
 void
-Arena::Clear()
+Arena::Rewind(size_t mark)
 {
-	if (this->size == 0) {
+	if (mark >= this->used) {
+		return;
+	}
+
+	this->used = mark;
+	if (this->arenaType != ArenaType::Chunked) {
 		return;
 	}
 
-	memset(this->store, 0, this->size);
+	this->current = this->chunks;
+	while ((this->current->next != nullptr) &&
+	       (this->current->next->base <= mark)) {
+		this->current = this->current->next;
+	}
 }
 
 
@@ -187,19 +1349,39 @@ Arena::Destroy()
 	case ArenaType::Static:
 		break;
 	case ArenaType::Alloc:
-		delete[] this->store;
+		if (munmap(this->store, this->size) == -1) {
+			abort();
+		}
+		break;
+	case ArenaType::Ring:
+		if (munmap(this->store, this->size * 2) == -1) {
+			abort();
+		}
+
+		this->ringHead.store(0);
+		this->ringTail.store(0);
+		break;
+	case ArenaType::Chunked:
+		while (this->chunks != nullptr) {
+			auto *next = this->chunks->next;
+			delete[] reinterpret_cast<uint8_t *>(this->chunks);
+			this->chunks = next;
+		}
+
+		this->current = nullptr;
 		break;
 	case ArenaType::MemoryMapped:
+	case ArenaType::SharedMemory:
 		if (munmap(this->store, this->size) == -1) {
 			abort();
 			return;
 		}
 
-		if (close(this->fd) == -1) {
+		if ((this->fd != -1) && (close(this->fd) == -1)) {
 			abort();
 		}
 
-		this->fd = 0;
+		this->fd = -1;
 		break;
 	default:
 #if defined(NDEBUG)
@@ -212,7 +1394,13 @@ Arena::Destroy()
 
 	this->arenaType = ArenaType::Uninit;
 	this->size = 0;
+	this->used = 0;
+	this->highWater = 0;
+	this->dirtyStart = 0;
+	this->dirtyEnd = 0;
 	this->store = nullptr;
+	this->options = ArenaOptions();
+	this->stats = ArenaStats();
 }
 
 std::ostream &
@@ -237,6 +1425,15 @@ operator<<(std::ostream &os, Arena &arena)
 		case ArenaType::MemoryMapped:
 			os << "mmap/file";
 			break;
+		case ArenaType::Chunked:
+			os << "chunked";
+			break;
+		case ArenaType::SharedMemory:
+			os << "shared";
+			break;
+		case ArenaType::Ring:
+			os << "ring";
+			break;
 		default:
 			os << "unknown (this is a bug)";
 	}
@@ -251,38 +1448,261 @@ operator<<(std::ostream &os, Arena &arena)
 }
 
 
+std::ostream &
+operator<<(std::ostream &os, const ArenaStats &stats)
+{
+	os << "size: " << stats.Size << "B\n";
+	os << "reserved: " << stats.Reserved << "B\n";
+	os << "used: " << stats.Used << "B\n";
+	os << "high water: " << stats.HighWater << "B\n";
+	os << "allocations: " << stats.Allocs << " (" << stats.FailedAllocs
+	   << " failed)\n";
+	os << "allocated: " << stats.AllocBytes << "B (" << stats.PaddingBytes
+	   << "B padding)\n";
+	os << "grows: " << stats.Grows << "\n";
+	os << "clears: " << stats.Clears << " in "
+	   << stats.ClearTime.count() << "ns\n";
+	os << "writes: " << stats.Writes << " in "
+	   << stats.WriteTime.count() << "ns\n";
+	os << "flushes: " << stats.Flushes << " in "
+	   << stats.FlushTime.count() << "ns\n";
+	os << "resident: " << stats.ResidentPages << "/" << stats.Pages
+	   << " pages\n";
+	return os;
+}
+
+
 int
-Arena::Write(const char *path)
+Arena::Flush(size_t offset, size_t len, ArenaFlush mode)
 {
-	int retc = -1;
+	auto		pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t		start;
+	int		flags = MS_SYNC;
 
-	FILE *arenaFile = fopen(path, "w");
-	if (arenaFile == nullptr) {
+	if ((offset > this->size) || (len > (this->size - offset))) {
 		return -1;
 	}
 
-	if (fwrite(this->store, sizeof(*this->store), this->size,
-		   arenaFile) == this->size) {
-		retc = 0;
+	if ((this->arenaType != ArenaType::MemoryMapped) ||
+	    this->options.Private || (len == 0)) {
+		return 0;
+	}
+
+	if (mode == ArenaFlush::Async) {
+		flags = MS_ASYNC;
+	}
+
+	// msync needs a page-aligned address; mappings always start on a
+	// page boundary, so rounding the offset down is enough.
+	start = offset & ~(pageSize - 1);
+	len += offset - start;
+
+	auto	flushStart = std::chrono::steady_clock::now();
+	auto	retc = msync(this->store + start, len, flags);
+	this->stats.Flushes++;
+	this->stats.FlushTime += elapsed(flushStart);
+	return retc;
+}
+
+
+void
+Arena::MarkDirty(size_t offset, size_t len)
+{
+	if (len == 0) {
+		return;
+	}
+
+	if (offset + len > this->highWater) {
+		this->highWater = offset + len;
+	}
+
+	if (this->dirtyEnd == this->dirtyStart) {
+		this->dirtyStart = offset;
+		this->dirtyEnd = offset + len;
+		return;
+	}
+
+	if (offset < this->dirtyStart) {
+		this->dirtyStart = offset;
+	}
+
+	if (offset + len > this->dirtyEnd) {
+		this->dirtyEnd = offset + len;
+	}
+}
+
+
+int
+Arena::FlushDirty(ArenaFlush mode)
+{
+	auto	end = this->dirtyEnd;
+
+	if (end > this->size) {
+		end = this->size;
+	}
+
+	if (this->dirtyStart >= end) {
+		this->dirtyStart = this->dirtyEnd = 0;
+		return 0;
 	}
 
-	if (fclose(arenaFile) != 0) {
+	if (this->Flush(this->dirtyStart, end - this->dirtyStart, mode) != 0) {
 		return -1;
 	}
 
+	this->dirtyStart = this->dirtyEnd = 0;
+	return 0;
+}
+
+
+int
+Arena::Barrier()
+{
+	if ((this->arenaType != ArenaType::MemoryMapped) ||
+	    this->options.Private) {
+		return 0;
+	}
+
+	auto	start = std::chrono::steady_clock::now();
+	auto	retc = msync(this->store, this->size, MS_SYNC);
+
+	if (retc == 0) {
+#if defined(__linux__)
+		retc = fdatasync(this->fd);
+#else
+		retc = fsync(this->fd);
+#endif
+	}
+
+	this->stats.Flushes++;
+	this->stats.FlushTime += elapsed(start);
+	return retc;
+}
+
+
+int
+Arena::Write(const char *path, ArenaWrite mode)
+{
+	auto		start = std::chrono::steady_clock::now();
+	size_t		len = this->size;
+	int		srcFileDes = -1;
+	int		tmpFileDes;
+	int		retc = -1;
+	std::string	tmpPath;
+
+	if ((mode == ArenaWrite::Used) && (this->highWater < len)) {
+		len = this->highWater;
+	}
+
+	// Private mappings may hold changes that never reached the file,
+	// so they're copied from memory.
+	if (((this->arenaType == ArenaType::MemoryMapped) ||
+	     (this->arenaType == ArenaType::SharedMemory)) &&
+	    !this->options.Private) {
+		srcFileDes = this->fd;
+	}
+
+	tmpFileDes = openTempFile(path, tmpPath);
+	if (tmpFileDes == -1) {
+		return -1;
+	}
+
+	// Anything past len is zero in the arena, so extending the file
+	// over it leaves a hole that reads back the same.
+	if ((copyToFile(tmpFileDes, srcFileDes, this->store, len) == 0) &&
+	    (ftruncate(tmpFileDes, static_cast<off_t>(this->size)) == 0) &&
+	    (fsync(tmpFileDes) == 0)) {
+		retc = 0;
+	}
+
+	if (close(tmpFileDes) != 0) {
+		retc = -1;
+	}
+
+	if ((retc == 0) && (rename(tmpPath.c_str(), path) != 0)) {
+		retc = -1;
+	}
+
+	if (retc == 0) {
+		retc = syncParent(path);
+	} else {
+		(void)unlink(tmpPath.c_str());
+	}
+
+	this->stats.Writes++;
+	this->stats.WriteTime += elapsed(start);
 	return retc;
 }
 
+
+ArenaStats
+Arena::Stats() const
+{
+	ArenaStats	current = this->stats;
+
+	current.Size = this->size;
+	current.Reserved = this->Reserved();
+	current.Used = this->used;
+	current.HighWater = this->highWater;
+
+	switch (this->arenaType) {
+	case ArenaType::Alloc:
+	case ArenaType::MemoryMapped:
+	case ArenaType::SharedMemory:
+	case ArenaType::Ring:
+		break;
+	default:
+		return current;
+	}
+
+	// These arenas are mapped directly, so they start on a page
+	// boundary and mincore can be asked about the whole range. A
+	// ring's second copy shares the first one's pages.
+	auto				pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	auto				pages = (this->size + pageSize - 1) / pageSize;
+	std::vector<unsigned char>	residency(pages);
+
+#if defined(__linux__)
+	if (mincore(this->store, this->size, residency.data()) != 0) {
+#else
+	if (mincore(this->store, this->size,
+		    reinterpret_cast<char *>(residency.data())) != 0) {
+#endif
+		return current;
+	}
+
+	current.Pages = pages;
+	for (auto page : residency) {
+		if ((page & 1) != 0) {
+			current.ResidentPages++;
+		}
+	}
+
+	return current;
+}
+
+
+void
+Arena::ResetStats()
+{
+	this->stats = ArenaStats();
+}
+
 uint8_t &
 Arena::operator[](size_t index)
 {
-	if (index > this->size) {
+	if (index >= this->size) {
 #if defined(SCSL_DESKTOP_BUILD) and !defined(SCSL_NOEXCEPT)
 		throw std::range_error("index out of range");
 #else
 		abort();
 #endif
 	}
+
+	// The caller may write through the reference.
+	if (index >= this->highWater) {
+		this->highWater = index + 1;
+	}
 	return this->store[index];
 }
 
@@ -0,0 +1,107 @@
+///
+/// \file src/sl/ArenaReplicas.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Per-NUMA-node copies of an Arena.
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that
+/// the above copyright notice and this permission notice appear in all /// copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+/// AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+/// DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+/// OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+/// TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+/// PERFORMANCE OF THIS SOFTWARE.
+///
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <scsl/ArenaReplicas.h>
+
+
+namespace scsl {
+
+
+int
+ArenaReplicas::Replicate(const Arena &source)
+{
+	ArenaOptions	options;
+	auto		nodes = Arena::NumaNodes();
+	auto		len = source.HighWater();
+
+	this->Destroy();
+	if (!source.Ready() || (source.Size() == 0)) {
+		return -1;
+	}
+
+	if (len > source.Size()) {
+		len = source.Size();
+	}
+
+	// Binding each replica before it's written means the copy faults
+	// its pages in on the right node, whichever node this thread is
+	// running on.
+	options.Numa = (nodes > 1) ? ArenaNuma::Bind : ArenaNuma::Default;
+	for (unsigned int node = 0; node < nodes; node++) {
+		std::unique_ptr<Arena>	replica(new Arena);
+
+		options.NumaNode = node;
+		if (replica->SetAlloc(source.Size(), options) != 0) {
+			this->Destroy();
+			return -1;
+		}
+
+		memcpy(replica->Start(), source.Start(), len);
+		replica->MarkDirty(0, len);
+		this->replicas.push_back(std::move(replica));
+	}
+
+	return 0;
+}
+
+
+Arena &
+ArenaReplicas::Replica(size_t node)
+{
+	if (node >= this->replicas.size()) {
+#if defined(SCSL_DESKTOP_BUILD) and !defined(SCSL_NOEXCEPT)
+		throw std::range_error("no replica for NUMA node");
+#else
+		abort();
+#endif
+	}
+
+	return *this->replicas[node];
+}
+
+
+Arena &
+ArenaReplicas::Local()
+{
+	auto	node = static_cast<size_t>(Arena::CurrentNumaNode());
+
+	// Nodes can come online after the replicas were made.
+	if (node >= this->replicas.size()) {
+		node = 0;
+	}
+
+	return this->Replica(node);
+}
+
+
+void
+ArenaReplicas::Destroy()
+{
+	this->replicas.clear();
+}
+
+
+} // namespace scsl
@@ -0,0 +1,199 @@
+///
+/// \file src/sl/CRC32C.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief CRC-32C checksums.
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that
+/// the above copyright notice and this permission notice appear in all /// copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+/// AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+/// DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+/// OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+/// TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+/// PERFORMANCE OF THIS SOFTWARE.
+///
+
+#include <cstring>
+
+#include <scsl/CRC32C.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SCSL_CRC32C_SSE42
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define SCSL_CRC32C_ARM
+#include <arm_acle.h>
+#endif
+
+
+namespace scsl {
+
+
+/// crcPoly is the reversed CRC-32C polynomial.
+static constexpr uint32_t	crcPoly = 0x82f63b78;
+
+
+/// crcTables holds the tables for slicing-by-8: table[0] is the usual
+/// byte-at-a-time table, and table[k] advances a byte through k more
+/// bytes of zeros.
+struct crcTables {
+	crcTables()
+	{
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t	crc = i;
+			for (int bit = 0; bit < 8; bit++) {
+				crc = (crc >> 1) ^ ((crc & 1) ? crcPoly : 0);
+			}
+			this->table[0][i] = crc;
+		}
+
+		for (uint32_t i = 0; i < 256; i++) {
+			for (size_t k = 1; k < 8; k++) {
+				auto	prev = this->table[k - 1][i];
+				this->table[k][i] = (prev >> 8) ^
+				    this->table[0][prev & 0xff];
+			}
+		}
+	}
+
+	uint32_t	table[8][256];
+};
+
+
+uint32_t
+CRC32CPortable(const void *data, size_t len, uint32_t crc)
+{
+	static const crcTables	 tables;
+	const auto		&t = tables.table;
+	auto			*p = static_cast<const uint8_t *>(data);
+
+	crc = ~crc;
+	while (len >= 8) {
+		uint32_t	lo = crc ^ (static_cast<uint32_t>(p[0]) |
+					    (static_cast<uint32_t>(p[1]) << 8) |
+					    (static_cast<uint32_t>(p[2]) << 16) |
+					    (static_cast<uint32_t>(p[3]) << 24));
+
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+		      t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+		      t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+		p += 8;
+		len -= 8;
+	}
+
+	while (len-- > 0) {
+		crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+	}
+
+	return ~crc;
+}
+
+
+#if defined(SCSL_CRC32C_SSE42)
+
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32cHardware(const void *data, size_t len, uint32_t crc)
+{
+	auto		*p = static_cast<const uint8_t *>(data);
+	uint64_t	 crc64 = ~crc;
+
+	while (len >= 8) {
+		uint64_t	word;
+		memcpy(&word, p, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+		p += 8;
+		len -= 8;
+	}
+
+	auto	crc32 = static_cast<uint32_t>(crc64);
+	while (len-- > 0) {
+		crc32 = _mm_crc32_u8(crc32, *p++);
+	}
+
+	return ~crc32;
+}
+
+
+static bool
+hardwareAvailable()
+{
+	return __builtin_cpu_supports("sse4.2");
+}
+
+#elif defined(SCSL_CRC32C_ARM)
+
+static uint32_t
+crc32cHardware(const void *data, size_t len, uint32_t crc)
+{
+	auto	*p = static_cast<const uint8_t *>(data);
+
+	crc = ~crc;
+	while (len >= 8) {
+		uint64_t	word;
+		memcpy(&word, p, sizeof(word));
+		crc = __crc32cd(crc, word);
+		p += 8;
+		len -= 8;
+	}
+
+	while (len-- > 0) {
+		crc = __crc32cb(crc, *p++);
+	}
+
+	return ~crc;
+}
+
+
+static bool
+hardwareAvailable()
+{
+	return true;
+}
+
+#else
+
+static uint32_t
+crc32cHardware(const void *data, size_t len, uint32_t crc)
+{
+	return CRC32CPortable(data, len, crc);
+}
+
+
+static bool
+hardwareAvailable()
+{
+	return false;
+}
+
+#endif
+
+
+bool
+CRC32CHardware()
+{
+	static const bool	available = hardwareAvailable();
+
+	return available;
+}
+
+
+uint32_t
+CRC32C(const void *data, size_t len, uint32_t crc)
+{
+	if (CRC32CHardware()) {
+		return crc32cHardware(data, len, crc);
+	}
+
+	return CRC32CPortable(data, len, crc);
+}
+
+
+} // namespace scsl
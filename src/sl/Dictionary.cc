@@ -37,17 +37,19 @@ namespace scsl {
 bool
 Dictionary::Lookup(const char *key, uint8_t klen, TLV::Record &res)
 {
-	res.Tag = this->kTag;
-	uint8_t	*cursor = TLV::FindTag(this->arena, nullptr, res);
-
-	while (cursor != nullptr) {
-		if ((klen == res.Len) &&
-		    (memcmp(res.Val, key, klen) == 0)) {
-			TLV::ReadFromMemory(res, cursor);
-			assert(res.Tag == this->vTag);
-			return res.Tag == this->vTag;
+	auto	records = TLV::Records(this->arena);
+
+	for (auto it = records.begin(); it != records.end(); ++it) {
+		if ((it->Tag != this->kTag) || !TLV::ViewEquals(*it, key, klen)) {
+			continue;
 		}
-		cursor = TLV::FindTag(this->arena, cursor, res);
+
+		// Only the value is copied out of the arena.
+		if (++it == records.end()) {
+			break;
+		}
+		assert(it->Tag == this->vTag);
+		return (it->Tag == this->vTag) && TLV::CopyView(*it, res);
 	}
 
 	return false;
@@ -57,27 +59,23 @@ Dictionary::Lookup(const char *key, uint8_t klen, TLV::Record &res)
 int
 Dictionary::Set(const char *key, uint8_t klen, const char *val, uint8_t vlen)
 {
-	TLV::Record	 rec;
+	TLV::Record	 pair[2];
 	uint8_t		*cursor = nullptr;
 
-	SetRecord(rec, this->kTag, klen, key);
 	cursor = this->seek(key, klen);
 	if (cursor != nullptr) {
-		TLV::DeleteRecord(this->arena, cursor);
-		TLV::DeleteRecord(this->arena, cursor);
+		this->remove(cursor);
 	}
 
 	if (!spaceAvailable(klen, vlen)) {
 		return -1;
 	}
 
-	cursor = TLV::WriteToMemory(this->arena, nullptr, rec);
-	if (cursor == nullptr) {
-		return -1;
-	}
-
-	SetRecord(rec, this->vTag, vlen, val);
-	if (TLV::WriteToMemory(this->arena, nullptr, rec) == nullptr) {
+	// The key and value are written together, so a failed write
+	// can't leave a key without its value.
+	SetRecord(pair[0], this->kTag, klen, key);
+	SetRecord(pair[1], this->vTag, vlen, val);
+	if (TLV::WriteBatch(this->arena, pair, 2) == nullptr) {
 		return -1;
 	}
 
@@ -89,19 +87,12 @@ Dictionary::Set(const char *key, uint8_t klen, const char *val, uint8_t vlen)
 uint8_t	*
 Dictionary::seek(const char *key, uint8_t klen)
 {
-	TLV::Record	 rec;
+	auto	records = TLV::Records(this->arena);
 
-	rec.Tag = this->kTag;
-	uint8_t	*cursor = TLV::LocateTag(this->arena, nullptr, rec);
-
-	while (cursor != nullptr) {
-		if ((klen == rec.Len) && (this->kTag == rec.Tag)) {
-			if (memcmp(rec.Val, key, klen) == 0) {
-				return cursor;
-			}
+	for (auto it = records.begin(); it != records.end(); ++it) {
+		if ((it->Tag == this->kTag) && TLV::ViewEquals(*it, key, klen)) {
+			return it.Cursor();
 		}
-		cursor = TLV::SkipRecord(rec, cursor);
-		cursor = TLV::LocateTag(this->arena, cursor, rec);
 	}
 
 	return nullptr;
@@ -120,34 +111,92 @@ Dictionary::Delete(const char *key, uint8_t klen)
 {
 	auto	*cursor = this->seek(key, klen);
 
-	if (cursor == nullptr) {
+	if ((cursor == nullptr) || !this->arena.Writable()) {
 		return false;
 	}
 
-	TLV::DeleteRecord(this->arena, cursor);
-	TLV::DeleteRecord(this->arena, cursor);
+	this->remove(cursor);
 	return true;
 }
 
 
+/// remove deletes the pair starting at cursor, compacting the arena once
+/// enough pairs have been deleted.
+void
+Dictionary::remove(uint8_t *cursor)
+{
+	TLV::RecordIterator	value(this->arena, cursor);
+
+	// The value is the next record, skipping any checksum. Without a
+	// region header, the records are deleted outright and the ones
+	// after them move down, so the value goes first.
+	++value;
+	if (value.Cursor() != nullptr) {
+		TLV::TombstoneRecord(this->arena, value.Cursor());
+	}
+	TLV::TombstoneRecord(this->arena, cursor);
+
+	if (TLV::NeedsCompact(this->arena)) {
+		TLV::Compact(this->arena);
+	}
+}
+
+
 bool
 Dictionary::spaceAvailable(uint8_t klen, uint8_t vlen)
 {
+	TLV::Region	 region;
 	size_t		 required = 0;
-	uintptr_t	 remaining = 0;
+	size_t		 used = 0;
 	uint8_t		*cursor = nullptr;
 
+	required += klen + 2;
+	required += vlen + 2;
+
+	// Each record may be followed by a checksum, and the pair is
+	// short enough to cross at most one sync marker boundary.
+	if (TLV::ReadRegion(this->arena, region)) {
+		if ((region.Flags & TLV::REGION_CHECKSUMS) != 0) {
+			required += 2 * TLV::CHECKSUM_SIZE;
+		}
+		if ((region.Flags & TLV::REGION_SYNC) != 0) {
+			required += TLV::SYNC_SIZE;
+		}
+	}
+
+	// If there's no empty space, the arena is completely full.
 	cursor = TLV::FindEmpty(this->arena, nullptr);
 	if (cursor == nullptr) {
+		used = arena.Size();
+	} else {
+		used = (uintptr_t)cursor - (uintptr_t) arena.Start();
+	}
+
+	if ((arena.Size() - used) >= required) {
+		return true;
+	}
+
+	// Reclaim any deleted pairs before growing.
+	if (TLV::Compact(this->arena) > 0) {
+		return this->spaceAvailable(klen, vlen);
+	}
+
+	// Grow the arena if possible, leaving room for the empty tag
+	// that marks the end of the records.
+	if (!arena.AutoGrowIsEnabled()) {
 		return false;
 	}
+	return arena.Grow(used + required + 1) == 0;
+}
 
-	required += klen + 2;
-	required += vlen + 2;
 
-	remaining = (uintptr_t)cursor - (uintptr_t) arena.Start();
-	remaining = arena.Size() - remaining;
-	return ((size_t)remaining >= required);
+/// writeValue writes a record's value as a string.
+static void
+writeValue(std::ostream &os, const TLV::RecordView &view)
+{
+	auto	*val = reinterpret_cast<const char *>(view.Val);
+
+	os.write(val, static_cast<std::streamsize>(strnlen(val, view.Len)));
 }
 
 
@@ -155,30 +204,28 @@ std::ostream &
 operator<<(std::ostream &os, const Dictionary &dictionary)
 {
 #if defined(SCSL_DESKTOP_BUILD)
-	uint8_t 	*cursor = (dictionary.arena).Start();
-	TLV::Record	 rec;
-
-	if (cursor == nullptr) {
+	if (dictionary.arena.Start() == nullptr) {
 		return os;
 	}
 
-	TLV::ReadFromMemory(rec, cursor);
-	if (rec.Tag == TLV::TAG_EMPTY) {
+	auto	records = TLV::Records(dictionary.arena);
+	auto	it = records.begin();
+	if (it == records.end()) {
 		os << "\t(NONE)" << std::endl;
 		return os;
 	}
 
-	while ((cursor != nullptr) && (rec.Tag != TLV::TAG_EMPTY)) {
-		os << "\t" << rec.Val << "->";
-		cursor = TLV::SkipRecord(rec, cursor);
-		TLV::ReadFromMemory(rec, cursor);
-		if (cursor == nullptr) {
+	while (it != records.end()) {
+		os << "\t";
+		writeValue(os, *it);
+		os << "->";
+		if (++it == records.end()) {
 			os << "*** CORRUPT DICTIONARY ***\n";
 			break;
 		}
-		os << rec.Val << "\n";
-		cursor = TLV::SkipRecord(rec, cursor);
-		TLV::ReadFromMemory(rec, cursor);
+		writeValue(os, *it);
+		os << "\n";
+		++it;
 	}
 #endif
 
@@ -20,10 +20,16 @@
 /// PERFORMANCE OF THIS SOFTWARE.
 ///
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstring>
+#include <thread>
+#include <vector>
 
+#include <scsl/CRC32C.h>
 #include <scsl/TLV.h>
+#include <scsl/TLVTypes.h>
 
 
 using namespace scsl;
@@ -38,14 +44,62 @@ namespace scsl {
 namespace TLV {
 
 
+/// maxVarintSize is the most bytes a varint-encoded size_t can take.
+static constexpr size_t maxVarintSize = HEADER_MAX - 2;
+
+
+/// varintSize returns the number of bytes needed to encode value as a
+/// varint.
+static size_t
+varintSize(size_t value)
+{
+	size_t	n = 1;
+
+	while (value >= 0x80) {
+		value >>= 7;
+		n++;
+	}
+
+	return n;
+}
+
+
+/// encodedSize returns the number of bytes a record with a value of len
+/// bytes occupies in an arena.
+static size_t
+encodedSize(size_t len)
+{
+	if (len <= TLV_MAX_LEN) {
+		return len + 2;
+	}
+
+	return len + 2 + varintSize(len);
+}
+
+
 static bool
-spaceAvailable(Arena &arena, uint8_t *cursor, uint8_t len)
+spaceAvailable(Arena &arena, uint8_t *cursor, size_t size)
 {
-	if (cursor == nullptr) {
+	if (!arena.CursorInArena(cursor)) {
+		return false;
+	}
+
+	return size <= static_cast<size_t>(arena.End() - cursor);
+}
+
+
+/// growForRecord grows the arena so that a record occupying size bytes fits
+/// at offset. The arena must have auto-growth enabled.
+static bool
+growForRecord(Arena &arena, size_t offset, size_t size)
+{
+	if (!arena.AutoGrowIsEnabled()) {
 		return false;
 	}
 
-	return arena.CursorInArena(cursor + len);
+	// Leave room for a trailing empty tag so the end of the records
+	// can still be found.
+	return arena.Grow(offset + size + 1) == 0;
 }
 
 static inline void
@@ -57,164 +111,1465 @@ clearUnused(Record &rec)
 }
 
 
-uint8_t *
-WriteToMemory(Arena &arena, uint8_t *cursor, Record &rec)
+/// The bookkeeping tags are only reserved in arenas that use them; the
+/// reserved ones are kept as a set of these bits.
+static constexpr uint8_t	reservedTombstone = 0x01;
+static constexpr uint8_t	reservedChecksum = 0x02;
+static constexpr uint8_t	reservedSync = 0x04;
+
+
+/// reservedFor returns the tags reserved in a region with the given flags.
+static uint8_t
+reservedFor(uint16_t flags)
 {
-	// If cursor is nullptr, the user needs us to select an empty
-	// slot for the record. If we can't find one, that's an
-	// error.
-	//
-	// If, however, the user gives us a cursor, we'll trust it
-	// (though spaceAvailable will sanity check that cursor).
-	if (cursor == nullptr) {
-		cursor = FindEmpty(arena, cursor);
-		if (cursor == nullptr) {
-			return nullptr;
+	uint8_t	reserved = reservedTombstone;
+
+	if ((flags & REGION_CHECKSUMS) != 0) {
+		reserved |= reservedChecksum;
+	}
+
+	if ((flags & REGION_SYNC) != 0) {
+		reserved |= reservedSync;
+	}
+
+	return reserved;
+}
+
+
+/// hidden reports whether records with tag are kept for the arena's own
+/// bookkeeping, and so are skipped when reading records.
+static inline bool
+hidden(uint8_t reserved, uint8_t tag)
+{
+	switch (tag) {
+	case TAG_TOMBSTONE:
+		return (reserved & reservedTombstone) != 0;
+	case TAG_CHECKSUM:
+		return (reserved & reservedChecksum) != 0;
+	case TAG_SYNC:
+		return (reserved & reservedSync) != 0;
+	default:
+		return false;
+	}
+}
+
+
+bool
+DecodeHeader(const uint8_t *cursor, size_t avail, Header &hdr)
+{
+	uint64_t	len = 0;
+	size_t		size = 2;
+
+	if ((cursor == nullptr) || (avail == 0)) {
+		return false;
+	}
+
+	hdr.Tag = cursor[0];
+
+	// The empty tag at the very end of an arena has no length byte.
+	if (avail < 2) {
+		hdr.Len = 0;
+		hdr.Size = 1;
+		return hdr.Tag == TAG_EMPTY;
+	}
+
+	if (cursor[1] != TLV_LEN_EXTENDED) {
+		len = cursor[1];
+	} else {
+		auto	n = DecodeVarint(cursor + 2,
+					 std::min(avail - 2, maxVarintSize), len);
+		if ((n == 0) || (static_cast<size_t>(len) != len)) {
+			return false;
 		}
+		size += n;
+	}
+
+	hdr.Len = static_cast<size_t>(len);
+	hdr.Size = size;
+	return true;
+}
+
+
+size_t
+EncodeHeader(uint8_t *dst, uint8_t tag, size_t len)
+{
+	dst[0] = tag;
+	if (len <= TLV_MAX_LEN) {
+		dst[1] = static_cast<uint8_t>(len);
+		return 2;
 	}
 
+	dst[1] = TLV_LEN_EXTENDED;
+	return 2 + EncodeVarint(dst + 2, len);
+}
+
+
+bool
+ReadHeader(Arena &arena, const uint8_t *cursor, Header &hdr)
+{
 	if (!arena.CursorInArena(cursor)) {
-		return nullptr;
+		return false;
 	}
 
-	if (!spaceAvailable(arena, cursor, rec.Len)) {
-		return nullptr;
+	auto	avail = static_cast<size_t>(arena.End() - cursor);
+	if (!DecodeHeader(cursor, avail, hdr)) {
+		return false;
 	}
 
-	memcpy(cursor, &rec, REC_SIZE(rec));
-	cursor = SkipRecord(rec, cursor);
+	return hdr.Len <= avail - hdr.Size;
+}
 
-	return cursor;
+
+/// regionMagic identifies a region header record.
+static const uint8_t	regionMagic[4] = {'s', 'T', 'L', 'V'};
+
+
+bool
+IsRegionHeader(const uint8_t *cursor, size_t avail)
+{
+	if ((cursor == nullptr) || (avail < REGION_SIZE)) {
+		return false;
+	}
+
+	return (cursor[0] == TAG_REGION) && (cursor[1] == REGION_SIZE - 2) &&
+	       (memcmp(cursor + 2, regionMagic, sizeof(regionMagic)) == 0) &&
+	       (DecodeLE(cursor + 6, 2) == REGION_VERSION);
 }
 
 
-void
-SetRecord(Record &rec, uint8_t tag, uint8_t len, const char *val)
+/// hasRegion checks whether the arena starts with a region header that
+/// this version understands.
+static bool
+hasRegion(Arena &arena)
 {
-	rec.Tag = tag;
-	rec.Len = len;
-	memcpy(rec.Val, val, len);
-	clearUnused(rec);
+	return IsRegionHeader(arena.Start(), arena.Size());
 }
 
 
-void
-ReadFromMemory(Record &rec, uint8_t *cursor)
+static void
+storeRegion(Arena &arena, const Region &region)
 {
-	assert(cursor != nullptr);
-	if (cursor == nullptr) {
-		return;
+	auto	*start = arena.Start();
+
+	start[0] = TAG_REGION;
+	start[1] = REGION_SIZE - 2;
+	memcpy(start + 2, regionMagic, sizeof(regionMagic));
+	EncodeLE(start + 6, region.Version, 2);
+	EncodeLE(start + 8, region.Flags, 2);
+	EncodeLE(start + 10, region.Tail, 8);
+	EncodeLE(start + 18, region.Count, 8);
+	EncodeLE(start + 26, region.Dead, 8);
+	arena.MarkDirty(0, REGION_SIZE);
+}
+
+
+/// scanRegion walks the records from offset to find the end of the
+/// records, count them, and total up the space held by tombstones. The
+/// region's flags must already be set.
+static void
+scanRegion(Arena &arena, size_t offset, Region &region)
+{
+	Header	hdr;
+	auto	*cursor = arena.Start() + offset;
+	auto	 reserved = reservedFor(region.Flags);
+
+	region.Version = REGION_VERSION;
+	region.Count = 0;
+	region.Dead = 0;
+	while (arena.CursorInArena(cursor)) {
+		if (!ReadHeader(arena, cursor, hdr) || (hdr.Tag == TAG_EMPTY)) {
+			break;
+		}
+
+		cursor += hdr.Size + hdr.Len;
+		if (hdr.Tag == TAG_TOMBSTONE) {
+			region.Dead += hdr.Size + hdr.Len;
+		} else if (!hidden(reserved, hdr.Tag)) {
+			region.Count++;
+		}
 	}
-	rec.Tag = cursor[0];
-	rec.Len = cursor[1];
-	memcpy(rec.Val, cursor + 2, rec.Len);
-	clearUnused(rec);
+
+	region.Tail = static_cast<size_t>(cursor - arena.Start());
 }
 
 
-/* 
- * returns a pointer to memory where the record was found,
- * e.g. FindTag(...)[0] is the tag of the found record.
- */
-uint8_t *
-FindTag(Arena &arena, uint8_t *cursor, Record &rec)
+/// decodeRegion reads the region header as it is stored.
+static bool
+decodeRegion(Arena &arena, Region &region)
 {
-	cursor = LocateTag(arena, cursor, rec);
-	if (rec.Tag != TAG_EMPTY) {
-		cursor = SkipRecord(rec, cursor);
+	if (!hasRegion(arena)) {
+		return false;
 	}
 
-	if (!arena.CursorInArena(cursor)) {
-		cursor = nullptr;
+	auto	*start = arena.Start();
+	region.Version = static_cast<uint16_t>(DecodeLE(start + 6, 2));
+	region.Flags = static_cast<uint16_t>(DecodeLE(start + 8, 2));
+	region.Tail = static_cast<size_t>(DecodeLE(start + 10, 8));
+	region.Count = static_cast<size_t>(DecodeLE(start + 18, 8));
+	region.Dead = static_cast<size_t>(DecodeLE(start + 26, 8));
+	return true;
+}
+
+
+/// loadRegion reads the region header, checking that its tail still marks
+/// the end of the records. If it doesn't, the records are rescanned and,
+/// if possible, the header is fixed.
+static bool
+loadRegion(Arena &arena, Region &region)
+{
+	if (!decodeRegion(arena, region)) {
+		return false;
 	}
 
-	return cursor;
+	auto	*start = arena.Start();
+	if ((region.Tail >= REGION_SIZE) && (region.Tail <= arena.Size()) &&
+	    ((region.Tail == arena.Size()) || (start[region.Tail] == TAG_EMPTY))) {
+		return true;
+	}
+
+	scanRegion(arena, REGION_SIZE, region);
+	if (arena.Writable()) {
+		storeRegion(arena, region);
+	}
+	return true;
 }
 
 
-uint8_t *
-LocateTag(Arena &arena, uint8_t *cursor, Record &rec)
+/// updateRegion records that size bytes, holding one record and possibly
+/// its checksum, were written at cursor. The record has already been
+/// written, so the tail isn't checked.
+static void
+updateRegion(Arena &arena, uint8_t *cursor, size_t size)
 {
-	uint8_t tag = TAG_EMPTY;
-	uint8_t len;
+	Region	region;
 
-	if (cursor == nullptr) {
-		cursor = arena.Start();
+	if (!decodeRegion(arena, region)) {
+		return;
 	}
 
-	if (!arena.CursorInArena(cursor)) {
-		cursor = arena.Start();
+	auto	offset = static_cast<size_t>(cursor - arena.Start());
+	if ((offset == region.Tail) && (cursor[0] == TAG_TOMBSTONE)) {
+		region.Tail += size;
+		region.Dead += size;
+	} else if (offset == region.Tail) {
+		region.Tail += size;
+		region.Count++;
+	} else {
+		scanRegion(arena, REGION_SIZE, region);
 	}
+	storeRegion(arena, region);
+}
 
-	while (arena.CursorInArena(cursor) &&
-	       ((tag = cursor[0]) != rec.Tag)) {
-		assert(arena.CursorInArena(cursor));
-		len = cursor[1];
-		if (!spaceAvailable(arena, cursor, len)) {
-			return nullptr;
+
+/// usesReserved checks whether any record from offset on uses one of the
+/// reserved tags.
+static bool
+usesReserved(Arena &arena, size_t offset, uint8_t reserved)
+{
+	Header	hdr;
+	auto	*cursor = arena.Start() + offset;
+
+	if (reserved == 0) {
+		return false;
+	}
+
+	while (arena.CursorInArena(cursor)) {
+		if (!ReadHeader(arena, cursor, hdr) || (hdr.Tag == TAG_EMPTY)) {
+			break;
+		}
+
+		if (hidden(reserved, hdr.Tag)) {
+			return true;
 		}
-		cursor += len;
-		cursor += 2;
+		cursor += hdr.Size + hdr.Len;
 	}
 
-	if (!arena.CursorInArena(cursor)) {
-		return nullptr;
+	return false;
+}
+
+
+int
+InitRegion(Arena &arena, uint16_t flags)
+{
+	Region	region;
+
+	if (!arena.Writable()) {
+		return -1;
 	}
 
-	if (tag != rec.Tag) {
-		return nullptr;
+	// Tags that become reserved can't already be in use.
+	if (loadRegion(arena, region)) {
+		if ((region.Flags | flags) != region.Flags) {
+			auto	added = static_cast<uint8_t>(
+			    reservedFor(region.Flags | flags) &
+			    ~reservedFor(region.Flags));
+			if (usesReserved(arena, REGION_SIZE, added)) {
+				return -1;
+			}
+			region.Flags |= flags;
+			storeRegion(arena, region);
+		}
+		return 0;
 	}
 
-	if (tag != TAG_EMPTY) {
-		ReadFromMemory(rec, cursor);
+	if (usesReserved(arena, 0, reservedFor(flags))) {
+		return -1;
 	}
-	return cursor;
+
+	region.Flags = flags;
+	scanRegion(arena, 0, region);
+	auto	used = region.Tail;
+	if (used + REGION_SIZE > arena.Size()) {
+		if (!arena.AutoGrowIsEnabled() ||
+		    (arena.Grow(used + REGION_SIZE + 1) != 0)) {
+			return -1;
+		}
+	}
+
+	memmove(arena.Start() + REGION_SIZE, arena.Start(), used);
+	region.Tail = used + REGION_SIZE;
+	storeRegion(arena, region);
+	arena.MarkDirty(0, region.Tail);
+	return 0;
+}
+
+
+bool
+ReadRegion(Arena &arena, Region &region)
+{
+	return loadRegion(arena, region);
 }
 
 
 uint8_t *
-FindEmpty(Arena &arena, uint8_t *cursor)
+FirstRecord(Arena &arena)
 {
-	Record rec;
+	if (hasRegion(arena)) {
+		return arena.Start() + REGION_SIZE;
+	}
 
-	rec.Tag = TAG_EMPTY;
-	return FindTag(arena, cursor, rec);
+	return arena.Start();
 }
 
 
-uint8_t *
-SkipRecord(Record &rec, uint8_t *cursor)
+/// topLevel checks that cursor points to one of the arena's own records,
+/// or past them, rather than into a container. Only arenas that may hold
+/// containers have to be walked. \see REGION_CONTAINERS
+static bool
+topLevel(Arena &arena, const uint8_t *cursor)
 {
-	return (uint8_t *) ((uintptr_t) cursor + rec.Len + 2);
+	Header	hdr;
+	Region	region;
+
+	if (decodeRegion(arena, region) &&
+	    (((region.Flags & REGION_CONTAINERS) == 0) ||
+	     (cursor == arena.Start() + region.Tail))) {
+		return true;
+	}
+
+	auto	*at = FirstRecord(arena);
+	while (at < cursor) {
+		if (!ReadHeader(arena, at, hdr)) {
+			return false;
+		}
+
+		if (hdr.Tag == TAG_EMPTY) {
+			return true;
+		}
+		at += hdr.Size + hdr.Len;
+	}
+
+	return at == cursor;
 }
 
 
-void
-DeleteRecord(Arena &arena, uint8_t *cursor)
+/// regionFlags returns the flags of the arena's region header, or 0 if it
+/// doesn't have one.
+static uint16_t
+regionFlags(Arena &arena)
+{
+	Region	region;
+
+	return decodeRegion(arena, region) ? region.Flags : 0;
+}
+
+
+/// reservedTags returns the tags reserved in the arena; an arena without
+/// a region header doesn't reserve any.
+static uint8_t
+reservedTags(Arena &arena)
+{
+	Region	region;
+
+	return decodeRegion(arena, region) ? reservedFor(region.Flags) : 0;
+}
+
+
+bool
+IsReserved(Arena &arena, uint8_t tag)
+{
+	return hidden(reservedTags(arena), tag);
+}
+
+
+/// writeChecksum writes a checksum record covering the size bytes of the
+/// record at start; it goes immediately after the record.
+static void
+writeChecksum(uint8_t *start, size_t size)
+{
+	auto	*cursor = start + size;
+
+	cursor[0] = TAG_CHECKSUM;
+	cursor[1] = CHECKSUM_SIZE - 2;
+	EncodeLE(cursor + 2, CRC32C(start, size), CHECKSUM_SIZE - 2);
+}
+
+
+/// syncMagic identifies a sync marker.
+static const uint8_t	syncMagic[4] = {'s', 'S', 'Y', 'N'};
+
+
+/// syncSize returns the space needed for a sync marker in front of size
+/// bytes appended at offset: SYNC_SIZE if they would reach the next
+/// SYNC_INTERVAL boundary, and 0 otherwise.
+static size_t
+syncSize(uint16_t flags, size_t offset, size_t size)
+{
+	if ((flags & REGION_SYNC) == 0) {
+		return 0;
+	}
+
+	return ((offset / SYNC_INTERVAL) != ((offset + size) / SYNC_INTERVAL)) ?
+	       SYNC_SIZE : 0;
+}
+
+
+/// writeSync writes a sync marker at offset.
+static void
+writeSync(uint8_t *start, size_t offset)
+{
+	auto	*cursor = start + offset;
+
+	cursor[0] = TAG_SYNC;
+	cursor[1] = SYNC_SIZE - 2;
+	memcpy(cursor + 2, syncMagic, sizeof(syncMagic));
+	EncodeLE(cursor + 6, offset, 8);
+}
+
+
+/// isSync checks whether there is a sync marker at offset that fits before
+/// tail.
+static bool
+isSync(const uint8_t *start, size_t offset, size_t tail)
+{
+	auto	*cursor = start + offset;
+
+	return (offset + SYNC_SIZE <= tail) && (cursor[0] == TAG_SYNC) &&
+	       (cursor[1] == SYNC_SIZE - 2) &&
+	       (memcmp(cursor + 2, syncMagic, sizeof(syncMagic)) == 0) &&
+	       (DecodeLE(cursor + 6, 8) == offset);
+}
+
+
+uint8_t *
+WriteValue(Arena &arena, uint8_t *cursor, uint8_t tag, const uint8_t *val,
+	   size_t len)
 {
+	size_t	size = encodedSize(len);
+	size_t	total = size;
+	size_t	sync = 0;
+	auto	flags = regionFlags(arena);
+	auto	given = cursor != nullptr;
+
+	if (!arena.Writable() || IsReserved(arena, tag)) {
+		return nullptr;
+	}
+
+	if ((flags & REGION_CHECKSUMS) != 0) {
+		total += CHECKSUM_SIZE;
+	}
+
+	// If cursor is nullptr, the user needs us to select an empty
+	// slot for the record. If we can't find one, that's an
+	// error.
+	//
+	// If, however, the user gives us a cursor, we'll trust it
+	// (though spaceAvailable will sanity check that cursor).
 	if (cursor == nullptr) {
-		return;
+		cursor = FindEmpty(arena, cursor);
+		auto offset = (cursor == nullptr) ? arena.Size() :
+			      static_cast<size_t>(cursor - arena.Start());
+
+		// Only appends get sync markers, since a marker has to
+		// come before any records after it.
+		sync = syncSize(flags, offset, total);
+		total += sync;
+		if (cursor == nullptr) {
+			if (!growForRecord(arena, arena.Size(), total)) {
+				return nullptr;
+			}
+
+			// The arena was full, so the empty space starts at
+			// the old end of the arena.
+			cursor = FindEmpty(arena, nullptr);
+			if (cursor == nullptr) {
+				return nullptr;
+			}
+		}
 	}
 
 	if (!arena.CursorInArena(cursor)) {
-		return;
+		return nullptr;
 	}
 
-	uint8_t len   = cursor[1] + 2;
-	uint8_t *stop = arena.Start() + arena.Size();
+	if (given && !topLevel(arena, cursor)) {
+		return nullptr;
+	}
 
-	stop -= len;
+	if (!spaceAvailable(arena, cursor, total)) {
+		auto offset = static_cast<size_t>(cursor - arena.Start());
+		if (!growForRecord(arena, offset, total)) {
+			return nullptr;
+		}
+		cursor = arena.Start() + offset;
+	}
 
-	while (cursor != stop) {
-		cursor[0] = cursor[len];
-		cursor++;
+	auto	*start = cursor;
+	if (sync != 0) {
+		writeSync(arena.Start(), static_cast<size_t>(start - arena.Start()));
+		cursor += sync;
 	}
 
-	stop += len;
-	while (cursor != stop) {
-		cursor[0] = 0;
-		cursor++;
+	auto	*record = cursor;
+	cursor += EncodeHeader(cursor, tag, len);
+	memcpy(cursor, val, len);
+	if (total != size + sync) {
+		writeChecksum(record, size);
 	}
+	arena.MarkDirty(static_cast<size_t>(start - arena.Start()), total);
+	updateRegion(arena, start, total);
+	return start + total;
+}
+
+
+/// writeBatch does the work for both versions of WriteBatch; T is either
+/// a Record or a RecordView.
+template <typename T>
+static uint8_t *
+writeBatch(Arena &arena, const T *recs, size_t n)
+{
+	Region	region;
+	size_t	total = 0;
+	auto	flags = regionFlags(arena);
+	auto	reserved = reservedTags(arena);
+	auto	sum = ((flags & REGION_CHECKSUMS) != 0) ? CHECKSUM_SIZE : 0;
+
+	if (!arena.Writable()) {
+		return nullptr;
+	}
+
+	auto	*cursor = FindEmpty(arena, nullptr);
+	auto	offset = (cursor == nullptr) ? arena.Size() :
+		    static_cast<size_t>(cursor - arena.Start());
+
+	for (size_t i = 0; i < n; i++) {
+		if (hidden(reserved, recs[i].Tag)) {
+			return nullptr;
+		}
+
+		auto	size = encodedSize(recs[i].Len) + sum;
+		total += syncSize(flags, offset + total, size) + size;
+	}
+
+	if ((cursor == nullptr) || !spaceAvailable(arena, cursor, total)) {
+		if (!growForRecord(arena, offset, total)) {
+			return nullptr;
+		}
+	}
+
+	auto	*start = arena.Start();
+	cursor = start + offset;
+	for (size_t i = 0; i < n; i++) {
+		auto	size = encodedSize(recs[i].Len) + sum;
+		auto	at = static_cast<size_t>(cursor - start);
+		if (syncSize(flags, at, size) != 0) {
+			writeSync(start, at);
+			cursor += SYNC_SIZE;
+		}
+
+		auto	*record = cursor;
+		cursor += EncodeHeader(cursor, recs[i].Tag, recs[i].Len);
+		memcpy(cursor, recs[i].Val, recs[i].Len);
+		cursor += recs[i].Len;
+		if (sum != 0) {
+			writeChecksum(record, static_cast<size_t>(cursor - record));
+			cursor += sum;
+		}
+	}
+	arena.MarkDirty(offset, total);
+
+	// FindEmpty used the region's tail, so the batch starts there.
+	if (decodeRegion(arena, region)) {
+		region.Tail = offset + total;
+		region.Count += n;
+		storeRegion(arena, region);
+	}
+	return cursor;
+}
+
+
+uint8_t *
+WriteBatch(Arena &arena, const Record *recs, size_t n)
+{
+	return writeBatch(arena, recs, n);
+}
+
+
+uint8_t *
+WriteBatch(Arena &arena, const RecordView *views, size_t n)
+{
+	return writeBatch(arena, views, n);
+}
+
+
+uint8_t *
+ReadValue(Arena &arena, uint8_t *cursor, uint8_t &tag, Buffer &val)
+{
+	Header	hdr;
+
+	if (!ReadHeader(arena, cursor, hdr)) {
+		return nullptr;
+	}
+
+	tag = hdr.Tag;
+	val.Clear();
+	val.Append(cursor + hdr.Size, hdr.Len);
+	return cursor + hdr.Size + hdr.Len;
+}
+
+
+uint8_t *
+WriteToMemory(Arena &arena, uint8_t *cursor, Record &rec)
+{
+	return WriteValue(arena, cursor, rec.Tag, rec.Val, rec.Len);
+}
+
+
+bool
+WriteToRing(Arena &arena, Record &rec)
+{
+	auto	*cursor = arena.RingReserve(REC_SIZE(rec));
+
+	if (cursor == nullptr) {
+		return false;
+	}
+
+	memcpy(cursor, &rec, REC_SIZE(rec));
+	return arena.RingCommit(REC_SIZE(rec)) == 0;
+}
+
+
+bool
+ReadFromRing(Arena &arena, Record &rec)
+{
+	auto	*cursor = arena.RingPeek(2);
+
+	if (cursor == nullptr) {
+		return false;
+	}
+
+	// The header says how long the record is; the ring is contiguous,
+	// so the cursor stays valid once the whole record is there.
+	if (arena.RingPeek(static_cast<size_t>(cursor[1]) + 2) == nullptr) {
+		return false;
+	}
+
+	ReadFromMemory(rec, cursor);
+	return arena.RingConsume(REC_SIZE(rec)) == 0;
+}
+
+
+void
+SetRecord(Record &rec, uint8_t tag, uint8_t len, const char *val)
+{
+	rec.Tag = tag;
+	rec.Len = len;
+	memcpy(rec.Val, val, len);
+	clearUnused(rec);
+}
+
+
+void
+ReadFromMemory(Record &rec, uint8_t *cursor)
+{
+	assert(cursor != nullptr);
+	if (cursor == nullptr) {
+		return;
+	}
+	rec.Tag = cursor[0];
+	rec.Len = cursor[1];
+	if (rec.Len > TLV_MAX_LEN) {
+		rec.Len = 0;
+	}
+	memcpy(rec.Val, cursor + 2, rec.Len);
+	clearUnused(rec);
+}
+
+
+/* 
+ * returns a pointer to memory where the record was found,
+ * e.g. FindTag(...)[0] is the tag of the found record.
+ */
+uint8_t *
+FindTag(Arena &arena, uint8_t *cursor, Record &rec)
+{
+	cursor = LocateTag(arena, cursor, rec);
+	if (rec.Tag != TAG_EMPTY) {
+		cursor = SkipRecord(rec, cursor);
+	}
+
+	if (!arena.CursorInArena(cursor)) {
+		cursor = nullptr;
+	}
+
+	return cursor;
+}
+
+
+/// locate finds the next record with the given tag. If compact is true,
+/// records too long to fit in a Record are skipped.
+static uint8_t *
+locate(Arena &arena, uint8_t *cursor, uint8_t tag, Header &hdr, bool compact)
+{
+	if (!arena.CursorInArena(cursor)) {
+		cursor = FirstRecord(arena);
+	}
+
+	while (arena.CursorInArena(cursor)) {
+		if (!ReadHeader(arena, cursor, hdr)) {
+			return nullptr;
+		}
+
+		if ((hdr.Tag == tag) &&
+		    ((tag == TAG_EMPTY) || !compact || (hdr.Len <= TLV_MAX_LEN))) {
+			return cursor;
+		}
+
+		cursor += hdr.Size + hdr.Len;
+	}
+
+	return nullptr;
+}
+
+
+uint8_t *
+LocateTag(Arena &arena, uint8_t *cursor, Record &rec)
+{
+	Header	hdr;
+
+	cursor = locate(arena, cursor, rec.Tag, hdr, true);
+	if ((cursor != nullptr) && (rec.Tag != TAG_EMPTY)) {
+		ReadFromMemory(rec, cursor);
+	}
+	return cursor;
+}
+
+
+uint8_t *
+LocateValue(Arena &arena, uint8_t *cursor, uint8_t tag, Header &hdr)
+{
+	return locate(arena, cursor, tag, hdr, false);
+}
+
+
+uint8_t *
+FindEmpty(Arena &arena, uint8_t *cursor)
+{
+	Record	rec;
+	Region	region;
+
+	// With a region header, the first empty space is already known.
+	if (loadRegion(arena, region)) {
+		auto	*tail = arena.Start() + region.Tail;
+		if (!arena.CursorInArena(cursor) || (cursor <= tail)) {
+			return arena.CursorInArena(tail) ? tail : nullptr;
+		}
+	}
+
+	rec.Tag = TAG_EMPTY;
+	return FindTag(arena, cursor, rec);
+}
+
+
+uint8_t *
+SkipRecord(Record &rec, uint8_t *cursor)
+{
+	return (uint8_t *) ((uintptr_t) cursor + rec.Len + 2);
+}
+
+
+/// checksumSize returns the size of the checksum record at cursor, or 0
+/// if there isn't one. Only arenas whose region flags include
+/// REGION_CHECKSUMS have checksum records.
+static size_t
+checksumSize(Arena &arena, uint16_t flags, uint8_t *cursor)
+{
+	Header	hdr;
+
+	if ((flags & REGION_CHECKSUMS) == 0) {
+		return 0;
+	}
+
+	if (!ReadHeader(arena, cursor, hdr) || (hdr.Tag != TAG_CHECKSUM) ||
+	    (hdr.Len != CHECKSUM_SIZE - 2)) {
+		return 0;
+	}
+
+	return hdr.Size + hdr.Len;
+}
+
+
+/// endOfRecords returns the first empty space at or after cursor, or the
+/// end of the arena if there's none.
+static uint8_t *
+endOfRecords(Arena &arena, uint8_t *cursor)
+{
+	auto	*end = FindEmpty(arena, cursor);
+
+	return (end == nullptr) ? arena.End() : end;
+}
+
+
+void
+DeleteRecord(Arena &arena, uint8_t *cursor)
+{
+	if (cursor == nullptr) {
+		return;
+	}
+
+	if (!arena.CursorInArena(cursor) || !arena.Writable()) {
+		return;
+	}
+
+	Region	region;
+	auto	hasHeader = loadRegion(arena, region);
+	if (hasHeader && (cursor < arena.Start() + REGION_SIZE)) {
+		return;
+	}
+
+	Header	hdr;
+	if (!ReadHeader(arena, cursor, hdr) || (hdr.Tag == TAG_EMPTY) ||
+	    !topLevel(arena, cursor)) {
+		return;
+	}
+
+	// Only the records after this one need to move; everything past
+	// the end of the records is already zero. The record's checksum
+	// goes with it.
+	auto	 flags = static_cast<uint16_t>(hasHeader ? region.Flags : 0);
+	auto	 isSum = checksumSize(arena, flags, cursor) != 0;
+	size_t	 len = hdr.Size + hdr.Len;
+	if (!isSum) {
+		len += checksumSize(arena, flags, cursor + len);
+	}
+	size_t	 offset = static_cast<size_t>(cursor - arena.Start());
+	uint8_t	*end = endOfRecords(arena, cursor + len);
+
+	memmove(cursor, cursor + len, static_cast<size_t>(end - cursor) - len);
+	memset(end - len, 0, len);
+	arena.MarkDirty(offset, static_cast<size_t>(end - cursor));
+
+	if (hasHeader) {
+		// A tombstone's checksum is a tombstone too.
+		region.Tail -= len;
+		if (hdr.Tag == TAG_TOMBSTONE) {
+			region.Dead -= len;
+		} else if (!isSum) {
+			region.Count--;
+		}
+		storeRegion(arena, region);
+	}
+}
+
+
+void
+TombstoneRecord(Arena &arena, uint8_t *cursor)
+{
+	Region	region;
+	Header	hdr;
+
+	if (!arena.CursorInArena(cursor) || !arena.Writable()) {
+		return;
+	}
+
+	// Without a region header, there's nowhere to keep track of
+	// tombstones, so the record is deleted outright.
+	if (!loadRegion(arena, region)) {
+		DeleteRecord(arena, cursor);
+		return;
+	}
+
+	if (cursor < arena.Start() + REGION_SIZE) {
+		return;
+	}
+
+	if (!ReadHeader(arena, cursor, hdr) || (hdr.Tag == TAG_EMPTY) ||
+	    (hdr.Tag == TAG_TOMBSTONE) || !topLevel(arena, cursor)) {
+		return;
+	}
+
+	// The record's checksum no longer matches, so it is buried with
+	// the record.
+	auto	 isSum = checksumSize(arena, region.Flags, cursor) != 0;
+	auto	 size = hdr.Size + hdr.Len;
+	auto	*sum = cursor + size;
+	auto	 sumSize = isSum ? 0 : checksumSize(arena, region.Flags, sum);
+
+	cursor[0] = TAG_TOMBSTONE;
+	arena.MarkDirty(static_cast<size_t>(cursor - arena.Start()), 1);
+	if (sumSize > 0) {
+		sum[0] = TAG_TOMBSTONE;
+		arena.MarkDirty(static_cast<size_t>(sum - arena.Start()), 1);
+	}
+
+	if (!isSum) {
+		region.Count--;
+	}
+	region.Dead += size + sumSize;
+	storeRegion(arena, region);
+}
+
+
+size_t
+Compact(Arena &arena)
+{
+	Header	 hdr;
+	Region	 region;
+	uint8_t	*run = nullptr;
+	uint8_t	*first = nullptr;
+
+	// Only an arena with a region header can hold tombstones.
+	if (!arena.Writable() || !decodeRegion(arena, region)) {
+		return 0;
+	}
+
+	auto	 reserved = reservedFor(region.Flags);
+	auto	*cursor = FirstRecord(arena);
+	auto	*out = cursor;
+
+	// Runs of live records are moved down together, so each byte is
+	// moved at most once.
+	while (arena.CursorInArena(cursor)) {
+		if (!ReadHeader(arena, cursor, hdr) || (hdr.Tag == TAG_EMPTY)) {
+			break;
+		}
+
+		if (hdr.Tag != TAG_TOMBSTONE) {
+			if (run == nullptr) {
+				run = cursor;
+			}
+
+			// Keep sync markers that are about to move pointing
+			// at where they end up.
+			if ((first != nullptr) && hidden(reserved, hdr.Tag) &&
+			    (hdr.Tag == TAG_SYNC) && (hdr.Len == SYNC_SIZE - 2)) {
+				auto	*moved = out + (cursor - run);
+				EncodeLE(cursor + 6,
+					static_cast<uint64_t>(moved - arena.Start()), 8);
+			}
+		} else {
+			if (first == nullptr) {
+				first = cursor;
+			}
+
+			if (run != nullptr) {
+				memmove(out, run, static_cast<size_t>(cursor - run));
+				out += cursor - run;
+				run = nullptr;
+			}
+		}
+
+		cursor += hdr.Size + hdr.Len;
+	}
+
+	if (first == nullptr) {
+		return 0;
+	}
+
+	if (run != nullptr) {
+		memmove(out, run, static_cast<size_t>(cursor - run));
+		out += cursor - run;
+	}
+
+	auto	freed = static_cast<size_t>(cursor - out);
+	memset(out, 0, freed);
+	arena.MarkDirty(static_cast<size_t>(first - arena.Start()),
+			static_cast<size_t>(cursor - first));
+
+	region.Tail = static_cast<size_t>(out - arena.Start());
+	region.Dead = 0;
+	storeRegion(arena, region);
+	return freed;
+}
+
+
+bool
+NeedsCompact(Arena &arena, double ratio)
+{
+	Region	region;
+
+	// Only an arena with a region header can hold tombstones.
+	if (!loadRegion(arena, region) || (region.Dead == 0)) {
+		return false;
+	}
+
+	return static_cast<double>(region.Dead) >=
+	       ratio * static_cast<double>(region.Tail - REGION_SIZE);
+}
+
+
+bool
+Verify(Arena &arena)
+{
+	Header	 hdr;
+	Region	 region;
+	size_t	 count = 0;
+	size_t	 dead = 0;
+	uint8_t	*last = nullptr;
+
+	if (arena.Start() == nullptr) {
+		return false;
+	}
+
+	auto	 reserved = reservedTags(arena);
+	auto	*cursor = FirstRecord(arena);
+	while (arena.CursorInArena(cursor)) {
+		if (!ReadHeader(arena, cursor, hdr)) {
+			return false;
+		}
+
+		auto	size = hdr.Size + hdr.Len;
+		if (hdr.Tag == TAG_EMPTY) {
+			break;
+		} else if (!hidden(reserved, hdr.Tag)) {
+			count++;
+			last = cursor;
+		} else if (hdr.Tag == TAG_TOMBSTONE) {
+			dead += size;
+			last = nullptr;
+		} else if (hdr.Tag == TAG_CHECKSUM) {
+			if (hdr.Len != CHECKSUM_SIZE - 2) {
+				return false;
+			}
+
+			if ((last != nullptr) &&
+			    (CRC32C(last, static_cast<size_t>(cursor - last)) !=
+			     DecodeLE(cursor + 2, CHECKSUM_SIZE - 2))) {
+				return false;
+			}
+			last = nullptr;
+		} else {
+			if (hdr.Len != SYNC_SIZE - 2) {
+				return false;
+			}
+			last = nullptr;
+		}
+
+		cursor += size;
+	}
+
+	if (!decodeRegion(arena, region)) {
+		return true;
+	}
+
+	return (region.Tail == static_cast<size_t>(cursor - arena.Start())) &&
+	       (region.Count == count) && (region.Dead == dead);
+}
+
+
+/// scanSegment reads the records between start and end, visiting each
+/// one and checking checksums. The records have to end exactly at end;
+/// if open is set, they may also end early at an empty tag. Only the
+/// reserved tags are treated as bookkeeping records.
+static bool
+scanSegment(Arena &arena, uint8_t reserved, size_t start, size_t end,
+	    bool open, const ScanFunc &visit, std::atomic<bool> &stop)
+{
+	Header		 hdr;
+	RecordView	 view;
+	uint8_t		*last = nullptr;
+	auto		*base = arena.Start();
+	auto		*cursor = base + start;
+	auto		*limit = base + end;
+
+	while (cursor < limit) {
+		if (stop.load(std::memory_order_relaxed)) {
+			return false;
+		}
+
+		auto	avail = static_cast<size_t>(limit - cursor);
+		if (!DecodeHeader(cursor, avail, hdr)) {
+			return false;
+		}
+
+		if (hdr.Tag == TAG_EMPTY) {
+			return open;
+		}
+
+		if (hdr.Len > avail - hdr.Size) {
+			return false;
+		}
+
+		if (hidden(reserved, hdr.Tag) && (hdr.Tag == TAG_CHECKSUM)) {
+			if ((hdr.Len != CHECKSUM_SIZE - 2) ||
+			    ((last != nullptr) &&
+			     (CRC32C(last, static_cast<size_t>(cursor - last)) !=
+			      DecodeLE(cursor + 2, CHECKSUM_SIZE - 2)))) {
+				return false;
+			}
+			last = nullptr;
+		} else if (hidden(reserved, hdr.Tag)) {
+			last = nullptr;
+		} else {
+			view.Tag = hdr.Tag;
+			view.Len = hdr.Len;
+			view.Val = cursor + hdr.Size;
+			if (!visit(view, static_cast<size_t>(cursor - base))) {
+				return false;
+			}
+			last = cursor;
+		}
+
+		cursor += hdr.Size + hdr.Len;
+	}
+
+	return cursor == limit;
+}
+
+
+/// findSync returns the offset of the first sync marker between from and
+/// to, or 0 if there isn't one.
+static size_t
+findSync(const uint8_t *start, size_t from, size_t to, size_t tail)
+{
+	while (from < to) {
+		auto	*hit = static_cast<const uint8_t *>(
+		    memchr(start + from, TAG_SYNC, to - from));
+		if (hit == nullptr) {
+			break;
+		}
+
+		from = static_cast<size_t>(hit - start);
+		if (isSync(start, from, tail)) {
+			return from;
+		}
+		from++;
+	}
+
+	return 0;
+}
+
+
+/// runWorkers calls work(i) for each i below n, on up to threads threads.
+template <typename Work>
+static void
+runWorkers(size_t threads, size_t n, const Work &work)
+{
+	std::atomic<size_t>		next(0);
+	std::vector<std::thread>	workers;
+	auto				run = [&]() {
+		for (auto i = next++; i < n; i = next++) {
+			work(i);
+		}
+	};
+
+	threads = std::min(threads, n);
+	for (size_t i = 1; i < threads; i++) {
+		workers.emplace_back(run);
+	}
+	run();
+
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+
+bool
+ParallelScan(Arena &arena, const ScanFunc &visit, size_t threads)
+{
+	Region			region;
+	std::atomic<bool>	stop(false);
+
+	if (arena.Start() == nullptr) {
+		return false;
+	}
+
+	auto	first = static_cast<size_t>(FirstRecord(arena) - arena.Start());
+	auto	reserved = reservedTags(arena);
+	if (!loadRegion(arena, region) || ((region.Flags & REGION_SYNC) == 0)) {
+		return scanSegment(arena, reserved, first, arena.Size(), true,
+				   visit, stop);
+	}
+
+	if (threads == 0) {
+		threads = std::max(std::thread::hardware_concurrency(), 1U);
+	}
+
+	// Cut the records into a few pieces per thread, so that uneven
+	// segments even out, but no smaller than the marker spacing. Each
+	// piece starts a segment at its first sync marker, if it has one.
+	auto	span = region.Tail - first;
+	auto	pieces = std::min(threads * 4, span / SYNC_INTERVAL + 1);
+	std::vector<size_t>	starts(pieces, 0);
+
+	starts[0] = first;
+	runWorkers(threads, pieces - 1, [&](size_t i) {
+		starts[i + 1] = findSync(arena.Start(),
+					 first + (i + 1) * span / pieces,
+					 first + (i + 2) * span / pieces,
+					 region.Tail);
+	});
+	starts.erase(std::remove(starts.begin() + 1, starts.end(), 0),
+		     starts.end());
+	starts.push_back(region.Tail);
+
+	runWorkers(threads, starts.size() - 1, [&](size_t i) {
+		if (!scanSegment(arena, reserved, starts[i], starts[i + 1],
+				 false, visit, stop)) {
+			stop = true;
+		}
+	});
+
+	return !stop;
+}
+
+
+uint8_t *
+ReadView(Arena &arena, uint8_t *cursor, RecordView &view)
+{
+	Header	hdr;
+
+	if (!ReadHeader(arena, cursor, hdr)) {
+		return nullptr;
+	}
+
+	view.Tag = hdr.Tag;
+	view.Len = hdr.Len;
+	view.Val = cursor + hdr.Size;
+	return cursor + hdr.Size + hdr.Len;
+}
+
+
+uint8_t *
+WriteContainer(Arena &arena, uint8_t *cursor, uint8_t tag, Arena &children)
+{
+	Region			 region;
+	std::vector<uint8_t>	 nested;
+	uint8_t			 none = 0;
+	const uint8_t		*val = &none;
+	size_t			 len = 0;
+	auto			 reserved = reservedTags(arena);
+
+	if (children.Start() == nullptr) {
+		// An empty container.
+	} else if ((reserved == 0) && (reservedTags(children) == 0)) {
+		// If neither arena reserves any tags, the children's records
+		// can be copied as they are.
+		auto	*start = FirstRecord(children);
+		val = start;
+		len = static_cast<size_t>(endOfRecords(children, start) - start);
+	} else {
+		// Otherwise, only the children's visible records are copied;
+		// their bookkeeping records mean nothing inside a container.
+		// A record with a tag the arena reserves would be hidden in
+		// it, so it can't be nested.
+		for (auto &view : Records(children)) {
+			if (hidden(reserved, view.Tag)) {
+				return nullptr;
+			}
+
+			auto	at = nested.size();
+			nested.resize(at + encodedSize(view.Len));
+			at += EncodeHeader(nested.data() + at, view.Tag, view.Len);
+			memcpy(nested.data() + at, view.Val, view.Len);
+		}
+
+		if (!nested.empty()) {
+			val = nested.data();
+			len = nested.size();
+		}
+	}
+
+	auto	*next = WriteValue(arena, cursor, tag, val, len);
+	if ((next != nullptr) && decodeRegion(arena, region) &&
+	    ((region.Flags & REGION_CONTAINERS) == 0)) {
+		region.Flags |= REGION_CONTAINERS;
+		storeRegion(arena, region);
+	}
+	return next;
+}
+
+
+Scope
+ArenaScope(Arena &arena)
+{
+	if (arena.Start() == nullptr) {
+		return Scope{nullptr, nullptr};
+	}
+
+	auto	*start = FirstRecord(arena);
+	return Scope{start, endOfRecords(arena, start)};
+}
+
+
+bool
+EnterContainer(Arena &arena, uint8_t *cursor, Scope &scope)
+{
+	Header	hdr;
+
+	if (!ReadHeader(arena, cursor, hdr) || (hdr.Tag == TAG_EMPTY)) {
+		return false;
+	}
+
+	scope.Start = cursor + hdr.Size;
+	scope.End = scope.Start + hdr.Len;
+	return true;
+}
+
+
+uint8_t *
+LocateIn(Arena &arena, const Scope &scope, uint8_t *cursor, uint8_t tag,
+	 RecordView &view)
+{
+	if ((cursor == nullptr) || (cursor < scope.Start)) {
+		cursor = scope.Start;
+	}
+
+	RecordIterator	end;
+	for (RecordIterator it(arena, cursor, scope.End); it != end; ++it) {
+		if (it->Tag == tag) {
+			view = *it;
+			return it.Cursor();
+		}
+	}
+
+	return nullptr;
+}
+
+
+uint8_t *
+LocatePath(Arena &arena, const uint8_t *path, size_t depth, RecordView &view)
+{
+	auto		 scope = ArenaScope(arena);
+	uint8_t		*cursor = nullptr;
+
+	for (size_t i = 0; i < depth; i++) {
+		if ((i > 0) && !EnterContainer(arena, cursor, scope)) {
+			return nullptr;
+		}
+
+		cursor = LocateIn(arena, scope, nullptr, path[i], view);
+		if (cursor == nullptr) {
+			return nullptr;
+		}
+	}
+
+	return cursor;
+}
+
+
+bool
+CopyView(const RecordView &view, Record &rec)
+{
+	if ((view.Val == nullptr) || (view.Len > TLV_MAX_LEN)) {
+		return false;
+	}
+
+	rec.Tag = view.Tag;
+	rec.Len = static_cast<uint8_t>(view.Len);
+	memcpy(rec.Val, view.Val, view.Len);
+	clearUnused(rec);
+	return true;
+}
+
+
+bool
+ViewEquals(const RecordView &view, const void *val, size_t len)
+{
+	if (view.Len != len) {
+		return false;
+	}
+
+	return (len == 0) || (memcmp(view.Val, val, len) == 0);
+}
+
+
+RecordIterator::RecordIterator()
+    : arena(nullptr), cursor(nullptr), next(nullptr), limit(nullptr),
+      view{TAG_EMPTY, 0, nullptr}, reserved(0)
+{}
+
+
+RecordIterator::RecordIterator(Arena &backing, uint8_t *start, uint8_t *end)
+    : arena(&backing), cursor(nullptr), next(nullptr), limit(end),
+      view{TAG_EMPTY, 0, nullptr}, reserved(reservedTags(backing))
+{
+	if ((end == nullptr) && !backing.CursorInArena(start)) {
+		start = FirstRecord(backing);
+	}
+
+	this->load(start);
+}
+
+
+RecordIterator &
+RecordIterator::operator++()
+{
+	if (this->cursor != nullptr) {
+		this->load(this->next);
+	}
+	return *this;
+}
+
+
+RecordIterator
+RecordIterator::operator++(int)
+{
+	auto	prev = *this;
+
+	++*this;
+	return prev;
+}
+
+
+void
+RecordIterator::load(uint8_t *at)
+{
+	this->cursor = nullptr;
+	this->next = nullptr;
+
+	if ((this->arena == nullptr) || !this->arena->CursorInArena(at)) {
+		return;
+	}
+
+	auto	*after = ReadView(*this->arena, at, this->view);
+	while ((after != nullptr) && hidden(this->reserved, this->view.Tag)) {
+		at = after;
+		after = ReadView(*this->arena, at, this->view);
+	}
+
+	if ((after == nullptr) || (this->view.Tag == TAG_EMPTY)) {
+		return;
+	}
+
+	if ((this->limit != nullptr) && ((at >= this->limit) ||
+					 (after > this->limit))) {
+		return;
+	}
+
+	this->cursor = at;
+	this->next = after;
 }
 
 
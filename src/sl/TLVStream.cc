@@ -0,0 +1,390 @@
+///
+/// \file src/sl/TLVStream.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Streaming TLV records to and from file descriptors.
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that
+/// the above copyright notice and this permission notice appear in all /// copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+/// AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+/// DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+/// OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+/// TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+/// PERFORMANCE OF THIS SOFTWARE.
+///
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include <scsl/CRC32C.h>
+#include <scsl/TLVStream.h>
+#include <scsl/TLVTypes.h>
+
+
+namespace scsl {
+namespace TLV {
+
+
+/// minWindow is the smallest window a stream will use; it holds a header
+/// and a checksum record.
+static constexpr size_t	minWindow = HEADER_MAX + CHECKSUM_SIZE;
+
+
+static int
+writeAll(int fd, const uint8_t *data, size_t len)
+{
+	while (len > 0) {
+		auto	n = write(fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+
+		data += n;
+		len -= static_cast<size_t>(n);
+	}
+
+	return 0;
+}
+
+
+StreamWriter::StreamWriter(int fd, size_t window, bool checksums)
+    : fd(fd), window(window > minWindow ? window : minWindow), used(0),
+      written(0), checksums(checksums), failed(false)
+{}
+
+
+StreamWriter::~StreamWriter()
+{
+	this->Flush();
+}
+
+
+int
+StreamWriter::Write(uint8_t tag, const uint8_t *val, size_t len)
+{
+	uint8_t	hdr[HEADER_MAX];
+
+	if (this->failed || (tag == TAG_EMPTY) ||
+	    (this->checksums && (tag == TAG_CHECKSUM)) ||
+	    ((val == nullptr) && (len > 0))) {
+		return -1;
+	}
+
+	auto	hdrSize = EncodeHeader(hdr, tag, len);
+	if ((this->append(hdr, hdrSize) != 0) ||
+	    (this->append(val, len) != 0)) {
+		return -1;
+	}
+
+	if (!this->checksums) {
+		return 0;
+	}
+
+	uint8_t	sum[CHECKSUM_SIZE] = {TAG_CHECKSUM, CHECKSUM_SIZE - 2};
+	EncodeLE(sum + 2, CRC32C(val, len, CRC32C(hdr, hdrSize)),
+		 CHECKSUM_SIZE - 2);
+	return this->append(sum, sizeof(sum));
+}
+
+
+int
+StreamWriter::Write(const Record &rec)
+{
+	return this->Write(rec.Tag, rec.Val, rec.Len);
+}
+
+
+int
+StreamWriter::Flush()
+{
+	if (this->failed) {
+		return -1;
+	}
+
+	if (writeAll(this->fd, this->window.data(), this->used) != 0) {
+		this->failed = true;
+		return -1;
+	}
+
+	this->used = 0;
+	return 0;
+}
+
+
+int
+StreamWriter::Sync()
+{
+	if (this->Flush() != 0) {
+		return -1;
+	}
+
+	// Pipes and sockets can't be synced, and don't need to be.
+	if ((fsync(this->fd) != 0) && (errno != EINVAL)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+
+int
+StreamWriter::append(const uint8_t *data, size_t len)
+{
+	if (len > this->window.size() - this->used) {
+		if (this->Flush() != 0) {
+			return -1;
+		}
+	}
+
+	// Anything that won't fit in the window is written directly rather
+	// than copied through it.
+	if (len > this->window.size()) {
+		if (writeAll(this->fd, data, len) != 0) {
+			this->failed = true;
+			return -1;
+		}
+	} else if (len > 0) {
+		memcpy(this->window.data() + this->used, data, len);
+		this->used += len;
+	}
+
+	this->written += len;
+	return 0;
+}
+
+
+StreamReader::StreamReader(int fd, size_t window, bool checksums)
+    : fd(fd), window(window > minWindow ? window : minWindow), base(0),
+      keep(0), pos(0), end(0), offset(0),
+      flags(checksums ? REGION_CHECKSUMS : 0), region(false), eof(false),
+      done(false), failed(false)
+{
+#if defined(POSIX_FADV_SEQUENTIAL)
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+
+bool
+StreamReader::Next(RecordView &view)
+{
+	Header	hdr;
+
+	while (!this->done && !this->failed) {
+		this->keep = this->pos;
+		if (!this->parse(hdr)) {
+			return false;
+		}
+
+		auto	size = hdr.Size + hdr.Len;
+		this->pos += size;
+
+		// Checksum records are checked along with the record before
+		// them, so any left over belong to tombstones.
+		if (this->reserved(hdr.Tag)) {
+			continue;
+		}
+
+		// A region header only makes sense at the start of an arena;
+		// its flags say which tags the arena reserves. Anything else
+		// with the region tag is an ordinary record.
+		auto	*start = this->window.data() + this->keep;
+		if ((this->base + this->keep == 0) &&
+		    IsRegionHeader(start, size)) {
+			this->flags |= static_cast<uint16_t>(DecodeLE(start + 8, 2));
+			this->region = true;
+			continue;
+		}
+
+		if (!this->verify(size)) {
+			return false;
+		}
+
+		this->offset = this->base + this->keep;
+		view.Tag = hdr.Tag;
+		view.Len = hdr.Len;
+		view.Val = this->window.data() + this->keep + hdr.Size;
+		return true;
+	}
+
+	return false;
+}
+
+
+/// reserved reports whether tag is kept for bookkeeping in this stream:
+/// the tombstone tag if it started with a region header, and the checksum
+/// and sync tags if the region's flags, or the reader's, turn them on.
+bool
+StreamReader::reserved(uint8_t tag) const
+{
+	switch (tag) {
+	case TAG_TOMBSTONE:
+		return this->region;
+	case TAG_CHECKSUM:
+		return (this->flags & REGION_CHECKSUMS) != 0;
+	case TAG_SYNC:
+		return (this->flags & REGION_SYNC) != 0;
+	default:
+		return false;
+	}
+}
+
+
+/// verify checks the record of size bytes at keep against the checksum
+/// record following it, if there is one, so that a damaged record is
+/// never handed out.
+bool
+StreamReader::verify(size_t size)
+{
+	if (!this->reserved(TAG_CHECKSUM)) {
+		return true;
+	}
+
+	this->fill(CHECKSUM_SIZE);
+	if (this->failed) {
+		return false;
+	}
+
+	auto	avail = this->end - this->pos;
+	auto	*sum = this->window.data() + this->pos;
+	if ((avail < 2) || (sum[0] != TAG_CHECKSUM)) {
+		return true;
+	}
+
+	if ((avail < CHECKSUM_SIZE) || (sum[1] != CHECKSUM_SIZE - 2)) {
+		this->failed = true;
+		return false;
+	}
+
+	if (CRC32C(this->window.data() + this->keep, size) !=
+	    DecodeLE(sum + 2, CHECKSUM_SIZE - 2)) {
+		this->failed = true;
+		return false;
+	}
+
+	this->pos += CHECKSUM_SIZE;
+	return true;
+}
+
+
+bool
+StreamReader::Next(Record &rec)
+{
+	RecordView	view;
+
+	if (!this->Next(view)) {
+		return false;
+	}
+
+	if (!CopyView(view, rec)) {
+		this->failed = true;
+		return false;
+	}
+
+	return true;
+}
+
+
+/// fill makes sure that at least need bytes past pos are in the window,
+/// reading more from the file if needed.
+bool
+StreamReader::fill(size_t need)
+{
+	while (this->end - this->pos < need) {
+		if (this->eof) {
+			return false;
+		}
+
+		auto	missing = need - (this->end - this->pos);
+		if (this->window.size() - this->end < missing) {
+			// Slide the bytes still in use to the front of the
+			// window, and grow it if a record is too big to fit.
+			if (this->keep > 0) {
+				memmove(this->window.data(),
+					this->window.data() + this->keep,
+					this->end - this->keep);
+				this->base += this->keep;
+				this->pos -= this->keep;
+				this->end -= this->keep;
+				this->keep = 0;
+			}
+
+			// Growing in steps means a corrupt length can't
+			// allocate more than the data actually read.
+			if (this->window.size() == this->end) {
+				this->window.resize(this->window.size() * 2);
+			}
+		}
+
+		auto	n = read(this->fd, this->window.data() + this->end,
+				 this->window.size() - this->end);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			this->failed = true;
+			return false;
+		}
+
+		if (n == 0) {
+			this->eof = true;
+		}
+		this->end += static_cast<size_t>(n);
+	}
+
+	return true;
+}
+
+
+/// parse decodes the header of the record at pos and makes sure the whole
+/// record is in the window. It returns false at the end of the stream,
+/// marking the reader as failed if the stream ended in the middle of a
+/// record.
+bool
+StreamReader::parse(Header &hdr)
+{
+	this->fill(2);
+	if (this->failed) {
+		return false;
+	}
+
+	auto	avail = this->end - this->pos;
+	auto	*cursor = this->window.data() + this->pos;
+	if ((avail == 0) || (cursor[0] == TAG_EMPTY)) {
+		this->done = true;
+		return false;
+	}
+
+	if ((avail > 1) && (cursor[1] == TLV_LEN_EXTENDED)) {
+		this->fill(HEADER_MAX);
+		if (this->failed) {
+			return false;
+		}
+		avail = this->end - this->pos;
+		cursor = this->window.data() + this->pos;
+	}
+
+	if (!DecodeHeader(cursor, avail, hdr) || (hdr.Size > avail) ||
+	    !this->fill(hdr.Size + hdr.Len)) {
+		this->failed = true;
+		return false;
+	}
+
+	return true;
+}
+
+
+} // namespace TLV
+} // namespace scsl
@@ -0,0 +1,291 @@
+///
+/// \file src/sl/TLVTypes.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Typed values for TLV records.
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that
+/// the above copyright notice and this permission notice appear in all /// copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE
+/// AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+/// DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+/// OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+/// TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+/// PERFORMANCE OF THIS SOFTWARE.
+///
+
+#include <cstring>
+
+#include <scsl/TLVTypes.h>
+
+
+namespace scsl {
+namespace TLV {
+
+
+void
+EncodeLE(uint8_t *dst, uint64_t value, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		dst[i] = static_cast<uint8_t>(value >> (8 * i));
+	}
+}
+
+
+uint64_t
+DecodeLE(const uint8_t *src, size_t n)
+{
+	uint64_t	value = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		value |= static_cast<uint64_t>(src[i]) << (8 * i);
+	}
+
+	return value;
+}
+
+
+size_t
+EncodeVarint(uint8_t *dst, uint64_t value)
+{
+	size_t	n = 0;
+
+	while (value >= 0x80) {
+		dst[n++] = static_cast<uint8_t>((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	dst[n++] = static_cast<uint8_t>(value);
+
+	return n;
+}
+
+
+size_t
+DecodeVarint(const uint8_t *src, size_t avail, uint64_t &value)
+{
+	size_t	n = 0;
+
+	value = 0;
+	while (n < avail) {
+		auto	byte = src[n];
+
+		// The tenth byte only has room for the top bit.
+		if ((n == VARINT_MAX - 1) && (byte > 1)) {
+			return 0;
+		}
+
+		value |= static_cast<uint64_t>(byte & 0x7f) << (7 * n);
+		n++;
+		if ((byte & 0x80) == 0) {
+			return n;
+		}
+	}
+
+	return 0;
+}
+
+
+/// writeFixed writes a record holding the n-byte little-endian encoding
+/// of value.
+static uint8_t *
+writeFixed(Arena &arena, uint8_t *cursor, uint8_t tag, uint64_t value,
+	   size_t n)
+{
+	uint8_t	buf[8];
+
+	EncodeLE(buf, value, n);
+	return WriteValue(arena, cursor, tag, buf, n);
+}
+
+
+/// readFixed decodes a view holding an n-byte little-endian value.
+static bool
+readFixed(const RecordView &view, uint64_t &value, size_t n)
+{
+	if ((view.Len != n) || (view.Val == nullptr)) {
+		return false;
+	}
+
+	value = DecodeLE(view.Val, n);
+	return true;
+}
+
+
+uint8_t *
+WriteU8(Arena &arena, uint8_t *cursor, uint8_t tag, uint8_t value)
+{
+	return writeFixed(arena, cursor, tag, value, sizeof(value));
+}
+
+
+uint8_t *
+WriteU16(Arena &arena, uint8_t *cursor, uint8_t tag, uint16_t value)
+{
+	return writeFixed(arena, cursor, tag, value, sizeof(value));
+}
+
+
+uint8_t *
+WriteU32(Arena &arena, uint8_t *cursor, uint8_t tag, uint32_t value)
+{
+	return writeFixed(arena, cursor, tag, value, sizeof(value));
+}
+
+
+uint8_t *
+WriteU64(Arena &arena, uint8_t *cursor, uint8_t tag, uint64_t value)
+{
+	return writeFixed(arena, cursor, tag, value, sizeof(value));
+}
+
+
+uint8_t *
+WriteVarint(Arena &arena, uint8_t *cursor, uint8_t tag, uint64_t value)
+{
+	uint8_t	buf[VARINT_MAX];
+
+	return WriteValue(arena, cursor, tag, buf, EncodeVarint(buf, value));
+}
+
+
+uint8_t *
+WriteSigned(Arena &arena, uint8_t *cursor, uint8_t tag, int64_t value)
+{
+	return WriteVarint(arena, cursor, tag, ZigZagEncode(value));
+}
+
+
+uint8_t *
+WriteFloat(Arena &arena, uint8_t *cursor, uint8_t tag, float value)
+{
+	uint32_t	bits;
+
+	static_assert(sizeof(bits) == sizeof(value), "float isn't 32 bits");
+	memcpy(&bits, &value, sizeof(bits));
+	return writeFixed(arena, cursor, tag, bits, sizeof(bits));
+}
+
+
+uint8_t *
+WriteDouble(Arena &arena, uint8_t *cursor, uint8_t tag, double value)
+{
+	uint64_t	bits;
+
+	static_assert(sizeof(bits) == sizeof(value), "double isn't 64 bits");
+	memcpy(&bits, &value, sizeof(bits));
+	return writeFixed(arena, cursor, tag, bits, sizeof(bits));
+}
+
+
+bool
+ReadU8(const RecordView &view, uint8_t &value)
+{
+	uint64_t	raw;
+
+	if (!readFixed(view, raw, sizeof(value))) {
+		return false;
+	}
+
+	value = static_cast<uint8_t>(raw);
+	return true;
+}
+
+
+bool
+ReadU16(const RecordView &view, uint16_t &value)
+{
+	uint64_t	raw;
+
+	if (!readFixed(view, raw, sizeof(value))) {
+		return false;
+	}
+
+	value = static_cast<uint16_t>(raw);
+	return true;
+}
+
+
+bool
+ReadU32(const RecordView &view, uint32_t &value)
+{
+	uint64_t	raw;
+
+	if (!readFixed(view, raw, sizeof(value))) {
+		return false;
+	}
+
+	value = static_cast<uint32_t>(raw);
+	return true;
+}
+
+
+bool
+ReadU64(const RecordView &view, uint64_t &value)
+{
+	return readFixed(view, value, sizeof(value));
+}
+
+
+bool
+ReadVarint(const RecordView &view, uint64_t &value)
+{
+	if (view.Val == nullptr) {
+		return false;
+	}
+
+	return (view.Len > 0) &&
+	       (DecodeVarint(view.Val, view.Len, value) == view.Len);
+}
+
+
+bool
+ReadSigned(const RecordView &view, int64_t &value)
+{
+	uint64_t	raw;
+
+	if (!ReadVarint(view, raw)) {
+		return false;
+	}
+
+	value = ZigZagDecode(raw);
+	return true;
+}
+
+
+bool
+ReadFloat(const RecordView &view, float &value)
+{
+	uint64_t	raw;
+
+	if (!readFixed(view, raw, sizeof(value))) {
+		return false;
+	}
+
+	auto	bits = static_cast<uint32_t>(raw);
+	memcpy(&value, &bits, sizeof(value));
+	return true;
+}
+
+
+bool
+ReadDouble(const RecordView &view, double &value)
+{
+	uint64_t	raw;
+
+	if (!readFixed(view, raw, sizeof(value))) {
+		return false;
+	}
+
+	memcpy(&value, &raw, sizeof(value));
+	return true;
+}
+
+
+} // namespace TLV
+} // namespace scsl
@@ -0,0 +1,799 @@
+///
+/// \file test/arena.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Unit tests for the Arena class.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#include <scsl/Arena.h>
+#include <scsl/Buffer.h>
+#include <scsl/Flags.h>
+#include <sctest/Checks.h>
+#include <sctest/SimpleSuite.h>
+
+#include "test_fixtures.h"
+
+
+using namespace scsl;
+
+
+static uint8_t		arenaBuffer[ARENA_SIZE];
+
+
+static bool
+setupArena(Arena &arena, ArenaType arenaType)
+{
+	switch (arenaType) {
+	case ArenaType::Static:
+		return arena.SetStatic(arenaBuffer, ARENA_SIZE) == 0;
+	case ArenaType::Alloc:
+		return arena.SetAlloc(ARENA_SIZE) == 0;
+	case ArenaType::MemoryMapped:
+		return arena.Create(ARENA_FILE, ARENA_SIZE) == 0;
+	default:
+		std::cerr << "[!] " << static_cast<int>(arenaType)
+			  << " is invalid for this test.\n";
+		return false;
+	}
+}
+
+
+static bool
+isAligned(const void *p, size_t align)
+{
+	return (reinterpret_cast<uintptr_t>(p) % align) == 0;
+}
+
+
+bool
+runAllocTest(Arena &arena)
+{
+	SCTEST_CHECK_EQ(arena.Used(), 0);
+
+	auto *first = static_cast<uint8_t *>(arena.Alloc(3, 1));
+	SCTEST_CHECK_EQ(first, arena.Start());
+	SCTEST_CHECK_EQ(arena.Used(), 3);
+
+	auto *second = arena.Alloc(8, 8);
+	SCTEST_CHECK_NE(second, nullptr);
+	SCTEST_CHECK(isAligned(second, 8));
+	SCTEST_CHECK(arena.CursorInArena(static_cast<uint8_t *>(second)));
+
+	// Alignments that aren't powers of two are rejected.
+	SCTEST_CHECK_EQ(arena.Alloc(1, 3), nullptr);
+	SCTEST_CHECK_EQ(arena.Alloc(1, 0), nullptr);
+
+	auto mark = arena.Mark();
+	SCTEST_CHECK_NE(arena.Alloc(16, 16), nullptr);
+	SCTEST_CHECK(arena.Used() > mark);
+	arena.Rewind(mark);
+	SCTEST_CHECK_EQ(arena.Used(), mark);
+
+	// Rewinding forward is a no-op.
+	arena.Rewind(ARENA_SIZE);
+	SCTEST_CHECK_EQ(arena.Used(), mark);
+
+	// Exhausting the arena fails without moving the offset.
+	SCTEST_CHECK_EQ(arena.Alloc(ARENA_SIZE, 1), nullptr);
+	SCTEST_CHECK_EQ(arena.Used(), mark);
+
+	arena.Reset();
+	SCTEST_CHECK_EQ(arena.Used(), 0);
+
+	auto *whole = arena.Alloc(ARENA_SIZE, 1);
+	SCTEST_CHECK_EQ(whole, arena.Start());
+	SCTEST_CHECK_EQ(arena.Alloc(1, 1), nullptr);
+
+	arena.Reset();
+	SCTEST_CHECK_EQ(arena.Alloc(0, 1), arena.Start());
+	return true;
+}
+
+
+bool
+arenaTestSuite(ArenaType arenaType)
+{
+	Arena arena;
+
+	if (!setupArena(arena, arenaType)) {
+		std::cerr << "[!] failed to set up arena\n";
+		return false;
+	}
+
+	auto result = runAllocTest(arena);
+	if (!result) {
+		std::cerr << "[!] suite failed with " << arena << "\n";
+	}
+	arena.Destroy();
+	return result;
+}
+
+
+bool
+chunkedArena()
+{
+	Arena		 arena;
+	uint8_t		*ptrs[8];
+
+	SCTEST_CHECK_EQ(arena.SetChunked(0), -1);
+	SCTEST_CHECK_EQ(arena.SetChunked(32, 2, 16), -1);
+	SCTEST_CHECK_EQ(arena.SetChunked(32), 0);
+	SCTEST_CHECK_EQ(arena.Type(), ArenaType::Chunked);
+	SCTEST_CHECK_EQ(arena.Size(), 32);
+	SCTEST_CHECK_EQ(arena.Reserved(), 32);
+
+	// Allocations that don't fit in the first chunk should grow the
+	// arena without moving anything already allocated.
+	for (size_t i = 0; i < 8; i++) {
+		ptrs[i] = static_cast<uint8_t *>(arena.Alloc(24, 8));
+		SCTEST_CHECK_NE(ptrs[i], nullptr);
+		SCTEST_CHECK(isAligned(ptrs[i], 8));
+		memset(ptrs[i], static_cast<int>(i), 24);
+	}
+	SCTEST_CHECK(arena.Reserved() > 32);
+	SCTEST_CHECK_EQ(ptrs[0], arena.Start());
+
+	for (size_t i = 0; i < 8; i++) {
+		for (size_t j = 0; j < 24; j++) {
+			SCTEST_CHECK_EQ(ptrs[i][j], i);
+		}
+	}
+
+	// A single allocation larger than the growth policy would give
+	// must still succeed.
+	SCTEST_CHECK_NE(arena.Alloc(4096, 1), nullptr);
+
+	// Rewinding and reallocating should reuse the existing chunks.
+	auto reserved = arena.Reserved();
+	arena.Reset();
+	SCTEST_CHECK_EQ(arena.Used(), 0);
+	SCTEST_CHECK_EQ(arena.Alloc(24, 8), ptrs[0]);
+	for (size_t i = 1; i < 8; i++) {
+		SCTEST_CHECK_EQ(arena.Alloc(24, 8), ptrs[i]);
+	}
+
+	auto mark = arena.Mark();
+	SCTEST_CHECK_NE(arena.Alloc(4096, 1), nullptr);
+	arena.Rewind(mark);
+	SCTEST_CHECK_EQ(arena.Alloc(1, 1), ptrs[7] + 24);
+	SCTEST_CHECK_EQ(arena.Reserved(), reserved);
+
+	arena.Destroy();
+	SCTEST_CHECK_EQ(arena.Reserved(), 0);
+
+	// With a limit, the arena stops growing once it's reached.
+	SCTEST_CHECK_EQ(arena.SetChunked(32, 1, 64), 0);
+	SCTEST_CHECK_NE(arena.Alloc(32, 1), nullptr);
+	SCTEST_CHECK_NE(arena.Alloc(32, 1), nullptr);
+	SCTEST_CHECK_EQ(arena.Alloc(1, 1), nullptr);
+	SCTEST_CHECK_EQ(arena.Reserved(), 64);
+
+	return true;
+}
+
+
+bool
+growMappedArena()
+{
+	Arena		arena;
+	struct stat	st{};
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(ARENA_SIZE), 0);
+	SCTEST_CHECK_EQ(arena.Grow(ARENA_SIZE * 2), -1);
+	arena.EnableAutoGrow();
+	SCTEST_CHECK_FALSE(arena.AutoGrowIsEnabled());
+
+	SCTEST_CHECK_EQ(arena.Create(ARENA_FILE, ARENA_SIZE), 0);
+	SCTEST_CHECK(arena.AutoGrowIsEnabled());
+	arena[0] = 0x5a;
+	arena[ARENA_SIZE - 1] = 0xa5;
+
+	// Growing to a size smaller than the arena is a no-op.
+	SCTEST_CHECK_EQ(arena.Grow(ARENA_SIZE / 2), 0);
+	SCTEST_CHECK_EQ(arena.Size(), ARENA_SIZE);
+
+	// Small growth requests should at least double the arena.
+	SCTEST_CHECK_EQ(arena.Grow(ARENA_SIZE + 1), 0);
+	SCTEST_CHECK_EQ(arena.Size(), ARENA_SIZE * 2);
+	SCTEST_CHECK_EQ(arena.Grow(ARENA_SIZE * 8), 0);
+	SCTEST_CHECK_EQ(arena.Size(), ARENA_SIZE * 8);
+
+	SCTEST_CHECK_EQ(arena[0], 0x5a);
+	SCTEST_CHECK_EQ(arena[ARENA_SIZE - 1], 0xa5);
+	for (size_t i = ARENA_SIZE; i < arena.Size(); i++) {
+		SCTEST_CHECK_EQ(arena[i], 0);
+	}
+
+	SCTEST_CHECK_EQ(stat(ARENA_FILE, &st), 0);
+	SCTEST_CHECK_EQ(static_cast<size_t>(st.st_size), ARENA_SIZE * 8);
+
+	// The grown file should come back intact when reopened.
+	arena.Destroy();
+	SCTEST_CHECK_EQ(arena.Open(ARENA_FILE), 0);
+	SCTEST_CHECK_EQ(arena.Size(), ARENA_SIZE * 8);
+	SCTEST_CHECK_EQ(arena[0], 0x5a);
+	SCTEST_CHECK_EQ(arena[ARENA_SIZE - 1], 0xa5);
+
+	arena.DisableAutoGrow();
+	SCTEST_CHECK_FALSE(arena.AutoGrowIsEnabled());
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+arenaOptions()
+{
+	Arena		arena;
+	ArenaOptions	options;
+
+	options.Prefault = true;
+	options.HugePages = true;
+	options.WillNeed = true;
+	options.Lock = true;
+	options.Access = ArenaAccess::Random;
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(ARENA_SIZE, options), 0);
+	SCTEST_CHECK_EQ(arena[ARENA_SIZE - 1], 0);
+	arena.Destroy();
+
+	SCTEST_CHECK_EQ(arena.Create(ARENA_FILE, ARENA_SIZE, options), 0);
+	arena[0] = 0x5a;
+	SCTEST_CHECK_EQ(arena.Grow(ARENA_SIZE * 2), 0);
+	SCTEST_CHECK_EQ(arena[0], 0x5a);
+	arena.Destroy();
+
+	options.HugePages = false;
+	options.Access = ArenaAccess::Sequential;
+	SCTEST_CHECK_EQ(arena.Open(ARENA_FILE, options), 0);
+	SCTEST_CHECK_EQ(arena.Size(), ARENA_SIZE * 2);
+	SCTEST_CHECK_EQ(arena[0], 0x5a);
+	arena.Destroy();
+
+	// NUMA placement falls back to the default on machines with one
+	// node, or if the node doesn't exist.
+	SCTEST_CHECK(Arena::NumaNodes() >= 1);
+	SCTEST_CHECK(Arena::CurrentNumaNode() < Arena::NumaNodes());
+	options.Numa = ArenaNuma::Bind;
+	options.NumaNode = Arena::NumaNodes() - 1;
+	SCTEST_CHECK_EQ(arena.SetAlloc(ARENA_SIZE, options), 0);
+	SCTEST_CHECK_EQ(arena.Stats().ResidentPages, arena.Stats().Pages);
+	options.Numa = ArenaNuma::Interleave;
+	SCTEST_CHECK_EQ(arena.CreateShared(nullptr, ARENA_SIZE, options), 0);
+	arena[0] = 0x5a;
+	options.Numa = ArenaNuma::Preferred;
+	options.NumaNode = 4096;
+	SCTEST_CHECK_EQ(arena.SetAlloc(ARENA_SIZE, options), 0);
+	arena[0] = 0x5a;
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+flushArena()
+{
+	Arena	arena;
+
+	// Arenas without a backing file have nothing to flush.
+	SCTEST_CHECK_EQ(arena.SetAlloc(ARENA_SIZE), 0);
+	SCTEST_CHECK_EQ(arena.Flush(0, ARENA_SIZE), 0);
+	SCTEST_CHECK_EQ(arena.Flush(1, ARENA_SIZE), -1);
+	SCTEST_CHECK_EQ(arena.FlushDirty(), 0);
+	SCTEST_CHECK_EQ(arena.Barrier(), 0);
+
+	SCTEST_CHECK_EQ(arena.Create(ARENA_FILE, ARENA_SIZE), 0);
+	SCTEST_CHECK_EQ(arena.Flush(ARENA_SIZE + 1, 0), -1);
+	SCTEST_CHECK_EQ(arena.Flush(ARENA_SIZE, 0), 0);
+
+	arena[3] = 0x5a;
+	SCTEST_CHECK_EQ(arena.Flush(3, 1), 0);
+	arena[7] = 0xa5;
+	SCTEST_CHECK_EQ(arena.Flush(7, 1, ArenaFlush::Async), 0);
+
+	arena[ARENA_SIZE - 1] = 0x42;
+	arena.MarkDirty(ARENA_SIZE - 1, 1);
+	arena.MarkDirty(4, 1);
+	SCTEST_CHECK_EQ(arena.FlushDirty(ArenaFlush::Async), 0);
+	SCTEST_CHECK_EQ(arena.FlushDirty(), 0);
+	SCTEST_CHECK_EQ(arena.Barrier(), 0);
+	arena.Destroy();
+
+	SCTEST_CHECK_EQ(arena.Open(ARENA_FILE), 0);
+	SCTEST_CHECK_EQ(arena[3], 0x5a);
+	SCTEST_CHECK_EQ(arena[7], 0xa5);
+	SCTEST_CHECK_EQ(arena[ARENA_SIZE - 1], 0x42);
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+snapshotArena()
+{
+	Arena		writer;
+	Arena		reader;
+	ArenaOptions	options;
+
+	SCTEST_CHECK_EQ(writer.Create(ARENA_FILE, ARENA_SIZE), 0);
+	writer[0] = 0x5a;
+
+	SCTEST_CHECK_EQ(reader.Snapshot(ARENA_FILE), 0);
+	SCTEST_CHECK(reader.Ready());
+	SCTEST_CHECK_FALSE(reader.Writable());
+	SCTEST_CHECK_EQ(reader.Size(), ARENA_SIZE);
+	SCTEST_CHECK_EQ(reader[0], 0x5a);
+
+	// Changes made after the snapshot was taken aren't visible in it.
+	writer[0] = 0xa5;
+	writer[ARENA_SIZE - 1] = 0x42;
+	SCTEST_CHECK_EQ(reader[0], 0x5a);
+	SCTEST_CHECK_EQ(reader[ARENA_SIZE - 1], 0);
+	SCTEST_CHECK_EQ(reader.Grow(ARENA_SIZE * 2), -1);
+	SCTEST_CHECK_EQ(reader.Alloc(8), nullptr);
+	SCTEST_CHECK_EQ(reader.Stats().FailedAllocs, 1);
+	reader.Destroy();
+
+	// A private mapping keeps its writes to itself.
+	options.Private = true;
+	SCTEST_CHECK_EQ(reader.Open(ARENA_FILE, options), 0);
+	SCTEST_CHECK(reader.Writable());
+	reader[1] = 0x17;
+	SCTEST_CHECK_EQ(reader.FlushDirty(), 0);
+	SCTEST_CHECK_EQ(writer[1], 0);
+	reader.Destroy();
+
+	options.Private = false;
+	options.ReadOnly = true;
+	SCTEST_CHECK_EQ(reader.Open(ARENA_FILE, options), 0);
+	SCTEST_CHECK_FALSE(reader.Writable());
+	SCTEST_CHECK_EQ(reader[0], 0xa5);
+	SCTEST_CHECK_EQ(reader.Alloc(8), nullptr);
+	reader.Destroy();
+
+	writer.Destroy();
+	SCTEST_CHECK_EQ(reader.Snapshot("/nonexistent/arena"), -1);
+	return true;
+}
+
+
+static bool
+checkCleared(Arena &arena, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		SCTEST_CHECK_EQ(arena.Start()[i], 0);
+	}
+	return true;
+}
+
+
+bool
+clearArena()
+{
+	Arena		arena;
+	const size_t	bigArena = 1024 * 1024;
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(0), -1);
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(bigArena), 0);
+	SCTEST_CHECK_EQ(arena.HighWater(), 0);
+	SCTEST_CHECK(checkCleared(arena, bigArena));
+
+	auto *mem = static_cast<uint8_t *>(arena.Alloc(100, 1));
+	memset(mem, 0xff, 100);
+	SCTEST_CHECK_EQ(arena.HighWater(), 100);
+	arena.Reset();
+	SCTEST_CHECK_EQ(arena.HighWater(), 100);
+	arena.ClearUsed();
+	SCTEST_CHECK_EQ(arena.HighWater(), 0);
+	SCTEST_CHECK(checkCleared(arena, 100));
+
+	// Writes through Start() don't raise the mark, so only Clear is
+	// sure to remove them.
+	arena.Start()[bigArena - 1] = 0x5a;
+	arena.ClearUsed();
+	SCTEST_CHECK_EQ(arena.Start()[bigArena - 1], 0x5a);
+	arena.Clear();
+	SCTEST_CHECK(checkCleared(arena, bigArena));
+
+	// Large clears hand whole pages back to the kernel, but the edges
+	// still need to be zeroed by hand.
+	arena[3] = 0x5a;
+	arena[bigArena / 2] = 0x5a;
+	arena[bigArena - 3] = 0x5a;
+	SCTEST_CHECK_EQ(arena.HighWater(), bigArena - 2);
+	arena.Clear();
+	SCTEST_CHECK(checkCleared(arena, bigArena));
+	arena.Destroy();
+
+	SCTEST_CHECK_EQ(arena.Create(ARENA_FILE, bigArena), 0);
+	SCTEST_CHECK_EQ(arena.HighWater(), 0);
+	arena[7] = 0x5a;
+	arena[bigArena - 7] = 0x5a;
+	arena.Clear();
+	SCTEST_CHECK(checkCleared(arena, bigArena));
+	arena.Destroy();
+
+	// An existing file could have anything in it.
+	SCTEST_CHECK_EQ(arena.Open(ARENA_FILE), 0);
+	SCTEST_CHECK_EQ(arena.HighWater(), bigArena);
+	arena.Destroy();
+
+	SCTEST_CHECK_EQ(arena.SetChunked(64, 2), 0);
+	mem = static_cast<uint8_t *>(arena.Alloc(48, 1));
+	memset(mem, 0xff, 48);
+	mem = static_cast<uint8_t *>(arena.Alloc(48, 1));
+	memset(mem, 0xff, 48);
+	arena.Clear();
+	SCTEST_CHECK_EQ(arena.HighWater(), 0);
+	SCTEST_CHECK_EQ(mem[0], 0);
+	SCTEST_CHECK(checkCleared(arena, 64));
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+sharedArena()
+{
+	Arena		arena;
+	Arena		peer;
+	ArenaOptions	options;
+	const char	*name = "/scsl-test-arena";
+	const size_t	bigArena = 1024 * 1024;
+
+	SCTEST_CHECK_EQ(arena.CreateShared(nullptr, 0), -1);
+	SCTEST_CHECK_EQ(arena.Descriptor(), -1);
+
+	SCTEST_CHECK_EQ(arena.CreateShared(nullptr, ARENA_SIZE), 0);
+	SCTEST_CHECK_EQ(arena.Type(), ArenaType::SharedMemory);
+	SCTEST_CHECK_EQ(arena.HighWater(), 0);
+	SCTEST_CHECK(checkCleared(arena, ARENA_SIZE));
+	SCTEST_CHECK_NE(arena.Descriptor(), -1);
+
+	// Writes through either mapping are seen by the other.
+	SCTEST_CHECK_EQ(peer.MapShared(dup(arena.Descriptor())), 0);
+	SCTEST_CHECK_EQ(peer.Size(), ARENA_SIZE);
+	SCTEST_CHECK_EQ(peer.HighWater(), ARENA_SIZE);
+	arena[3] = 0x5a;
+	SCTEST_CHECK_EQ(peer[3], 0x5a);
+	peer[4] = 0xa5;
+	SCTEST_CHECK_EQ(arena[4], 0xa5);
+	peer.Destroy();
+
+	// Shared memory can grow; the existing data stays put.
+	SCTEST_CHECK_EQ(arena.Grow(ARENA_SIZE + 1), 0);
+	SCTEST_CHECK_EQ(arena.Size(), ARENA_SIZE * 2);
+	SCTEST_CHECK_EQ(arena[3], 0x5a);
+	SCTEST_CHECK_EQ(arena.Flush(0, arena.Size()), 0);
+	arena.Destroy();
+
+	(void)Arena::UnlinkShared(name);
+	SCTEST_CHECK_EQ(peer.OpenShared(name), -1);
+	SCTEST_CHECK_EQ(arena.CreateShared(name, bigArena), 0);
+	options.ReadOnly = true;
+	SCTEST_CHECK_EQ(peer.OpenShared(name, options), 0);
+	SCTEST_CHECK_FALSE(peer.Writable());
+	arena[7] = 0x5a;
+	arena[bigArena - 7] = 0x5a;
+	SCTEST_CHECK_EQ(peer.Start()[bigArena - 7], 0x5a);
+
+	arena.Clear();
+	SCTEST_CHECK(checkCleared(peer, bigArena));
+
+	// Unlinking the name leaves existing mappings working.
+	SCTEST_CHECK_EQ(Arena::UnlinkShared(name), 0);
+	arena[9] = 0x5a;
+	SCTEST_CHECK_EQ(peer.Start()[9], 0x5a);
+	peer.Destroy();
+	SCTEST_CHECK_EQ(peer.OpenShared(name), -1);
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+arenaStats()
+{
+	Arena		arena;
+	ArenaStats	stats;
+	ArenaOptions	options;
+
+	stats = arena.Stats();
+	SCTEST_CHECK_EQ(stats.Size, 0);
+	SCTEST_CHECK_EQ(stats.Pages, 0);
+
+	options.Prefault = true;
+	SCTEST_CHECK_EQ(arena.SetAlloc(ARENA_SIZE, options), 0);
+	SCTEST_CHECK_NE(arena.Alloc(3, 1), nullptr);
+	SCTEST_CHECK_NE(arena.Alloc(8, 8), nullptr);
+	SCTEST_CHECK_EQ(arena.Alloc(ARENA_SIZE, 1), nullptr);
+
+	stats = arena.Stats();
+	SCTEST_CHECK_EQ(stats.Size, ARENA_SIZE);
+	SCTEST_CHECK_EQ(stats.Reserved, ARENA_SIZE);
+	SCTEST_CHECK_EQ(stats.Used, 16);
+	SCTEST_CHECK_EQ(stats.HighWater, 16);
+	SCTEST_CHECK_EQ(stats.Allocs, 2);
+	SCTEST_CHECK_EQ(stats.FailedAllocs, 1);
+	SCTEST_CHECK_EQ(stats.AllocBytes, 11);
+	SCTEST_CHECK_EQ(stats.PaddingBytes, 5);
+	SCTEST_CHECK(stats.Pages > 0);
+	SCTEST_CHECK_EQ(stats.ResidentPages, stats.Pages);
+
+	arena.Clear();
+	stats = arena.Stats();
+	SCTEST_CHECK_EQ(stats.Clears, 1);
+	SCTEST_CHECK_EQ(stats.HighWater, 0);
+
+	arena.ResetStats();
+	stats = arena.Stats();
+	SCTEST_CHECK_EQ(stats.Allocs, 0);
+	SCTEST_CHECK_EQ(stats.Clears, 0);
+	SCTEST_CHECK_EQ(stats.Used, 16);
+
+	// Mapped files count flushes and growth, and only the pages that
+	// have been touched are resident.
+	SCTEST_CHECK_EQ(arena.Create(ARENA_FILE, 1024 * 1024), 0);
+	stats = arena.Stats();
+	SCTEST_CHECK_EQ(stats.Allocs, 0);
+	SCTEST_CHECK(stats.ResidentPages < stats.Pages);
+	arena[0] = 1;
+	SCTEST_CHECK_EQ(arena.Flush(0, 1), 0);
+	SCTEST_CHECK_EQ(arena.Barrier(), 0);
+	SCTEST_CHECK_EQ(arena.Grow(arena.Size() + 1), 0);
+	SCTEST_CHECK_EQ(arena.Write(ARENA_FILE ".copy"), 0);
+	stats = arena.Stats();
+	SCTEST_CHECK_EQ(stats.Flushes, 2);
+	SCTEST_CHECK_EQ(stats.Grows, 1);
+	SCTEST_CHECK_EQ(stats.Writes, 1);
+	SCTEST_CHECK(stats.ResidentPages > 0);
+	arena.Destroy();
+	remove(ARENA_FILE ".copy");
+
+	// Every chunk after the first counts as growth.
+	SCTEST_CHECK_EQ(arena.SetChunked(64, 2), 0);
+	SCTEST_CHECK_NE(arena.Alloc(48, 1), nullptr);
+	SCTEST_CHECK_NE(arena.Alloc(48, 1), nullptr);
+	stats = arena.Stats();
+	SCTEST_CHECK_EQ(stats.Grows, 1);
+	SCTEST_CHECK_EQ(stats.Reserved, 64 + 128);
+	SCTEST_CHECK_EQ(stats.PaddingBytes, 16);
+	SCTEST_CHECK_EQ(stats.Pages, 0);
+	arena.Destroy();
+	return true;
+}
+
+
+static bool
+sameContents(Arena &arena, const char *path)
+{
+	Arena	copy;
+
+	SCTEST_CHECK_EQ(copy.Open(path), 0);
+	SCTEST_CHECK_EQ(copy.Size(), arena.Size());
+	SCTEST_CHECK_EQ(memcmp(copy.Start(), arena.Start(), arena.Size()), 0);
+	copy.Destroy();
+	return true;
+}
+
+
+bool
+writeArena()
+{
+	Arena		arena;
+	struct stat	st{};
+	const char	*copyFile = ARENA_FILE ".copy";
+	const size_t	bigArena = 1024 * 1024;
+
+	// Only the used prefix is copied, but the file is still the size
+	// of the arena.
+	SCTEST_CHECK_EQ(arena.SetAlloc(bigArena), 0);
+	arena[0] = 0x5a;
+	arena[5000] = 0xa5;
+	SCTEST_CHECK_EQ(arena.Write(copyFile, ArenaWrite::Used), 0);
+	SCTEST_CHECK_EQ(stat(copyFile, &st), 0);
+	SCTEST_CHECK_EQ(static_cast<size_t>(st.st_size), bigArena);
+	SCTEST_CHECK(sameContents(arena, copyFile));
+
+	// Existing files keep their permissions.
+	SCTEST_CHECK_EQ(chmod(copyFile, 0600), 0);
+	arena[bigArena - 1] = 0x5a;
+	SCTEST_CHECK_EQ(arena.Write(copyFile), 0);
+	SCTEST_CHECK_EQ(stat(copyFile, &st), 0);
+	SCTEST_CHECK_EQ(st.st_mode & 0777, 0600);
+	SCTEST_CHECK(sameContents(arena, copyFile));
+	arena.Destroy();
+
+	// Mapped arenas are copied from their backing file.
+	SCTEST_CHECK_EQ(arena.Create(ARENA_FILE, bigArena), 0);
+	arena[7] = 0x5a;
+	arena[bigArena / 2] = 0xa5;
+	SCTEST_CHECK_EQ(arena.Write(copyFile), 0);
+	SCTEST_CHECK(sameContents(arena, copyFile));
+	SCTEST_CHECK_EQ(arena.Write(copyFile, ArenaWrite::Used), 0);
+	SCTEST_CHECK(sameContents(arena, copyFile));
+
+	// Writing over the backing file leaves the arena usable.
+	SCTEST_CHECK_EQ(arena.Write(ARENA_FILE), 0);
+	arena[8] = 0x5a;
+	SCTEST_CHECK_EQ(arena[7], 0x5a);
+	arena.Destroy();
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(ARENA_SIZE), 0);
+	SCTEST_CHECK_EQ(arena.Write("/nonexistent/" ARENA_FILE), -1);
+	arena.Destroy();
+	remove(copyFile);
+	return true;
+}
+
+
+bool
+ringArena()
+{
+	Arena		arena;
+	Buffer		buf;
+	const uint8_t	data[] = "0123456789";
+	uint8_t		out[sizeof(data)];
+	const uint32_t	count = 100000;
+	bool		inOrder = true;
+
+	SCTEST_CHECK_EQ(arena.SetRing(0), -1);
+	SCTEST_CHECK_EQ(arena.RingReserve(1), nullptr);
+	SCTEST_CHECK_EQ(arena.RingFree(), 0);
+
+	SCTEST_CHECK_EQ(arena.SetRing(100), 0);
+	SCTEST_CHECK_EQ(arena.Type(), ArenaType::Ring);
+	SCTEST_CHECK_EQ(arena.Size() % static_cast<size_t>(sysconf(_SC_PAGESIZE)), 0);
+	SCTEST_CHECK_EQ(arena.RingFree(), arena.Size());
+	SCTEST_CHECK_EQ(arena.RingReserve(arena.Size() + 1), nullptr);
+	SCTEST_CHECK_EQ(arena.RingPeek(1), nullptr);
+	SCTEST_CHECK_EQ(arena.RingConsume(1), -1);
+
+	// Move the head and tail to just short of the end, so that the
+	// next write wraps around.
+	auto skip = arena.Size() - 4;
+	SCTEST_CHECK_NE(arena.RingReserve(skip), nullptr);
+	SCTEST_CHECK_EQ(arena.RingCommit(skip), 0);
+	SCTEST_CHECK_EQ(arena.RingConsume(skip), 0);
+
+	SCTEST_CHECK_EQ(arena.RingWrite(data, sizeof(data)), 0);
+	SCTEST_CHECK_EQ(arena.RingUsed(), sizeof(data));
+	SCTEST_CHECK_EQ(arena.HighWater(), arena.Size());
+	SCTEST_CHECK_EQ(arena.Start()[0], data[4]);
+
+	// The wrapped data can be read in place, and appended to a Buffer
+	// in one go.
+	auto *head = arena.RingPeek(sizeof(data));
+	SCTEST_CHECK_NE(head, nullptr);
+	SCTEST_CHECK_EQ(memcmp(head, data, sizeof(data)), 0);
+	buf.Append(head, sizeof(data));
+	SCTEST_CHECK_EQ(memcmp(buf.Contents(), data, sizeof(data)), 0);
+
+	SCTEST_CHECK_EQ(arena.RingRead(out, sizeof(out)), 0);
+	SCTEST_CHECK_EQ(memcmp(out, data, sizeof(data)), 0);
+	SCTEST_CHECK_EQ(arena.RingUsed(), 0);
+	SCTEST_CHECK_EQ(arena.RingRead(out, 1), -1);
+
+	arena.Clear();
+	SCTEST_CHECK_EQ(arena.RingFree(), arena.Size());
+
+	// A producer and a consumer can share the ring without locks.
+	std::thread producer([&arena, count]() {
+		for (uint32_t i = 0; i < count; i++) {
+			auto *val = reinterpret_cast<const uint8_t *>(&i);
+			while (arena.RingWrite(val, sizeof(i)) != 0) {
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t	val;
+
+		while (arena.RingRead(reinterpret_cast<uint8_t *>(&val),
+				      sizeof(val)) != 0) {
+			std::this_thread::yield();
+		}
+
+		if (val != i) {
+			inOrder = false;
+		}
+	}
+
+	producer.join();
+	SCTEST_CHECK(inOrder);
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+uninitializedArena()
+{
+	Arena arena;
+
+	SCTEST_CHECK_EQ(arena.Alloc(1, 1), nullptr);
+	return true;
+}
+
+
+std::function<bool()>
+buildTestSuite(ArenaType arenaType)
+{
+	return [arenaType](){
+		return arenaTestSuite(arenaType);
+	};
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	auto noReport = false;
+	auto quiet = false;
+	auto flags = new scsl::Flags("test_arena",
+				     "This test validates the Arena class.");
+	flags->Register("-n", false, "don't print the report");
+	flags->Register("-q", false, "suppress test output");
+
+	auto parsed = flags->Parse(argc, argv);
+	if (parsed != scsl::Flags::ParseStatus::OK) {
+		std::cerr << "Failed to parse flags: "
+			  << scsl::Flags::ParseStatusToString(parsed) << "\n";
+		exit(1);
+	}
+
+	sctest::SimpleSuite suite;
+	flags->GetBool("-n", noReport);
+	flags->GetBool("-q", quiet);
+	if (quiet) {
+		suite.Silence();
+	}
+
+	suite.AddTest("Uninitialized", uninitializedArena);
+	suite.AddTest("ArenaStatic", buildTestSuite(ArenaType::Static));
+	suite.AddTest("ArenaAlloc", buildTestSuite(ArenaType::Alloc));
+	suite.AddTest("ArenaFile", buildTestSuite(ArenaType::MemoryMapped));
+	suite.AddTest("ArenaChunked", chunkedArena);
+	suite.AddTest("ArenaGrowFile", growMappedArena);
+	suite.AddTest("ArenaOptions", arenaOptions);
+	suite.AddTest("ArenaFlush", flushArena);
+	suite.AddTest("ArenaSnapshot", snapshotArena);
+	suite.AddTest("ArenaClear", clearArena);
+	suite.AddTest("ArenaShared", sharedArena);
+	suite.AddTest("ArenaStats", arenaStats);
+	suite.AddTest("ArenaWrite", writeArena);
+	suite.AddTest("ArenaRing", ringArena);
+
+	delete flags;
+	auto result = suite.Run();
+	if (!noReport) { std::cout << suite.GetReport() << "\n"; }
+	return result ? 0 : 1;
+}
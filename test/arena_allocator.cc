@@ -0,0 +1,175 @@
+///
+/// \file test/arena_allocator.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Unit tests for ArenaAllocator with standard containers.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <scsl/Arena.h>
+#include <scsl/ArenaAllocator.h>
+#include <scsl/Flags.h>
+#include <sctest/Checks.h>
+#include <sctest/SimpleSuite.h>
+
+
+using namespace scsl;
+
+
+using ArenaString = std::basic_string<char, std::char_traits<char>,
+				      ArenaAllocator<char>>;
+
+
+static bool
+inArena(Arena &arena, const void *p)
+{
+	auto *base = static_cast<const uint8_t *>(p);
+	return arena.CursorInArena(base);
+}
+
+
+bool
+vectorTest()
+{
+	Arena	arena;
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+
+	ArenaAllocator<int>			alloc(arena);
+	std::vector<int, ArenaAllocator<int>>	vec(alloc);
+
+	for (int i = 0; i < 100; i++) {
+		vec.push_back(i);
+	}
+	SCTEST_CHECK(inArena(arena, vec.data()));
+	SCTEST_CHECK(arena.Used() >= 100 * sizeof(int));
+
+	for (int i = 0; i < 100; i++) {
+		SCTEST_CHECK_EQ(vec[static_cast<size_t>(i)], i);
+	}
+
+	return true;
+}
+
+
+bool
+stringMapTest()
+{
+	Arena	arena;
+
+	SCTEST_CHECK_EQ(arena.SetChunked(256), 0);
+
+	using Pair = std::pair<const ArenaString, ArenaString>;
+	ArenaAllocator<Pair>	alloc(arena);
+	std::map<ArenaString, ArenaString, std::less<ArenaString>,
+		 ArenaAllocator<Pair>> config(alloc);
+
+	for (int i = 0; i < 64; i++) {
+		ArenaString key("a key long enough to need the heap ", alloc);
+		ArenaString val("and a value that is just as long ", alloc);
+		key += std::to_string(i).c_str();
+		val += std::to_string(i * 2).c_str();
+		config.emplace(key, val);
+	}
+	SCTEST_CHECK_EQ(config.size(), 64);
+	SCTEST_CHECK(arena.Reserved() > 256);
+
+	ArenaString key("a key long enough to need the heap 21", alloc);
+	auto it = config.find(key);
+	SCTEST_CHECK(it != config.end());
+	SCTEST_CHECK(it->second == ArenaString("and a value that is just as long 42", alloc));
+
+	return true;
+}
+
+
+bool
+allocatorTest()
+{
+	Arena	arena, other;
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(64), 0);
+	SCTEST_CHECK_EQ(other.SetAlloc(64), 0);
+
+	ArenaAllocator<uint64_t>	alloc(arena);
+	ArenaAllocator<char>		rebound(alloc);
+	ArenaAllocator<char>		elsewhere(other);
+
+	SCTEST_CHECK(alloc == rebound);
+	SCTEST_CHECK(rebound != elsewhere);
+
+	auto *p = alloc.allocate(2);
+	SCTEST_CHECK(inArena(arena, p));
+	SCTEST_CHECK_EQ(reinterpret_cast<uintptr_t>(p) % alignof(uint64_t), 0);
+
+	// Deallocation doesn't return memory to the arena.
+	auto used = arena.Used();
+	alloc.deallocate(p, 2);
+	SCTEST_CHECK_EQ(arena.Used(), used);
+
+	try {
+		alloc.allocate(64);
+	} catch (std::bad_alloc &) {
+		return true;
+	}
+
+	return false;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	auto noReport = false;
+	auto quiet = false;
+	auto flags = new scsl::Flags("test_arena_allocator",
+				     "This test validates the ArenaAllocator class.");
+	flags->Register("-n", false, "don't print the report");
+	flags->Register("-q", false, "suppress test output");
+
+	auto parsed = flags->Parse(argc, argv);
+	if (parsed != scsl::Flags::ParseStatus::OK) {
+		std::cerr << "Failed to parse flags: "
+			  << scsl::Flags::ParseStatusToString(parsed) << "\n";
+		exit(1);
+	}
+
+	sctest::SimpleSuite suite;
+	flags->GetBool("-n", noReport);
+	flags->GetBool("-q", quiet);
+	if (quiet) {
+		suite.Silence();
+	}
+
+	suite.AddTest("allocatorTest", allocatorTest);
+	suite.AddTest("vectorTest", vectorTest);
+	suite.AddTest("stringMapTest", stringMapTest);
+
+	delete flags;
+	auto result = suite.Run();
+	if (!noReport) { std::cout << suite.GetReport() << "\n"; }
+	return result ? 0 : 1;
+}
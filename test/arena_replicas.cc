@@ -0,0 +1,113 @@
+///
+/// \file test/arena_replicas.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Unit tests for the ArenaReplicas class.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#include <cstring>
+#include <iostream>
+
+#include <scsl/Arena.h>
+#include <scsl/ArenaReplicas.h>
+#include <scsl/Dictionary.h>
+#include <scsl/Flags.h>
+#include <sctest/Checks.h>
+#include <sctest/SimpleSuite.h>
+
+#include "test_fixtures.h"
+
+
+using namespace scsl;
+
+
+bool
+replicateDictionary()
+{
+	Arena		arena;
+	ArenaReplicas	replicas;
+	TLV::Record	value;
+
+	SCTEST_CHECK_EQ(replicas.Replicate(arena), -1);
+	SCTEST_CHECK_EQ(replicas.Count(), 0);
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(ARENA_SIZE), 0);
+	Dictionary dict(arena);
+	SCTEST_CHECK_EQ(dict.Set("foo", 3, TEST_STR1, TEST_STRLEN1), 0);
+	SCTEST_CHECK_EQ(dict.Set("bar", 3, TEST_STR2, TEST_STRLEN2), 0);
+
+	SCTEST_CHECK_EQ(replicas.Replicate(arena), 0);
+	SCTEST_CHECK_EQ(replicas.Count(), Arena::NumaNodes());
+
+	for (size_t node = 0; node < replicas.Count(); node++) {
+		auto	&replica = replicas.Replica(node);
+
+		SCTEST_CHECK_EQ(replica.Size(), arena.Size());
+		SCTEST_CHECK_EQ(memcmp(replica.Start(), arena.Start(),
+				       arena.Size()), 0);
+	}
+
+	// Readers use the copy on their own node.
+	Dictionary local(replicas.Local());
+	SCTEST_CHECK(local.Lookup("bar", 3, value));
+	SCTEST_CHECK_EQ(value.Len, TEST_STRLEN2);
+	SCTEST_CHECK_EQ(memcmp(value.Val, TEST_STR2, TEST_STRLEN2), 0);
+
+	// Replicas are independent copies.
+	SCTEST_CHECK(local.Delete("foo", 3));
+	SCTEST_CHECK(dict.Contains("foo", 3));
+
+	replicas.Destroy();
+	SCTEST_CHECK_EQ(replicas.Count(), 0);
+	return true;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	auto noReport = false;
+	auto quiet = false;
+	auto flags = new scsl::Flags("test_arena_replicas",
+				     "This test validates the ArenaReplicas class.");
+	flags->Register("-n", false, "don't print the report");
+	flags->Register("-q", false, "suppress test output");
+
+	auto parsed = flags->Parse(argc, argv);
+	if (parsed != scsl::Flags::ParseStatus::OK) {
+		std::cerr << "Failed to parse flags: "
+			  << scsl::Flags::ParseStatusToString(parsed) << "\n";
+		exit(1);
+	}
+
+	sctest::SimpleSuite suite;
+	flags->GetBool("-n", noReport);
+	flags->GetBool("-q", quiet);
+	if (quiet) {
+		suite.Silence();
+	}
+
+	suite.AddTest("replicateDictionary", replicateDictionary);
+
+	delete flags;
+	auto result = suite.Run();
+	if (!noReport) { std::cout << suite.GetReport() << "\n"; }
+	return result ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+///
+/// \file test/crc32c.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Unit tests for CRC32C.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#include <cstring>
+#include <iostream>
+
+#include <scsl/CRC32C.h>
+#include <scsl/Flags.h>
+#include <sctest/Checks.h>
+#include <sctest/SimpleSuite.h>
+
+
+using namespace scsl;
+
+
+bool
+crc32cVectorTest()
+{
+	uint8_t	buf[32];
+
+	// Test vectors from RFC 3720, appendix B.4.
+	memset(buf, 0, sizeof(buf));
+	SCTEST_CHECK_EQ(CRC32C(buf, sizeof(buf)), 0x8a9136aa);
+	memset(buf, 0xff, sizeof(buf));
+	SCTEST_CHECK_EQ(CRC32C(buf, sizeof(buf)), 0x62a8ab43);
+	for (uint8_t i = 0; i < sizeof(buf); i++) {
+		buf[i] = i;
+	}
+	SCTEST_CHECK_EQ(CRC32C(buf, sizeof(buf)), 0x46dd794e);
+	SCTEST_CHECK_EQ(CRC32CPortable(buf, sizeof(buf)), 0x46dd794e);
+
+	SCTEST_CHECK_EQ(CRC32C("123456789", 9), 0xe3069283);
+	SCTEST_CHECK_EQ(CRC32C(buf, 0), 0);
+	return true;
+}
+
+
+bool
+crc32cPortableTest()
+{
+	uint8_t		buf[1031];
+	uint32_t	state = 1;
+
+	for (auto &b : buf) {
+		state = state * 1103515245 + 12345;
+		b = static_cast<uint8_t>(state >> 16);
+	}
+
+	// Every length and alignment should agree with the portable
+	// version, and checksums should chain across buffers.
+	for (size_t off = 0; off < 8; off++) {
+		for (size_t len = 0; len + off <= sizeof(buf); len += 13) {
+			SCTEST_CHECK_EQ(CRC32C(buf + off, len),
+					CRC32CPortable(buf + off, len));
+		}
+	}
+
+	auto	whole = CRC32C(buf, sizeof(buf));
+	SCTEST_CHECK_EQ(CRC32C(buf + 100, sizeof(buf) - 100, CRC32C(buf, 100)),
+			whole);
+	SCTEST_CHECK_EQ(CRC32CPortable(buf + 3, sizeof(buf) - 3,
+				       CRC32CPortable(buf, 3)), whole);
+
+	std::cout << "hardware CRC32C: " << std::boolalpha << CRC32CHardware()
+		  << "\n";
+	return true;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	auto noReport = false;
+	auto quiet = false;
+	auto flags = new scsl::Flags("test_crc32c",
+				     "This test validates the CRC32C checksum.");
+	flags->Register("-n", false, "don't print the report");
+	flags->Register("-q", false, "suppress test output");
+
+	auto parsed = flags->Parse(argc, argv);
+	if (parsed != scsl::Flags::ParseStatus::OK) {
+		std::cerr << "Failed to parse flags: "
+			  << scsl::Flags::ParseStatusToString(parsed) << "\n";
+		exit(1);
+	}
+
+	sctest::SimpleSuite suite;
+	flags->GetBool("-n", noReport);
+	flags->GetBool("-q", quiet);
+	if (quiet) {
+		suite.Silence();
+	}
+
+	suite.AddTest("crc32cVectorTest", crc32cVectorTest);
+	suite.AddTest("crc32cPortableTest", crc32cPortableTest);
+
+	delete flags;
+	auto result = suite.Run();
+	if (!noReport) { std::cout << suite.GetReport() << "\n"; }
+	return result ? 0 : 1;
+}
@@ -22,6 +22,9 @@
 /// PERFORMANCE OF THIS SOFTWARE.
 ///
 
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdio>
 #include <iostream>
 
 #include <scsl/Arena.h>
@@ -109,6 +112,168 @@ dictionaryTest()
 }
 
 
+bool
+dictionaryGrowthTest()
+{
+	Arena		arena;
+	TLV::Record	value;
+	char		key[8];
+
+	if (arena.Create(ARENA_FILE, ARENA_SIZE) == -1) {
+		abort();
+	}
+
+	Dictionary dict(arena);
+	arena.EnableAutoGrow();
+	for (int i = 0; i < 64; i++) {
+		auto klen = snprintf(key, sizeof(key), "key%d", i);
+		SCTEST_CHECK(testSetKV(dict, key, static_cast<uint8_t>(klen),
+				       TEST_KVSTR6, TEST_KVSTRLEN6));
+	}
+	SCTEST_CHECK(arena.Size() > ARENA_SIZE);
+
+	for (int i = 0; i < 64; i++) {
+		auto klen = snprintf(key, sizeof(key), "key%d", i);
+		SCTEST_CHECK(dict.Lookup(key, static_cast<uint8_t>(klen), value));
+		SCTEST_CHECK_EQ(value.Len, TEST_KVSTRLEN6);
+	}
+
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+dictionaryRewriteTest()
+{
+	Arena		arena;
+	TLV::Record	value;
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(ARENA_SIZE), 0);
+
+	// Rewriting a key deletes the old pair rather than filling the
+	// arena.
+	Dictionary dict(arena);
+	for (int i = 0; i < 256; i++) {
+		SCTEST_CHECK(testSetKV(dict, TEST_KVSTR1, TEST_KVSTRLEN1,
+				       TEST_KVSTR6, TEST_KVSTRLEN6));
+		SCTEST_CHECK(testSetKV(dict, TEST_KVSTR2, TEST_KVSTRLEN2,
+				       TEST_KVSTR5, TEST_KVSTRLEN5));
+	}
+	SCTEST_CHECK_EQ(arena.Size(), ARENA_SIZE);
+	SCTEST_CHECK(dict.Lookup(TEST_KVSTR1, TEST_KVSTRLEN1, value));
+	SCTEST_CHECK_EQ(value.Len, TEST_KVSTRLEN6);
+
+	SCTEST_CHECK(dict.Delete(TEST_KVSTR1, TEST_KVSTRLEN1));
+	SCTEST_CHECK_FALSE(dict.Contains(TEST_KVSTR1, TEST_KVSTRLEN1));
+	SCTEST_CHECK_FALSE(dict.Delete(TEST_KVSTR1, TEST_KVSTRLEN1));
+	SCTEST_CHECK(dict.Lookup(TEST_KVSTR2, TEST_KVSTRLEN2, value));
+	SCTEST_CHECK_EQ(value.Len, TEST_KVSTRLEN5);
+
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+dictionaryChecksumTest()
+{
+	Arena		arena;
+	TLV::Record	value;
+	const size_t	pairSize = 2 * (2 + 2 + TLV::CHECKSUM_SIZE);
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(ARENA_SIZE), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena, TLV::REGION_CHECKSUMS), 0);
+
+	// In a checksummed region, rewriting a key leaves tombstones
+	// behind; they're compacted away, checksums and all, rather than
+	// filling the arena.
+	Dictionary dict(arena);
+	for (int i = 0; i < 256; i++) {
+		SCTEST_CHECK(testSetKV(dict, TEST_KVSTR1, TEST_KVSTRLEN1,
+				       TEST_KVSTR6, TEST_KVSTRLEN6));
+		SCTEST_CHECK(testSetKV(dict, TEST_KVSTR2, TEST_KVSTRLEN2,
+				       TEST_KVSTR5, TEST_KVSTRLEN5));
+	}
+	SCTEST_CHECK_EQ(arena.Size(), ARENA_SIZE);
+	SCTEST_CHECK(dict.Lookup(TEST_KVSTR1, TEST_KVSTRLEN1, value));
+	SCTEST_CHECK_EQ(value.Len, TEST_KVSTRLEN6);
+	SCTEST_CHECK(dict.Delete(TEST_KVSTR1, TEST_KVSTRLEN1));
+	SCTEST_CHECK_FALSE(dict.Contains(TEST_KVSTR1, TEST_KVSTRLEN1));
+	SCTEST_CHECK(TLV::Verify(arena));
+	arena.Destroy();
+
+	// A pair whose checksums don't fit isn't half written.
+	SCTEST_CHECK_EQ(arena.SetAlloc(TLV::REGION_SIZE + pairSize + 14), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena, TLV::REGION_CHECKSUMS), 0);
+	SCTEST_CHECK(testSetKV(dict, "ab", 2, "cd", 2));
+	SCTEST_CHECK_EQ(dict.Set("ef", 2, "gh", 2), -1);
+	SCTEST_CHECK_FALSE(dict.Contains("ef", 2));
+	SCTEST_CHECK(TLV::Verify(arena));
+
+	// Once a pair is deleted, the arena is compacted to make room.
+	SCTEST_CHECK(dict.Delete("ab", 2));
+	SCTEST_CHECK(testSetKV(dict, "ef", 2, "gh", 2));
+	SCTEST_CHECK(dict.Lookup("ef", 2, value));
+	SCTEST_CHECK_EQ(value.Len, 2);
+	SCTEST_CHECK_EQ(memcmp(value.Val, "gh", 2), 0);
+	SCTEST_CHECK(TLV::Verify(arena));
+
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+dictionarySharedTest()
+{
+	Arena		arena;
+	TLV::Record	value;
+	int		status;
+	pid_t		pid;
+
+	SCTEST_CHECK_EQ(arena.CreateShared(nullptr, ARENA_SIZE), 0);
+
+	Dictionary dict(arena);
+	SCTEST_CHECK(testSetKV(dict, TEST_KVSTR1, TEST_KVSTRLEN1, TEST_KVSTR3,
+			       TEST_KVSTRLEN3));
+	SCTEST_CHECK(testSetKV(dict, TEST_KVSTR2, TEST_KVSTRLEN2, TEST_KVSTR6,
+			       TEST_KVSTRLEN6));
+
+	// The child maps the dictionary from the descriptor, as a worker
+	// process would, and reads it without copying.
+	pid = fork();
+	SCTEST_CHECK_NE(pid, -1);
+	if (pid == 0) {
+		Arena		worker;
+		ArenaOptions	options;
+
+		options.ReadOnly = true;
+		if (worker.MapShared(dup(arena.Descriptor()), options) != 0) {
+			_exit(1);
+		}
+
+		Dictionary	workerDict(worker);
+		if (!workerDict.Lookup(TEST_KVSTR2, TEST_KVSTRLEN2, value) ||
+		    (value.Len != TEST_KVSTRLEN6)) {
+			_exit(1);
+		}
+
+		if (workerDict.Contains(TEST_KVSTR3, TEST_KVSTRLEN3)) {
+			_exit(1);
+		}
+		_exit(0);
+	}
+
+	SCTEST_CHECK_EQ(waitpid(pid, &status, 0), pid);
+	SCTEST_CHECK(WIFEXITED(status));
+	SCTEST_CHECK_EQ(WEXITSTATUS(status), 0);
+
+	arena.Destroy();
+	return true;
+}
+
+
 int
 main(int argc, char *argv[])
 {
@@ -134,6 +299,10 @@ main(int argc, char *argv[])
 	}
 
 	suite.AddTest("dictionaryTest", dictionaryTest);
+	suite.AddTest("dictionaryGrowthTest", dictionaryGrowthTest);
+	suite.AddTest("dictionaryRewriteTest", dictionaryRewriteTest);
+	suite.AddTest("dictionaryChecksumTest", dictionaryChecksumTest);
+	suite.AddTest("dictionarySharedTest", dictionarySharedTest);
 
 	delete flags;
 	auto result = suite.Run();
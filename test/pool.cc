@@ -0,0 +1,254 @@
+///
+/// \file test/pool.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Unit tests for the Pool class.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <scmp/geom/Vector.h>
+#include <scsl/Arena.h>
+#include <scsl/Flags.h>
+#include <scsl/Pool.h>
+#include <scsl/TLV.h>
+#include <sctest/Checks.h>
+#include <sctest/SimpleSuite.h>
+
+
+using namespace scsl;
+
+
+static std::atomic<int>	liveObjects(0);
+
+
+struct Tracked {
+	explicit Tracked(int v) : value(v) { liveObjects++; }
+	~Tracked() { liveObjects--; }
+
+	int	value;
+};
+
+
+struct Fussy {
+	explicit Fussy(bool fail)
+	{
+		if (fail) {
+			throw std::runtime_error("constructor failed");
+		}
+	}
+};
+
+
+bool
+poolReuseTest()
+{
+	Arena	arena;
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+
+	Pool<Tracked>	pool(arena, 4);
+	Tracked		*objs[8];
+
+	for (int i = 0; i < 8; i++) {
+		objs[i] = pool.Acquire(i);
+		SCTEST_CHECK_NE(objs[i], nullptr);
+		SCTEST_CHECK(arena.CursorInArena(reinterpret_cast<uint8_t *>(objs[i])));
+		SCTEST_CHECK_EQ(objs[i]->value, i);
+	}
+	SCTEST_CHECK_EQ(liveObjects, 8);
+	SCTEST_CHECK_EQ(pool.InUse(), 8);
+	SCTEST_CHECK_EQ(pool.Slabs(), 2);
+
+	// Objects from one slab are laid out next to each other; each slot
+	// must also be able to hold a free-list pointer.
+	auto stride = std::max(sizeof(Tracked), sizeof(void *));
+	SCTEST_CHECK_EQ(reinterpret_cast<uintptr_t>(objs[1]) -
+			reinterpret_cast<uintptr_t>(objs[0]), stride);
+
+	pool.Release(objs[3]);
+	SCTEST_CHECK_EQ(liveObjects, 7);
+	SCTEST_CHECK_EQ(pool.InUse(), 7);
+
+	// The most recently released slot is reused first, without
+	// allocating a new slab.
+	auto *reused = pool.Acquire(42);
+	SCTEST_CHECK_EQ(reused, objs[3]);
+	SCTEST_CHECK_EQ(reused->value, 42);
+	SCTEST_CHECK_EQ(pool.Slabs(), 2);
+
+	for (auto *obj : objs) {
+		pool.Release(obj);
+	}
+	pool.Release(nullptr);
+	SCTEST_CHECK_EQ(liveObjects, 0);
+	SCTEST_CHECK_EQ(pool.InUse(), 0);
+	return true;
+}
+
+
+bool
+poolExhaustionTest()
+{
+	Arena	arena;
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(4 * (sizeof(TLV::Record) + sizeof(void *))), 0);
+
+	Pool<TLV::Record>	pool(arena, 4);
+	for (int i = 0; i < 4; i++) {
+		SCTEST_CHECK_NE(pool.Acquire(), nullptr);
+	}
+	SCTEST_CHECK_EQ(pool.Acquire(), nullptr);
+	return true;
+}
+
+
+bool
+poolThrowTest()
+{
+	Arena	arena;
+	bool	thrown = false;
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+
+	// A slot whose object failed to construct goes back to the pool.
+	Pool<Fussy>	pool(arena, 2);
+	try {
+		pool.Acquire(true);
+	} catch (std::runtime_error &) {
+		thrown = true;
+	}
+	SCTEST_CHECK(thrown);
+	SCTEST_CHECK_EQ(pool.InUse(), 0);
+
+	auto	*a = pool.Acquire(false);
+	auto	*b = pool.Acquire(false);
+	SCTEST_CHECK_NE(a, nullptr);
+	SCTEST_CHECK_NE(b, nullptr);
+	SCTEST_CHECK_EQ(pool.Slabs(), 1);
+	pool.Release(a);
+	pool.Release(b);
+
+	{
+		Pool<Fussy>::Cache	cache(pool, 2);
+		thrown = false;
+		try {
+			cache.Acquire(true);
+		} catch (std::runtime_error &) {
+			thrown = true;
+		}
+		SCTEST_CHECK(thrown);
+
+		a = cache.Acquire(false);
+		b = cache.Acquire(false);
+		SCTEST_CHECK_NE(a, nullptr);
+		SCTEST_CHECK_NE(b, nullptr);
+		cache.Release(a);
+		cache.Release(b);
+	}
+	SCTEST_CHECK_EQ(pool.InUse(), 0);
+	SCTEST_CHECK_EQ(pool.Slabs(), 1);
+	return true;
+}
+
+
+bool
+poolCacheTest()
+{
+	Arena				arena;
+	std::vector<std::thread>	workers;
+	std::atomic<bool>		ok(true);
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(1024 * 1024), 0);
+
+	Pool<scmp::geom::Vector3D>	pool(arena);
+	for (int t = 0; t < 4; t++) {
+		workers.emplace_back([&pool, &ok]() {
+			Pool<scmp::geom::Vector3D>::Cache	cache(pool, 8);
+			std::vector<scmp::geom::Vector3D *>	held;
+
+			for (int round = 0; round < 100; round++) {
+				for (int i = 0; i < 50; i++) {
+					auto *v = cache.Acquire(
+					    std::initializer_list<double>{1.0, 2.0, 3.0});
+					if (v == nullptr || v->At(1) != 2.0) {
+						ok = false;
+						return;
+					}
+					held.push_back(v);
+				}
+
+				for (auto *v : held) {
+					cache.Release(v);
+				}
+				held.clear();
+			}
+		});
+	}
+
+	for (auto &worker : workers) {
+		worker.join();
+	}
+
+	SCTEST_CHECK(ok);
+	SCTEST_CHECK_EQ(pool.InUse(), 0);
+	return true;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	auto noReport = false;
+	auto quiet = false;
+	auto flags = new scsl::Flags("test_pool",
+				     "This test validates the Pool class.");
+	flags->Register("-n", false, "don't print the report");
+	flags->Register("-q", false, "suppress test output");
+
+	auto parsed = flags->Parse(argc, argv);
+	if (parsed != scsl::Flags::ParseStatus::OK) {
+		std::cerr << "Failed to parse flags: "
+			  << scsl::Flags::ParseStatusToString(parsed) << "\n";
+		exit(1);
+	}
+
+	sctest::SimpleSuite suite;
+	flags->GetBool("-n", noReport);
+	flags->GetBool("-q", quiet);
+	if (quiet) {
+		suite.Silence();
+	}
+
+	suite.AddTest("poolReuseTest", poolReuseTest);
+	suite.AddTest("poolExhaustionTest", poolExhaustionTest);
+	suite.AddTest("poolCacheTest", poolCacheTest);
+	suite.AddTest("poolThrowTest", poolThrowTest);
+
+	delete flags;
+	auto result = suite.Run();
+	if (!noReport) { std::cout << suite.GetReport() << "\n"; }
+	return result ? 0 : 1;
+}
@@ -25,10 +25,15 @@
 /// SOFTWARE.
 ///
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <exception>
 #include <iostream>
+#include <vector>
 
 #include <scsl/Arena.h>
+#include <scsl/Buffer.h>
 #include <scsl/Flags.h>
 #include <scsl/TLV.h>
 #include <sctest/Checks.h>
@@ -128,6 +133,568 @@ tlvTestSuite(ArenaType arenaType)
 	return result;
 }
 
+bool
+tlvGrowTest()
+{
+	Arena		 backend;
+	TLV::Record	 rec, rec2;
+	uint8_t		*cursor = nullptr;
+	size_t		 found = 0;
+
+	if (backend.Create(ARENA_FILE, ARENA_SIZE) != 0) {
+		std::cerr << "[!] failed to set up memory-mapped arena\n";
+		return false;
+	}
+
+	// Without auto-growth, writes fail once the arena fills up.
+	TLV::SetRecord(rec, 1, TEST_STRLEN4, TEST_STR4);
+	for (size_t i = 0; i < 3; i++) {
+		SCTEST_CHECK_NE(TLV::WriteToMemory(backend, nullptr, rec), nullptr);
+	}
+	SCTEST_CHECK_EQ(TLV::WriteToMemory(backend, nullptr, rec), nullptr);
+
+	backend.EnableAutoGrow();
+	for (size_t i = 0; i < 32; i++) {
+		cursor = TLV::WriteToMemory(backend, nullptr, rec);
+		SCTEST_CHECK_NE(cursor, nullptr);
+		SCTEST_CHECK(backend.CursorInArena(cursor));
+	}
+	SCTEST_CHECK(backend.Size() > ARENA_SIZE);
+
+	// Every record written should be found again.
+	rec2.Tag = 1;
+	cursor = TLV::FindTag(backend, nullptr, rec2);
+	while (cursor != nullptr) {
+		SCTEST_CHECK(cmpRecord(rec, rec2));
+		found++;
+		cursor = TLV::FindTag(backend, cursor, rec2);
+	}
+	SCTEST_CHECK_EQ(found, 35);
+
+	backend.Destroy();
+	return true;
+}
+
+
+bool
+tlvReadOnlyTest()
+{
+	Arena		 backend;
+	ArenaOptions	 options;
+	TLV::Record	 rec, rec2;
+	uint8_t		*cursor;
+
+	if (backend.Create(ARENA_FILE, ARENA_SIZE) != 0) {
+		std::cerr << "[!] failed to set up memory-mapped arena\n";
+		return false;
+	}
+
+	TLV::SetRecord(rec, 1, TEST_STRLEN1, TEST_STR1);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(backend, nullptr, rec), nullptr);
+	backend.Destroy();
+
+	options.ReadOnly = true;
+	SCTEST_CHECK_EQ(backend.Open(ARENA_FILE, options), 0);
+	SCTEST_CHECK_EQ(TLV::WriteToMemory(backend, nullptr, rec), nullptr);
+
+	rec2.Tag = 1;
+	cursor = TLV::LocateTag(backend, nullptr, rec2);
+	SCTEST_CHECK_NE(cursor, nullptr);
+	SCTEST_CHECK(cmpRecord(rec, rec2));
+
+	// Deleting from a read-only arena leaves it untouched.
+	TLV::DeleteRecord(backend, cursor);
+	SCTEST_CHECK_EQ(cursor[0], 1);
+
+	backend.Destroy();
+	return true;
+}
+
+
+bool
+tlvRingTest()
+{
+	Arena		ring;
+	TLV::Record	rec;
+	TLV::Record	rec2;
+	size_t		written = 0;
+
+	SCTEST_CHECK_EQ(ring.SetRing(1), 0);
+	TLV::SetRecord(rec, 1, TEST_STRLEN4, TEST_STR4);
+	SCTEST_CHECK_FALSE(TLV::ReadFromRing(ring, rec2));
+
+	// Fill the ring, then drain and refill part of it so that a record
+	// straddles the end of the ring.
+	while (TLV::WriteToRing(ring, rec)) {
+		written++;
+	}
+	SCTEST_CHECK_EQ(written, ring.Size() / (TEST_STRLEN4 + 2));
+
+	for (int i = 0; i < 2; i++) {
+		SCTEST_CHECK(TLV::ReadFromRing(ring, rec2));
+		SCTEST_CHECK(cmpRecord(rec, rec2));
+	}
+
+	TLV::SetRecord(rec, 2, TEST_STRLEN4, TEST_STR4);
+	auto *tail = ring.RingReserve(TEST_STRLEN4 + 2);
+	SCTEST_CHECK_NE(tail, nullptr);
+	SCTEST_CHECK(tail + TEST_STRLEN4 + 2 > ring.End());
+	SCTEST_CHECK(TLV::WriteToRing(ring, rec));
+
+	TLV::SetRecord(rec, 1, TEST_STRLEN4, TEST_STR4);
+	for (size_t i = 2; i < written; i++) {
+		SCTEST_CHECK(TLV::ReadFromRing(ring, rec2));
+		SCTEST_CHECK(cmpRecord(rec, rec2));
+	}
+
+	TLV::SetRecord(rec, 2, TEST_STRLEN4, TEST_STR4);
+	SCTEST_CHECK(TLV::ReadFromRing(ring, rec2));
+	SCTEST_CHECK(cmpRecord(rec, rec2));
+	SCTEST_CHECK_FALSE(TLV::ReadFromRing(ring, rec2));
+	SCTEST_CHECK_EQ(ring.RingUsed(), 0);
+
+	// Rings only take whole records.
+	SCTEST_CHECK_EQ(ring.RingWrite(reinterpret_cast<const uint8_t *>("\x01\x05"), 2), 0);
+	SCTEST_CHECK_FALSE(TLV::ReadFromRing(ring, rec2));
+
+	ring.Destroy();
+	SCTEST_CHECK_FALSE(TLV::WriteToRing(ring, rec));
+	return true;
+}
+
+
+bool
+tlvLongValueTest()
+{
+	Arena		arena;
+	TLV::Record	rec;
+	TLV::Header	hdr;
+	Buffer		val;
+	uint8_t		long1[1000];
+	uint8_t		long2[300];
+	uint8_t		tag;
+
+	for (size_t i = 0; i < sizeof(long1); i++) {
+		long1[i] = static_cast<uint8_t>(i * 7);
+	}
+	memset(long2, 0x5a, sizeof(long2));
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+
+	// Long and short records can sit side by side.
+	TLV::SetRecord(rec, 1, TEST_STRLEN1, TEST_STR1);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	auto *cursor = TLV::WriteValue(arena, nullptr, 2, long1, sizeof(long1));
+	SCTEST_CHECK_NE(cursor, nullptr);
+	SCTEST_CHECK_EQ(cursor - arena.Start(),
+			TEST_STRLEN1 + 2 + sizeof(long1) + 4);
+	SCTEST_CHECK_NE(TLV::WriteValue(arena, nullptr, 2, long2, sizeof(long2)), nullptr);
+	TLV::SetRecord(rec, 3, TEST_STRLEN2, TEST_STR2);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+
+	// Short values use the compact encoding.
+	cursor = TLV::WriteValue(arena, nullptr, 4,
+				 reinterpret_cast<const uint8_t *>(TEST_STR3),
+				 TEST_STRLEN3);
+	SCTEST_CHECK_NE(cursor, nullptr);
+	SCTEST_CHECK_EQ(cursor[-TEST_STRLEN3 - 1], TEST_STRLEN3);
+
+	cursor = TLV::LocateValue(arena, nullptr, 2, hdr);
+	SCTEST_CHECK_NE(cursor, nullptr);
+	SCTEST_CHECK_EQ(hdr.Len, sizeof(long1));
+	SCTEST_CHECK_EQ(hdr.Size, 4);
+	cursor = TLV::ReadValue(arena, cursor, tag, val);
+	SCTEST_CHECK_NE(cursor, nullptr);
+	SCTEST_CHECK_EQ(tag, 2);
+	SCTEST_CHECK_EQ(val.Length(), sizeof(long1));
+	SCTEST_CHECK_EQ(memcmp(val.Contents(), long1, sizeof(long1)), 0);
+
+	cursor = TLV::LocateValue(arena, cursor, 2, hdr);
+	SCTEST_CHECK_NE(cursor, nullptr);
+	SCTEST_CHECK_NE(TLV::ReadValue(arena, cursor, tag, val), nullptr);
+	SCTEST_CHECK_EQ(val.Length(), sizeof(long2));
+	SCTEST_CHECK_EQ(memcmp(val.Contents(), long2, sizeof(long2)), 0);
+
+	// Record-based lookups step over the long records.
+	rec.Tag = 2;
+	SCTEST_CHECK_EQ(TLV::FindTag(arena, nullptr, rec), nullptr);
+	rec.Tag = 3;
+	SCTEST_CHECK_NE(TLV::FindTag(arena, nullptr, rec), nullptr);
+	SCTEST_CHECK_EQ(rec.Len, TEST_STRLEN2);
+
+	TLV::DeleteRecord(arena, TLV::LocateValue(arena, nullptr, 2, hdr));
+	cursor = TLV::LocateValue(arena, nullptr, 2, hdr);
+	SCTEST_CHECK_NE(cursor, nullptr);
+	SCTEST_CHECK_EQ(hdr.Len, sizeof(long2));
+	SCTEST_CHECK_EQ(cursor - arena.Start(), TEST_STRLEN1 + 2);
+	rec.Tag = 3;
+	SCTEST_CHECK_NE(TLV::FindTag(arena, nullptr, rec), nullptr);
+
+	// A length that runs off the end of the arena is rejected.
+	auto *end = TLV::FindEmpty(arena, nullptr);
+	SCTEST_CHECK_NE(end, nullptr);
+	end[0] = 5;
+	end[1] = TLV::TLV_LEN_EXTENDED;
+	end[2] = 0xff;
+	end[3] = 0x7f;
+	SCTEST_CHECK_FALSE(TLV::ReadHeader(arena, end, hdr));
+	SCTEST_CHECK_EQ(TLV::ReadValue(arena, end, tag, val), nullptr);
+
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+tlvViewTest()
+{
+	Arena		arena;
+	TLV::Record	rec;
+	TLV::RecordView	view;
+	uint8_t		longVal[500];
+	size_t		count = 0;
+
+	memset(longVal, 0x11, sizeof(longVal));
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+
+	// An empty arena has no records.
+	auto records = TLV::Records(arena);
+	SCTEST_CHECK(records.begin() == records.end());
+
+	TLV::SetRecord(rec, 1, TEST_STRLEN1, TEST_STR1);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	SCTEST_CHECK_NE(TLV::WriteValue(arena, nullptr, 2, longVal, sizeof(longVal)), nullptr);
+	TLV::SetRecord(rec, 3, TEST_STRLEN4, TEST_STR4);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+
+	// Views point into the arena rather than holding a copy.
+	auto *cursor = TLV::ReadView(arena, arena.Start(), view);
+	SCTEST_CHECK_EQ(cursor, arena.Start() + TEST_STRLEN1 + 2);
+	SCTEST_CHECK_EQ(view.Tag, 1);
+	SCTEST_CHECK_EQ(view.Val, arena.Start() + 2);
+	SCTEST_CHECK(TLV::ViewEquals(view, TEST_STR1, TEST_STRLEN1));
+	SCTEST_CHECK_FALSE(TLV::ViewEquals(view, TEST_STR4, TEST_STRLEN4));
+
+	const uint8_t tags[] = {1, 2, 3};
+	for (auto &rv : TLV::Records(arena)) {
+		SCTEST_CHECK(count < sizeof(tags));
+		SCTEST_CHECK_EQ(rv.Tag, tags[count]);
+		count++;
+	}
+	SCTEST_CHECK_EQ(count, sizeof(tags));
+
+	auto found = std::find_if(records.begin(), records.end(),
+				  [](const TLV::RecordView &rv) {
+					  return rv.Tag == 2;
+				  });
+	SCTEST_CHECK(found != records.end());
+	SCTEST_CHECK_EQ(found->Len, sizeof(longVal));
+	SCTEST_CHECK(TLV::ViewEquals(*found, longVal, sizeof(longVal)));
+
+	// Long values can't be copied into a Record.
+	SCTEST_CHECK_FALSE(TLV::CopyView(*found, rec));
+	SCTEST_CHECK(TLV::CopyView(*++found, rec));
+	SCTEST_CHECK_EQ(rec.Tag, 3);
+	SCTEST_CHECK_EQ(rec.Len, TEST_STRLEN4);
+	SCTEST_CHECK_EQ(memcmp(rec.Val, TEST_STR4, TEST_STRLEN4), 0);
+
+	// Iteration can start part of the way through.
+	TLV::DeleteRecord(arena, found.Cursor());
+	count = 0;
+	for (auto &rv : TLV::Records(arena, arena.Start() + TEST_STRLEN1 + 2)) {
+		SCTEST_CHECK_EQ(rv.Tag, 2);
+		count++;
+	}
+	SCTEST_CHECK_EQ(count, 1);
+
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+tlvRegionTest()
+{
+	Arena		arena;
+	Arena		copy;
+	TLV::Record	rec;
+	TLV::Region	region;
+	static uint8_t	copyBuffer[4096];
+	size_t		count = 0;
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+	SCTEST_CHECK_FALSE(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(TLV::FirstRecord(arena), arena.Start());
+
+	// Existing records are moved down to make room for the header.
+	TLV::SetRecord(rec, 1, TEST_STRLEN1, TEST_STR1);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	TLV::SetRecord(rec, 2, TEST_STRLEN2, TEST_STR2);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena), 0);
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Version, TLV::REGION_VERSION);
+	SCTEST_CHECK_EQ(region.Count, 2);
+	SCTEST_CHECK_EQ(region.Tail,
+			TLV::REGION_SIZE + TEST_STRLEN1 + TEST_STRLEN2 + 4);
+	SCTEST_CHECK_EQ(TLV::FirstRecord(arena), arena.Start() + TLV::REGION_SIZE);
+	SCTEST_CHECK_EQ(TLV::FindEmpty(arena, nullptr), arena.Start() + region.Tail);
+
+	// The header isn't one of the records.
+	for (auto &view : TLV::Records(arena)) {
+		SCTEST_CHECK_NE(view.Tag, TLV::TAG_REGION);
+		count++;
+	}
+	SCTEST_CHECK_EQ(count, 2);
+
+	TLV::SetRecord(rec, 3, TEST_STRLEN3, TEST_STR3);
+	auto *cursor = TLV::WriteToMemory(arena, nullptr, rec);
+	SCTEST_CHECK_NE(cursor, nullptr);
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Count, 3);
+	SCTEST_CHECK_EQ(arena.Start() + region.Tail, cursor);
+
+	rec.Tag = 1;
+	SCTEST_CHECK_NE(TLV::LocateTag(arena, nullptr, rec), nullptr);
+	TLV::DeleteRecord(arena, TLV::LocateTag(arena, nullptr, rec));
+	TLV::DeleteRecord(arena, arena.Start());
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Count, 2);
+	SCTEST_CHECK_EQ(region.Tail,
+			TLV::REGION_SIZE + TEST_STRLEN2 + TEST_STRLEN3 + 4);
+
+	// A tail that doesn't mark the end of the records is rebuilt.
+	arena.Start()[10] = TLV::REGION_SIZE;
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Count, 2);
+	SCTEST_CHECK_EQ(region.Tail,
+			TLV::REGION_SIZE + TEST_STRLEN2 + TEST_STRLEN3 + 4);
+
+	// The header travels with the arena's contents.
+	memcpy(copyBuffer, arena.Start(), arena.Size());
+	SCTEST_CHECK_EQ(copy.SetStatic(copyBuffer, sizeof(copyBuffer)), 0);
+	SCTEST_CHECK(TLV::ReadRegion(copy, region));
+	SCTEST_CHECK_EQ(region.Count, 2);
+	copy.Clear();
+	SCTEST_CHECK_FALSE(TLV::ReadRegion(copy, region));
+
+	// Appends fill the arena exactly and then need room to grow.
+	arena.Destroy();
+	SCTEST_CHECK_EQ(arena.SetAlloc(TLV::REGION_SIZE + TEST_STRLEN1 + 2), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena), 0);
+	TLV::SetRecord(rec, 1, TEST_STRLEN1, TEST_STR1);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	SCTEST_CHECK_EQ(TLV::FindEmpty(arena, nullptr), nullptr);
+	SCTEST_CHECK_EQ(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+tlvTombstoneTest()
+{
+	Arena		arena;
+	TLV::Record	rec;
+	TLV::Region	region;
+	uint8_t		*cursors[4];
+	size_t		count = 0;
+	const size_t	recSize = TEST_STRLEN1 + 2;
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena), 0);
+
+	for (uint8_t i = 0; i < 4; i++) {
+		TLV::SetRecord(rec, i + 1, TEST_STRLEN1, TEST_STR1);
+		cursors[i] = TLV::WriteToMemory(arena, nullptr, rec) - recSize;
+	}
+	auto *base = TLV::FirstRecord(arena);
+	SCTEST_CHECK_FALSE(TLV::NeedsCompact(arena));
+
+	// Tombstones stay in place and are skipped by lookups.
+	TLV::TombstoneRecord(arena, cursors[1]);
+	TLV::TombstoneRecord(arena, cursors[2]);
+	TLV::TombstoneRecord(arena, cursors[2]);
+	SCTEST_CHECK_EQ(cursors[1][0], TLV::TAG_TOMBSTONE);
+	SCTEST_CHECK_EQ(cursors[3][0], 4);
+	rec.Tag = 2;
+	SCTEST_CHECK_EQ(TLV::LocateTag(arena, nullptr, rec), nullptr);
+	rec.Tag = 4;
+	SCTEST_CHECK_EQ(TLV::LocateTag(arena, nullptr, rec), cursors[3]);
+
+	for (auto &view : TLV::Records(arena)) {
+		SCTEST_CHECK_NE(view.Tag, TLV::TAG_TOMBSTONE);
+		count++;
+	}
+	SCTEST_CHECK_EQ(count, 2);
+	SCTEST_CHECK(TLV::NeedsCompact(arena));
+	SCTEST_CHECK_FALSE(TLV::NeedsCompact(arena, 0.75));
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Count, 2);
+	SCTEST_CHECK_EQ(region.Dead, 2 * recSize);
+
+	// The tombstone tag is reserved once there's a region header.
+	SCTEST_CHECK(TLV::IsReserved(arena, TLV::TAG_TOMBSTONE));
+	SCTEST_CHECK_FALSE(TLV::IsReserved(arena, TLV::TAG_CHECKSUM));
+	TLV::SetRecord(rec, TLV::TAG_TOMBSTONE, TEST_STRLEN1, TEST_STR1);
+	SCTEST_CHECK_EQ(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	SCTEST_CHECK_EQ(TLV::WriteBatch(arena, &rec, 1), nullptr);
+
+	// Appending after a tombstone still goes at the end.
+	TLV::SetRecord(rec, 5, TEST_STRLEN1, TEST_STR1);
+	SCTEST_CHECK_EQ(TLV::WriteToMemory(arena, nullptr, rec),
+			base + 5 * recSize);
+	TLV::TombstoneRecord(arena, base + 4 * recSize);
+
+	SCTEST_CHECK_EQ(TLV::Compact(arena), 3 * recSize);
+	SCTEST_CHECK_EQ(TLV::Compact(arena), 0);
+	SCTEST_CHECK_FALSE(TLV::NeedsCompact(arena));
+	SCTEST_CHECK_EQ(base[0], 1);
+	SCTEST_CHECK_EQ(base[recSize], 4);
+	SCTEST_CHECK_EQ(memcmp(base + recSize + 2, TEST_STR1, TEST_STRLEN1), 0);
+	SCTEST_CHECK_EQ(TLV::FindEmpty(arena, nullptr), base + 2 * recSize);
+	for (size_t i = 2 * recSize; i < 6 * recSize; i++) {
+		SCTEST_CHECK_EQ(base[i], 0);
+	}
+
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Count, 2);
+	SCTEST_CHECK_EQ(region.Dead, 0);
+	SCTEST_CHECK_EQ(region.Tail, TLV::REGION_SIZE + 2 * recSize);
+
+	// DeleteRecord only moves the records that follow.
+	TLV::DeleteRecord(arena, base);
+	SCTEST_CHECK_EQ(base[0], 4);
+	SCTEST_CHECK_EQ(TLV::FindEmpty(arena, nullptr), base + recSize);
+	arena.Destroy();
+
+	// Without a region header, the bookkeeping tags are ordinary
+	// tags, and TombstoneRecord deletes records outright.
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+	const uint8_t tags[4] = {1, TLV::TAG_TOMBSTONE, TLV::TAG_CHECKSUM,
+				 TLV::TAG_SYNC};
+	for (auto tag : tags) {
+		SCTEST_CHECK_FALSE(TLV::IsReserved(arena, tag));
+		TLV::SetRecord(rec, tag, TEST_STRLEN1, TEST_STR1);
+		SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	}
+
+	TLV::TombstoneRecord(arena, arena.Start());
+	SCTEST_CHECK_EQ(arena.Start()[0], TLV::TAG_TOMBSTONE);
+	SCTEST_CHECK_FALSE(TLV::NeedsCompact(arena));
+	SCTEST_CHECK_EQ(TLV::Compact(arena), 0);
+	SCTEST_CHECK(TLV::Verify(arena));
+
+	count = 0;
+	for (auto &view : TLV::Records(arena)) {
+		SCTEST_CHECK_EQ(view.Tag, tags[++count]);
+	}
+	SCTEST_CHECK_EQ(count, 3);
+
+	// Nor can a region be added that would hide them.
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena), -1);
+	SCTEST_CHECK_FALSE(TLV::ReadRegion(arena, region));
+
+	arena.Destroy();
+	return true;
+}
+
+
+bool
+tlvChecksumTest()
+{
+	Arena		arena;
+	TLV::Record	rec;
+	TLV::Region	region;
+	TLV::Header	hdr;
+	uint8_t		longVal[300];
+	size_t		count = 0;
+	const size_t	recSize = TEST_STRLEN1 + 2 + TLV::CHECKSUM_SIZE;
+
+	memset(longVal, 0x42, sizeof(longVal));
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+	SCTEST_CHECK(TLV::Verify(arena));
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena, TLV::REGION_CHECKSUMS), 0);
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Flags, TLV::REGION_CHECKSUMS);
+
+	// Each record is followed by its checksum.
+	TLV::SetRecord(rec, 1, TEST_STRLEN1, TEST_STR1);
+	auto *cursor = TLV::WriteToMemory(arena, nullptr, rec);
+	SCTEST_CHECK_EQ(cursor, TLV::FirstRecord(arena) + recSize);
+	SCTEST_CHECK_EQ(cursor[-TLV::CHECKSUM_SIZE], TLV::TAG_CHECKSUM);
+	SCTEST_CHECK_NE(TLV::WriteValue(arena, nullptr, 2, longVal, sizeof(longVal)), nullptr);
+	TLV::SetRecord(rec, 3, TEST_STRLEN2, TEST_STR2);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	SCTEST_CHECK(TLV::Verify(arena));
+
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Count, 3);
+	for (auto &view : TLV::Records(arena)) {
+		SCTEST_CHECK_NE(view.Tag, TLV::TAG_CHECKSUM);
+		count++;
+	}
+	SCTEST_CHECK_EQ(count, 3);
+
+	// A flipped bit is caught.
+	auto *val = TLV::LocateValue(arena, nullptr, 2, hdr);
+	SCTEST_CHECK_NE(val, nullptr);
+	val[100] ^= 0x10;
+	SCTEST_CHECK_FALSE(TLV::Verify(arena));
+	val[100] ^= 0x10;
+	SCTEST_CHECK(TLV::Verify(arena));
+
+	// Deleting a record removes its checksum with it.
+	TLV::TombstoneRecord(arena, TLV::FirstRecord(arena));
+	SCTEST_CHECK(TLV::Verify(arena));
+	SCTEST_CHECK_EQ(TLV::Compact(arena), recSize);
+	SCTEST_CHECK(TLV::Verify(arena));
+	TLV::DeleteRecord(arena, TLV::FirstRecord(arena));
+	SCTEST_CHECK(TLV::Verify(arena));
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Count, 1);
+	SCTEST_CHECK_EQ(region.Tail, TLV::REGION_SIZE + recSize);
+
+	// So is a record whose write was torn before the header was
+	// updated...
+	cursor = TLV::FindEmpty(arena, nullptr);
+	cursor[0] = 4;
+	cursor[1] = 2;
+	SCTEST_CHECK_FALSE(TLV::Verify(arena));
+	cursor[0] = cursor[1] = 0;
+	SCTEST_CHECK(TLV::Verify(arena));
+
+	// ... and a length that runs off the end of the arena.
+	TLV::FirstRecord(arena)[1] = TLV::TLV_LEN_EXTENDED;
+	SCTEST_CHECK_FALSE(TLV::Verify(arena));
+	arena.Destroy();
+	SCTEST_CHECK_FALSE(TLV::Verify(arena));
+
+	// Without REGION_CHECKSUMS, a record that happens to use the
+	// checksum tag isn't deleted with the record in front of it.
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+	TLV::SetRecord(rec, 1, 3, "abc");
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	TLV::SetRecord(rec, TLV::TAG_CHECKSUM, 4, "user");
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	TLV::SetRecord(rec, 2, 3, "xyz");
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	TLV::DeleteRecord(arena, arena.Start());
+	SCTEST_CHECK_EQ(arena.Start()[0], TLV::TAG_CHECKSUM);
+	SCTEST_CHECK_EQ(arena.Start()[6], 2);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena, TLV::REGION_CHECKSUMS), -1);
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Flags, 0);
+	SCTEST_CHECK_EQ(region.Count, 2);
+
+	arena.Destroy();
+	return true;
+}
+
+
 std::function<bool()>
 buildTestSuite(ArenaType arenaType)
 {
@@ -137,6 +704,309 @@ buildTestSuite(ArenaType arenaType)
 }
 
 
+bool
+tlvBatchTest()
+{
+	Arena			arena;
+	TLV::Record		recs[8];
+	TLV::Region		region;
+	TLV::Header		hdr;
+	uint8_t			buffer[64];
+	std::vector<uint8_t>	longVal(600, 0x5a);
+	size_t			count = 0;
+	const size_t		recSize = TEST_STRLEN1 + 2;
+
+	for (uint8_t i = 0; i < 8; i++) {
+		TLV::SetRecord(recs[i], i + 1, TEST_STRLEN1, TEST_STR1);
+	}
+
+	// A batch lands after the records already in the arena.
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena, TLV::REGION_CHECKSUMS), 0);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, recs[0]), nullptr);
+	auto *end = TLV::WriteBatch(arena, recs, 8);
+	SCTEST_CHECK_EQ(end, TLV::FindEmpty(arena, nullptr));
+	for (auto &view : TLV::Records(arena)) {
+		SCTEST_CHECK_EQ(view.Tag, count == 0 ? 1 : count);
+		SCTEST_CHECK(TLV::ViewEquals(view, TEST_STR1, TEST_STRLEN1));
+		count++;
+	}
+	SCTEST_CHECK_EQ(count, 9);
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Count, 9);
+	SCTEST_CHECK_EQ(region.Tail, TLV::REGION_SIZE +
+			9 * (recSize + TLV::CHECKSUM_SIZE));
+	SCTEST_CHECK(TLV::Verify(arena));
+
+	// Views can hold long values.
+	TLV::RecordView	views[2] = {
+		{9, longVal.size(), longVal.data()},
+		{10, TEST_STRLEN2, reinterpret_cast<const uint8_t *>(TEST_STR2)},
+	};
+	SCTEST_CHECK_NE(TLV::WriteBatch(arena, views, 2), nullptr);
+	auto *cursor = TLV::LocateValue(arena, nullptr, 9, hdr);
+	SCTEST_CHECK_NE(cursor, nullptr);
+	SCTEST_CHECK_EQ(hdr.Len, longVal.size());
+	SCTEST_CHECK_NE(TLV::LocateValue(arena, cursor, 10, hdr), nullptr);
+	SCTEST_CHECK(TLV::Verify(arena));
+	arena.Destroy();
+
+	// A batch that doesn't fit isn't written at all.
+	memset(buffer, 0, sizeof(buffer));
+	SCTEST_CHECK_EQ(arena.SetStatic(buffer, sizeof(buffer)), 0);
+	SCTEST_CHECK_NE(TLV::WriteBatch(arena, recs, 2), nullptr);
+	auto *tail = TLV::FindEmpty(arena, nullptr);
+	SCTEST_CHECK_EQ(tail, buffer + 2 * recSize);
+	SCTEST_CHECK_EQ(TLV::WriteBatch(arena, recs, 8), nullptr);
+	SCTEST_CHECK_EQ(TLV::FindEmpty(arena, nullptr), tail);
+	for (auto *p = tail; p < buffer + sizeof(buffer); p++) {
+		SCTEST_CHECK_EQ(*p, 0);
+	}
+	arena.Destroy();
+
+	return true;
+}
+
+
+bool
+tlvSyncTest()
+{
+	Arena			arena;
+	TLV::Record		rec;
+	TLV::Record		batch[64];
+	TLV::Header		hdr;
+	std::atomic<size_t>	visited(0);
+	std::atomic<size_t>	tags(0);
+	size_t			records = 0;
+	size_t			tagSum = 0;
+	size_t			markers = 0;
+
+	// Enough records to cross a few sync intervals.
+	SCTEST_CHECK_EQ(arena.SetAlloc(4 * TLV::SYNC_INTERVAL), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena, TLV::REGION_SYNC |
+					      TLV::REGION_CHECKSUMS), 0);
+	memset(rec.Val, 0x42, TLV::TLV_MAX_LEN);
+	while (TLV::FindEmpty(arena, nullptr) - arena.Start() <
+	       static_cast<ptrdiff_t>(3 * TLV::SYNC_INTERVAL)) {
+		rec.Tag = static_cast<uint8_t>(records % 200 + 1);
+		rec.Len = TLV::TLV_MAX_LEN;
+		SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+		tagSum += rec.Tag;
+		records++;
+	}
+	for (auto &r : batch) {
+		TLV::SetRecord(r, 7, TEST_STRLEN1, TEST_STR1);
+		tagSum += 7;
+		records++;
+	}
+	SCTEST_CHECK_NE(TLV::WriteBatch(arena, batch, 64), nullptr);
+	SCTEST_CHECK(TLV::Verify(arena));
+
+	// Each marker holds its own offset, and is skipped by readers.
+	auto	*cursor = TLV::FirstRecord(arena);
+	while (TLV::ReadHeader(arena, cursor, hdr) && (hdr.Tag != TLV::TAG_EMPTY)) {
+		if (hdr.Tag == TLV::TAG_SYNC) {
+			SCTEST_CHECK_EQ(hdr.Len, TLV::SYNC_SIZE - 2);
+			SCTEST_CHECK_EQ(cursor[6] | (cursor[7] << 8) | (cursor[8] << 16),
+					cursor - arena.Start());
+			markers++;
+		}
+		cursor += hdr.Size + hdr.Len;
+	}
+	SCTEST_CHECK_EQ(markers, 3);
+	SCTEST_CHECK_EQ(std::distance(TLV::Records(arena).begin(),
+				      TLV::Records(arena).end()),
+			static_cast<ptrdiff_t>(records));
+
+	auto	visit = [&](const TLV::RecordView &view, size_t) {
+		visited++;
+		tags += view.Tag;
+		return true;
+	};
+	for (size_t threads : {1, 4}) {
+		visited = 0;
+		tags = 0;
+		SCTEST_CHECK(TLV::ParallelScan(arena, visit, threads));
+		SCTEST_CHECK_EQ(visited.load(), records);
+		SCTEST_CHECK_EQ(tags.load(), tagSum);
+	}
+
+	// The visitor can stop the scan.
+	SCTEST_CHECK_FALSE(TLV::ParallelScan(arena,
+	    [](const TLV::RecordView &, size_t) { return false; }, 4));
+
+	// Compacting moves the markers, and keeps them usable.
+	cursor = TLV::FirstRecord(arena);
+	tagSum -= cursor[0];
+	records--;
+	TLV::TombstoneRecord(arena, cursor);
+	SCTEST_CHECK_NE(TLV::Compact(arena), 0);
+	SCTEST_CHECK(TLV::Verify(arena));
+	visited = 0;
+	tags = 0;
+	SCTEST_CHECK(TLV::ParallelScan(arena, visit, 4));
+	SCTEST_CHECK_EQ(visited.load(), records);
+	SCTEST_CHECK_EQ(tags.load(), tagSum);
+
+	// A damaged record fails its checksum.
+	auto	it = TLV::Records(arena).begin();
+	while (it.Cursor() - arena.Start() <
+	       static_cast<ptrdiff_t>(2 * TLV::SYNC_INTERVAL)) {
+		++it;
+	}
+	auto	*val = const_cast<uint8_t *>(it->Val);
+	val[0] ^= 0x01;
+	SCTEST_CHECK_FALSE(TLV::ParallelScan(arena, visit, 4));
+	val[0] ^= 0x01;
+	arena.Destroy();
+
+	// Without sync markers, the records are scanned in order.
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+	TLV::SetRecord(rec, 1, TEST_STRLEN1, TEST_STR1);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	visited = 0;
+	tags = 0;
+	SCTEST_CHECK(TLV::ParallelScan(arena, visit));
+	SCTEST_CHECK_EQ(visited.load(), 2);
+	arena.Destroy();
+
+	return true;
+}
+
+
+bool
+tlvContainerTest()
+{
+	Arena		arena;
+	Arena		radio;
+	Arena		antenna;
+	Arena		empty;
+	TLV::Record	rec;
+	TLV::Region	region;
+	TLV::RecordView	view;
+	TLV::Scope	scope;
+	size_t		count = 0;
+
+	// antenna is nested in radio, which is nested in arena.
+	SCTEST_CHECK_EQ(antenna.SetAlloc(256), 0);
+	TLV::SetRecord(rec, 3, TEST_STRLEN3, TEST_STR3);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(antenna, nullptr, rec), nullptr);
+
+	SCTEST_CHECK_EQ(radio.SetAlloc(256), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(radio), 0);
+	TLV::SetRecord(rec, 1, TEST_STRLEN2, TEST_STR2);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(radio, nullptr, rec), nullptr);
+	SCTEST_CHECK_NE(TLV::WriteContainer(radio, nullptr, 12, antenna), nullptr);
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena, TLV::REGION_CHECKSUMS), 0);
+	TLV::SetRecord(rec, 5, TEST_STRLEN4, TEST_STR4);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	SCTEST_CHECK_NE(TLV::WriteContainer(arena, nullptr, 10, radio), nullptr);
+	SCTEST_CHECK_NE(TLV::WriteContainer(arena, nullptr, 11, empty), nullptr);
+	TLV::SetRecord(rec, 1, TEST_STRLEN1, TEST_STR1);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	SCTEST_CHECK(TLV::Verify(arena));
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Count, 4);
+
+	// Top-level lookups skip over the containers.
+	auto	top = TLV::ArenaScope(arena);
+	auto	*cursor = TLV::LocateIn(arena, top, nullptr, 1, view);
+	SCTEST_CHECK_NE(cursor, nullptr);
+	SCTEST_CHECK(TLV::ViewEquals(view, TEST_STR1, TEST_STRLEN1));
+	SCTEST_CHECK_EQ(TLV::LocateIn(arena, top, nullptr, 3, view), nullptr);
+
+	// Scoped lookups only see the container's records.
+	cursor = TLV::LocateIn(arena, top, nullptr, 10, view);
+	SCTEST_CHECK(TLV::EnterContainer(arena, cursor, scope));
+	for (auto &child : TLV::Records(arena, scope)) {
+		SCTEST_CHECK(child.Tag == 1 || child.Tag == 12);
+		count++;
+	}
+	SCTEST_CHECK_EQ(count, 2);
+	SCTEST_CHECK_NE(TLV::LocateIn(arena, scope, nullptr, 1, view), nullptr);
+	SCTEST_CHECK(TLV::ViewEquals(view, TEST_STR2, TEST_STRLEN2));
+	SCTEST_CHECK_EQ(TLV::LocateIn(arena, scope, nullptr, 5, view), nullptr);
+
+	const uint8_t	deep[] = {10, 12, 3};
+	SCTEST_CHECK_NE(TLV::LocatePath(arena, deep, 3, view), nullptr);
+	SCTEST_CHECK(TLV::ViewEquals(view, TEST_STR3, TEST_STRLEN3));
+	const uint8_t	missing[] = {10, 3};
+	SCTEST_CHECK_EQ(TLV::LocatePath(arena, missing, 2, view), nullptr);
+
+	// Nested records are read-only, since changing one would leave the
+	// containers around it with the wrong length.
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Flags,
+			TLV::REGION_CHECKSUMS | TLV::REGION_CONTAINERS);
+	cursor = TLV::LocatePath(arena, deep, 3, view);
+	TLV::DeleteRecord(arena, cursor);
+	TLV::TombstoneRecord(arena, cursor);
+	TLV::SetRecord(rec, 4, TEST_STRLEN3, TEST_STR3);
+	SCTEST_CHECK_EQ(TLV::WriteToMemory(arena, cursor, rec), nullptr);
+	SCTEST_CHECK_EQ(TLV::LocatePath(arena, deep, 3, view), cursor);
+	SCTEST_CHECK(TLV::ViewEquals(view, TEST_STR3, TEST_STRLEN3));
+	SCTEST_CHECK(TLV::ReadRegion(arena, region));
+	SCTEST_CHECK_EQ(region.Count, 4);
+	SCTEST_CHECK(TLV::Verify(arena));
+
+	// An empty container has an empty scope, and a record that isn't a
+	// container doesn't hold any records that fit.
+	cursor = TLV::LocateIn(arena, top, nullptr, 11, view);
+	SCTEST_CHECK(TLV::EnterContainer(arena, cursor, scope));
+	SCTEST_CHECK_EQ(scope.Start, scope.End);
+	SCTEST_CHECK(TLV::Records(arena, scope).begin() ==
+		     TLV::Records(arena, scope).end());
+	const uint8_t	leaf[] = {5, 1};
+	SCTEST_CHECK_EQ(TLV::LocatePath(arena, leaf, 2, view), nullptr);
+
+	// Only a checksummed child's records are nested, not its checksums
+	// or tombstones.
+	radio.Destroy();
+	SCTEST_CHECK_EQ(radio.SetAlloc(256), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(radio, TLV::REGION_CHECKSUMS), 0);
+	for (uint8_t tag = 1; tag <= 2; tag++) {
+		TLV::SetRecord(rec, tag, TEST_STRLEN1, TEST_STR1);
+		SCTEST_CHECK_NE(TLV::WriteToMemory(radio, nullptr, rec), nullptr);
+	}
+	TLV::TombstoneRecord(radio, TLV::FirstRecord(radio));
+	antenna.Destroy();
+	SCTEST_CHECK_EQ(antenna.SetAlloc(256), 0);
+	SCTEST_CHECK_NE(TLV::WriteContainer(antenna, nullptr, 9, radio), nullptr);
+	SCTEST_CHECK(TLV::EnterContainer(antenna, antenna.Start(), scope));
+	SCTEST_CHECK_EQ(scope.End - scope.Start, TEST_STRLEN1 + 2);
+	count = 0;
+	for (auto &child : TLV::Records(antenna, scope)) {
+		SCTEST_CHECK_EQ(child.Tag, 2);
+		count++;
+	}
+	SCTEST_CHECK_EQ(count, 1);
+
+	// Without a region header, every cursor is checked.
+	TLV::SetRecord(rec, 3, 2, "ok");
+	SCTEST_CHECK_NE(TLV::WriteToMemory(antenna, nullptr, rec), nullptr);
+	TLV::DeleteRecord(antenna, scope.Start);
+	SCTEST_CHECK_EQ(TLV::LocateIn(antenna, scope, nullptr, 2, view),
+			scope.Start);
+	SCTEST_CHECK_EQ(scope.End[0], 3);
+	TLV::DeleteRecord(antenna, scope.End);
+	SCTEST_CHECK_EQ(scope.End[0], 0);
+
+	// A child record using a tag the arena reserves can't be nested.
+	TLV::SetRecord(rec, TLV::TAG_CHECKSUM, TEST_STRLEN1, TEST_STR1);
+	SCTEST_CHECK_NE(TLV::WriteToMemory(antenna, nullptr, rec), nullptr);
+	SCTEST_CHECK_EQ(TLV::WriteContainer(arena, nullptr, 9, antenna), nullptr);
+	SCTEST_CHECK(TLV::Verify(arena));
+
+	antenna.Destroy();
+	radio.Destroy();
+	arena.Destroy();
+	return true;
+}
+
+
 int
 main(int argc, char *argv[])
 {
@@ -164,6 +1034,17 @@ main(int argc, char *argv[])
 	suite.AddTest("ArenaStatic", buildTestSuite(ArenaType::Static));
 	suite.AddTest("ArenaAlloc", buildTestSuite(ArenaType::Alloc));
 	suite.AddTest("ArenaFile", buildTestSuite(ArenaType::MemoryMapped));
+	suite.AddTest("ArenaFileGrowth", tlvGrowTest);
+	suite.AddTest("ArenaReadOnly", tlvReadOnlyTest);
+	suite.AddTest("ArenaRing", tlvRingTest);
+	suite.AddTest("LongValues", tlvLongValueTest);
+	suite.AddTest("RecordViews", tlvViewTest);
+	suite.AddTest("Region", tlvRegionTest);
+	suite.AddTest("Tombstones", tlvTombstoneTest);
+	suite.AddTest("Checksums", tlvChecksumTest);
+	suite.AddTest("Batches", tlvBatchTest);
+	suite.AddTest("SyncMarkers", tlvSyncTest);
+	suite.AddTest("Containers", tlvContainerTest);
 
 	delete flags;
 	auto result = suite.Run();
@@ -0,0 +1,199 @@
+///
+/// \file test/tlv_schema.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Unit tests for TLV schemas.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include <scsl/Arena.h>
+#include <scsl/Flags.h>
+#include <scsl/TLV.h>
+#include <scsl/TLVSchema.h>
+#include <sctest/Checks.h>
+#include <sctest/SimpleSuite.h>
+
+
+using namespace scsl;
+
+
+enum class Kind : uint8_t {
+	Station = 1,
+	Relay = 2,
+};
+
+
+struct Contact {
+	uint32_t	ID;
+	int16_t		Offset;
+	Kind		Type;
+	bool		Active;
+	float		Gain;
+	double		Frequency;
+	std::string	Callsign;
+};
+
+
+static constexpr auto contactSchema = TLV::MakeSchema(
+	TLV::MakeField(1, &Contact::ID),
+	TLV::MakeField(2, &Contact::Offset),
+	TLV::MakeField(3, &Contact::Type),
+	TLV::MakeField(4, &Contact::Active),
+	TLV::MakeField(5, &Contact::Gain),
+	TLV::MakeField(6, &Contact::Frequency),
+	TLV::MakeField(7, &Contact::Callsign));
+
+
+static bool
+contactsEqual(const Contact &a, const Contact &b)
+{
+	return (a.ID == b.ID) && (a.Offset == b.Offset) && (a.Type == b.Type) &&
+	       (a.Active == b.Active) && (a.Gain == b.Gain) &&
+	       (a.Frequency == b.Frequency) && (a.Callsign == b.Callsign);
+}
+
+
+bool
+schemaRoundTripTest()
+{
+	Arena		arena;
+	Contact		out;
+	const Contact	contacts[] = {
+		{1, -600, Kind::Station, true, 0.5f, 146.52, "KI6SCS"},
+		{std::numeric_limits<uint32_t>::max(),
+		 std::numeric_limits<int16_t>::min(), Kind::Relay, false, -1.0f,
+		 444.0, std::string(400, 'x')},
+	};
+
+	static_assert(decltype(contactSchema)::Fields == 7,
+		      "the schema should have seven fields");
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena, TLV::REGION_CHECKSUMS), 0);
+	for (auto &contact : contacts) {
+		SCTEST_CHECK_NE(contactSchema.Write(arena, contact), nullptr);
+	}
+	SCTEST_CHECK(TLV::Verify(arena));
+
+	// Each field is an ordinary record, so it can be found by its tag.
+	TLV::Header	hdr;
+	auto		*cursor = TLV::LocateValue(arena, nullptr, 7, hdr);
+	SCTEST_CHECK_NE(cursor, nullptr);
+	SCTEST_CHECK_EQ(hdr.Len, 6);
+	SCTEST_CHECK_EQ(memcmp(cursor + hdr.Size, "KI6SCS", 6), 0);
+
+	// Structs are read back one after another.
+	cursor = nullptr;
+	for (auto &contact : contacts) {
+		cursor = contactSchema.Read(arena, cursor, out);
+		SCTEST_CHECK_NE(cursor, nullptr);
+		SCTEST_CHECK(contactsEqual(out, contact));
+	}
+	SCTEST_CHECK_EQ(contactSchema.Read(arena, cursor, out), nullptr);
+
+	arena.Destroy();
+	return true;
+}
+
+
+struct Narrow {
+	uint8_t		ID;
+	int16_t		Offset;
+};
+
+
+static constexpr auto narrowSchema = TLV::MakeSchema(
+	TLV::MakeField(1, &Narrow::ID),
+	TLV::MakeField(2, &Narrow::Offset));
+
+
+bool
+schemaMismatchTest()
+{
+	Arena		arena;
+	Narrow		narrow;
+	Contact		contact = {300, -600, Kind::Station, true, 0.5f, 146.52,
+				   "KI6SCS"};
+	uint8_t		buffer[16];
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+	SCTEST_CHECK_NE(contactSchema.Write(arena, contact), nullptr);
+
+	// The tags match, but 300 doesn't fit in a uint8_t.
+	SCTEST_CHECK_EQ(narrowSchema.Read(arena, nullptr, narrow), nullptr);
+
+	// A field that's missing or out of order doesn't match.
+	contact.ID = 3;
+	arena.Clear();
+	SCTEST_CHECK_NE(contactSchema.Write(arena, contact), nullptr);
+	SCTEST_CHECK_NE(narrowSchema.Read(arena, nullptr, narrow), nullptr);
+	SCTEST_CHECK_EQ(narrow.ID, 3);
+	SCTEST_CHECK_EQ(narrow.Offset, -600);
+	TLV::DeleteRecord(arena, TLV::FirstRecord(arena));
+	SCTEST_CHECK_EQ(narrowSchema.Read(arena, nullptr, narrow), nullptr);
+	arena.Destroy();
+
+	// A struct that doesn't fit isn't written at all.
+	memset(buffer, 0, sizeof(buffer));
+	SCTEST_CHECK_EQ(arena.SetStatic(buffer, sizeof(buffer)), 0);
+	SCTEST_CHECK_EQ(contactSchema.Write(arena, contact), nullptr);
+	SCTEST_CHECK_EQ(buffer[0], TLV::TAG_EMPTY);
+	arena.Destroy();
+
+	return true;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	auto noReport = false;
+	auto quiet = false;
+	auto flags = new scsl::Flags("test_tlv_schema",
+				     "This test validates TLV schemas.");
+	flags->Register("-n", false, "don't print the report");
+	flags->Register("-q", false, "suppress test output");
+
+	auto parsed = flags->Parse(argc, argv);
+	if (parsed != scsl::Flags::ParseStatus::OK) {
+		std::cerr << "Failed to parse flags: "
+			  << scsl::Flags::ParseStatusToString(parsed) << "\n";
+		exit(1);
+	}
+
+	sctest::SimpleSuite suite;
+	flags->GetBool("-n", noReport);
+	flags->GetBool("-q", quiet);
+	if (quiet) {
+		suite.Silence();
+	}
+
+	suite.AddTest("RoundTrip", schemaRoundTripTest);
+	suite.AddTest("Mismatch", schemaMismatchTest);
+
+	delete flags;
+	auto result = suite.Run();
+	if (!noReport) { std::cout << suite.GetReport() << "\n"; }
+	return result ? 0 : 1;
+}
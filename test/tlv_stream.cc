@@ -0,0 +1,305 @@
+///
+/// \file test/tlv_stream.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Unit tests for TLV streams.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <scsl/Arena.h>
+#include <scsl/Flags.h>
+#include <scsl/TLV.h>
+#include <scsl/TLVStream.h>
+#include <sctest/Checks.h>
+#include <sctest/SimpleSuite.h>
+
+#include "test_fixtures.h"
+
+
+using namespace scsl;
+
+
+static const char	*streamFile = "tlv_stream_test.bin";
+
+
+/// valueFor fills val with the contents of record i, returning its length.
+/// Every 50th record is longer than TLV_MAX_LEN.
+static size_t
+valueFor(size_t i, std::vector<uint8_t> &val)
+{
+	size_t	len = (i % 50 == 0) ? 300 + i % 700 : i % 40;
+
+	val.resize(len);
+	for (size_t j = 0; j < len; j++) {
+		val[j] = static_cast<uint8_t>(i + j);
+	}
+	return len;
+}
+
+
+static bool
+writeStream(int fd, size_t records, size_t window, bool checksums)
+{
+	TLV::StreamWriter	writer(fd, window, checksums);
+	std::vector<uint8_t>	val;
+
+	for (size_t i = 0; i < records; i++) {
+		auto	len = valueFor(i, val);
+		SCTEST_CHECK_EQ(writer.Write(static_cast<uint8_t>(i % 200 + 1),
+					     val.data(), len), 0);
+	}
+	SCTEST_CHECK_EQ(writer.Sync(), 0);
+	return true;
+}
+
+
+static bool
+readStream(int fd, size_t records, size_t window, bool checksums)
+{
+	TLV::StreamReader	reader(fd, window, checksums);
+	TLV::RecordView		view;
+	std::vector<uint8_t>	val;
+	size_t			count = 0;
+
+	while (reader.Next(view)) {
+		auto	len = valueFor(count, val);
+		SCTEST_CHECK_EQ(view.Tag, count % 200 + 1);
+		SCTEST_CHECK_EQ(view.Len, len);
+		SCTEST_CHECK(TLV::ViewEquals(view, val.data(), len));
+		count++;
+	}
+
+	SCTEST_CHECK_FALSE(reader.Failed());
+	SCTEST_CHECK_EQ(count, records);
+	return true;
+}
+
+
+bool
+streamRoundTripTest()
+{
+	const size_t	records = 5000;
+
+	// Small windows make records straddle refills, and make the long
+	// records bigger than the window.
+	for (auto window : {size_t(1), size_t(64), TLV::STREAM_WINDOW}) {
+		for (auto checksums : {false, true}) {
+			int	fd = open(streamFile, O_RDWR | O_CREAT | O_TRUNC, 0644);
+			SCTEST_CHECK(fd >= 0);
+			SCTEST_CHECK(writeStream(fd, records, window, checksums));
+			SCTEST_CHECK_EQ(lseek(fd, 0, SEEK_SET), 0);
+			SCTEST_CHECK(readStream(fd, records, window, checksums));
+			close(fd);
+		}
+	}
+
+	// The file is an ordinary TLV file, so it can be loaded into an
+	// arena too.
+	Arena			arena;
+	TLV::Header		hdr;
+	std::vector<uint8_t>	val;
+	SCTEST_CHECK_EQ(arena.Open(streamFile), 0);
+	SCTEST_CHECK(TLV::Verify(arena));
+	auto *cursor = TLV::LocateValue(arena, nullptr, 51, hdr);
+	SCTEST_CHECK_NE(cursor, nullptr);
+	SCTEST_CHECK_EQ(hdr.Len, valueFor(50, val));
+	SCTEST_CHECK_EQ(memcmp(cursor + hdr.Size, val.data(), hdr.Len), 0);
+	arena.Destroy();
+
+	remove(streamFile);
+	return true;
+}
+
+
+bool
+streamArenaTest()
+{
+	Arena			arena;
+	TLV::Record		rec;
+	TLV::StreamReader	*reader;
+	const uint8_t		tags[] = {1, 3};
+	size_t			count = 0;
+
+	// An arena file, with its region header, tombstones and padding,
+	// streams back as just its live records.
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+	SCTEST_CHECK_EQ(TLV::InitRegion(arena, TLV::REGION_CHECKSUMS), 0);
+	for (uint8_t tag = 1; tag <= 3; tag++) {
+		TLV::SetRecord(rec, tag, TEST_STRLEN1, TEST_STR1);
+		SCTEST_CHECK_NE(TLV::WriteToMemory(arena, nullptr, rec), nullptr);
+	}
+	rec.Tag = 2;
+	TLV::TombstoneRecord(arena, TLV::LocateTag(arena, nullptr, rec));
+	SCTEST_CHECK_EQ(arena.Write(streamFile), 0);
+	arena.Destroy();
+
+	int	fd = open(streamFile, O_RDONLY);
+	SCTEST_CHECK(fd >= 0);
+	reader = new TLV::StreamReader(fd, 16);
+	while (reader->Next(rec)) {
+		SCTEST_CHECK(count < sizeof(tags));
+		SCTEST_CHECK_EQ(rec.Tag, tags[count]);
+		SCTEST_CHECK_EQ(rec.Len, TEST_STRLEN1);
+		SCTEST_CHECK_EQ(memcmp(rec.Val, TEST_STR1, TEST_STRLEN1), 0);
+		count++;
+	}
+	SCTEST_CHECK_FALSE(reader->Failed());
+	SCTEST_CHECK_EQ(count, sizeof(tags));
+	delete reader;
+	close(fd);
+
+	// Without a region header, the bookkeeping tags are ordinary tags.
+	// Neither is a record that only has the region header's tag and
+	// length a region header; its value isn't taken as flags.
+	const uint8_t	plain[] = {TLV::TAG_REGION, TLV::TAG_TOMBSTONE,
+				   TLV::TAG_CHECKSUM, TLV::TAG_SYNC};
+	uint8_t		fake[TLV::REGION_SIZE - 2] = {0};
+	fake[6] = TLV::REGION_CHECKSUMS | TLV::REGION_SYNC;
+	fd = open(streamFile, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	SCTEST_CHECK(fd >= 0);
+	{
+		TLV::StreamWriter	writer(fd);
+		TLV::StreamWriter	summed(fd, TLV::STREAM_WINDOW, true);
+		SCTEST_CHECK_EQ(writer.Write(TLV::TAG_REGION, fake, sizeof(fake)),
+				0);
+		for (size_t i = 1; i < sizeof(plain); i++) {
+			TLV::SetRecord(rec, plain[i], TEST_STRLEN1, TEST_STR1);
+			SCTEST_CHECK_EQ(writer.Write(rec), 0);
+		}
+		SCTEST_CHECK_EQ(writer.Sync(), 0);
+		SCTEST_CHECK_EQ(summed.Write(TLV::TAG_CHECKSUM, rec.Val, rec.Len),
+				-1);
+	}
+	SCTEST_CHECK_EQ(lseek(fd, 0, SEEK_SET), 0);
+	reader = new TLV::StreamReader(fd, 16);
+	count = 0;
+	while (reader->Next(rec)) {
+		SCTEST_CHECK(count < sizeof(plain));
+		SCTEST_CHECK_EQ(rec.Tag, plain[count]);
+		count++;
+	}
+	SCTEST_CHECK_FALSE(reader->Failed());
+	SCTEST_CHECK_EQ(count, sizeof(plain));
+	delete reader;
+	close(fd);
+
+	remove(streamFile);
+	return true;
+}
+
+
+bool
+streamCorruptionTest()
+{
+	const off_t	damaged = 1000;
+	TLV::RecordView	view;
+	uint8_t		byte;
+	size_t		count = 0;
+	int		fd;
+
+	fd = open(streamFile, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	SCTEST_CHECK(fd >= 0);
+	SCTEST_CHECK(writeStream(fd, 100, 256, true));
+
+	// A flipped bit stops the reader before the damaged record.
+	SCTEST_CHECK_EQ(pread(fd, &byte, 1, damaged), 1);
+	byte ^= 0x01;
+	SCTEST_CHECK_EQ(pwrite(fd, &byte, 1, damaged), 1);
+	SCTEST_CHECK_EQ(lseek(fd, 0, SEEK_SET), 0);
+	{
+		TLV::StreamReader	reader(fd, 64, true);
+		while (reader.Next(view)) {
+			count++;
+		}
+		SCTEST_CHECK(reader.Failed());
+		SCTEST_CHECK(reader.Offset() < damaged);
+	}
+	SCTEST_CHECK(count > 0);
+	byte ^= 0x01;
+	SCTEST_CHECK_EQ(pwrite(fd, &byte, 1, damaged), 1);
+
+	// So does a checksum cut off by the end of the file.
+	struct stat	st;
+	SCTEST_CHECK_EQ(fstat(fd, &st), 0);
+	SCTEST_CHECK_EQ(ftruncate(fd, st.st_size - 3), 0);
+	SCTEST_CHECK_EQ(lseek(fd, 0, SEEK_SET), 0);
+	{
+		TLV::StreamReader	reader(fd, 64, true);
+		count = 0;
+		while (reader.Next(view)) {
+			count++;
+		}
+		SCTEST_CHECK(reader.Failed());
+		SCTEST_CHECK_EQ(count, 99);
+	}
+	close(fd);
+	remove(streamFile);
+
+	// Streams don't need to be seekable.
+	int	pipefd[2];
+	SCTEST_CHECK_EQ(pipe(pipefd), 0);
+	SCTEST_CHECK(writeStream(pipefd[1], 100, 128, false));
+	close(pipefd[1]);
+	SCTEST_CHECK(readStream(pipefd[0], 100, 128, false));
+	close(pipefd[0]);
+	return true;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	auto noReport = false;
+	auto quiet = false;
+	auto flags = new scsl::Flags("test_tlv_stream",
+				     "This test validates TLV streams.");
+	flags->Register("-n", false, "don't print the report");
+	flags->Register("-q", false, "suppress test output");
+
+	auto parsed = flags->Parse(argc, argv);
+	if (parsed != scsl::Flags::ParseStatus::OK) {
+		std::cerr << "Failed to parse flags: "
+			  << scsl::Flags::ParseStatusToString(parsed) << "\n";
+		exit(1);
+	}
+
+	sctest::SimpleSuite suite;
+	flags->GetBool("-n", noReport);
+	flags->GetBool("-q", quiet);
+	if (quiet) {
+		suite.Silence();
+	}
+
+	suite.AddTest("streamRoundTripTest", streamRoundTripTest);
+	suite.AddTest("streamArenaTest", streamArenaTest);
+	suite.AddTest("streamCorruptionTest", streamCorruptionTest);
+
+	delete flags;
+	auto result = suite.Run();
+	if (!noReport) { std::cout << suite.GetReport() << "\n"; }
+	return result ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+///
+/// \file test/tlv_types.cc
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2023-10-06
+/// \brief Unit tests for typed TLV values.
+///
+/// \section COPYRIGHT
+///
+/// Copyright 2023 K. Isom <kyle@imap.cc>
+///
+/// Permission to use, copy, modify, and/or distribute this software for
+/// any purpose with or without fee is hereby granted, provided that the
+/// above copyright notice and this permission notice appear in all copies.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL
+/// WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR
+/// BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES
+/// OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+/// WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+/// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS
+/// SOFTWARE.
+///
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include <scsl/Arena.h>
+#include <scsl/Flags.h>
+#include <scsl/TLV.h>
+#include <scsl/TLVTypes.h>
+#include <sctest/Checks.h>
+#include <sctest/SimpleSuite.h>
+
+
+using namespace scsl;
+
+
+bool
+varintTest()
+{
+	uint8_t		buf[TLV::VARINT_MAX + 1];
+	uint64_t	value;
+	const struct {
+		uint64_t	value;
+		size_t		size;
+	} cases[] = {
+		{0, 1},
+		{127, 1},
+		{128, 2},
+		{300, 2},
+		{16383, 2},
+		{16384, 3},
+		{0xffffffff, 5},
+		{std::numeric_limits<uint64_t>::max(), TLV::VARINT_MAX},
+	};
+
+	for (auto &c : cases) {
+		SCTEST_CHECK_EQ(TLV::EncodeVarint(buf, c.value), c.size);
+		SCTEST_CHECK_EQ(TLV::DecodeVarint(buf, c.size, value), c.size);
+		SCTEST_CHECK_EQ(value, c.value);
+
+		// A varint cut short isn't decoded.
+		SCTEST_CHECK_EQ(TLV::DecodeVarint(buf, c.size - 1, value), 0);
+	}
+
+	// 300 is the example from the protobuf encoding guide.
+	TLV::EncodeVarint(buf, 300);
+	SCTEST_CHECK_EQ(buf[0], 0xac);
+	SCTEST_CHECK_EQ(buf[1], 0x02);
+
+	// Values past 64 bits are rejected.
+	memset(buf, 0xff, sizeof(buf));
+	SCTEST_CHECK_EQ(TLV::DecodeVarint(buf, sizeof(buf), value), 0);
+	buf[TLV::VARINT_MAX - 1] = 0x02;
+	SCTEST_CHECK_EQ(TLV::DecodeVarint(buf, sizeof(buf), value), 0);
+
+	const int64_t	zigzag[][2] = {
+		{0, 0}, {-1, 1}, {1, 2}, {-2, 3}, {2147483647, 4294967294},
+		{-2147483648LL, 4294967295},
+	};
+	for (auto &z : zigzag) {
+		SCTEST_CHECK_EQ(TLV::ZigZagEncode(z[0]), static_cast<uint64_t>(z[1]));
+		SCTEST_CHECK_EQ(TLV::ZigZagDecode(static_cast<uint64_t>(z[1])), z[0]);
+	}
+	for (auto v : {std::numeric_limits<int64_t>::min(),
+		       std::numeric_limits<int64_t>::max()}) {
+		SCTEST_CHECK_EQ(TLV::ZigZagDecode(TLV::ZigZagEncode(v)), v);
+	}
+
+	return true;
+}
+
+
+bool
+typedRecordTest()
+{
+	Arena		arena;
+	TLV::RecordView	view;
+	uint8_t		u8;
+	uint16_t	u16;
+	uint32_t	u32;
+	uint64_t	u64;
+	int64_t		i64;
+	float		f;
+	double		d;
+
+	SCTEST_CHECK_EQ(arena.SetAlloc(4096), 0);
+	SCTEST_CHECK_NE(TLV::WriteU8(arena, nullptr, 1, 0xa5), nullptr);
+	SCTEST_CHECK_NE(TLV::WriteU16(arena, nullptr, 2, 0xbeef), nullptr);
+	SCTEST_CHECK_NE(TLV::WriteU32(arena, nullptr, 3, 0xdeadbeef), nullptr);
+	SCTEST_CHECK_NE(TLV::WriteU64(arena, nullptr, 4, 0x0123456789abcdef),
+			nullptr);
+	SCTEST_CHECK_NE(TLV::WriteVarint(arena, nullptr, 5, 300), nullptr);
+	SCTEST_CHECK_NE(TLV::WriteSigned(arena, nullptr, 6, -1), nullptr);
+	SCTEST_CHECK_NE(TLV::WriteFloat(arena, nullptr, 7, 1.5f), nullptr);
+	SCTEST_CHECK_NE(TLV::WriteDouble(arena, nullptr, 8, -0.1), nullptr);
+	SCTEST_CHECK_NE(TLV::WriteDouble(arena, nullptr, 9,
+					 std::numeric_limits<double>::infinity()),
+			nullptr);
+
+	// Fixed-width values are stored little-endian.
+	auto	*cursor = arena.Start();
+	auto	*next = TLV::ReadView(arena, cursor, view);
+	SCTEST_CHECK(TLV::ReadU8(view, u8));
+	SCTEST_CHECK_EQ(u8, 0xa5);
+	cursor = next;
+	next = TLV::ReadView(arena, cursor, view);
+	SCTEST_CHECK_EQ(view.Len, 2);
+	SCTEST_CHECK_EQ(view.Val[0], 0xef);
+	SCTEST_CHECK(TLV::ReadU16(view, u16));
+	SCTEST_CHECK_EQ(u16, 0xbeef);
+
+	// The wrong width doesn't decode.
+	SCTEST_CHECK_FALSE(TLV::ReadU32(view, u32));
+	SCTEST_CHECK_FALSE(TLV::ReadU8(view, u8));
+
+	next = TLV::ReadView(arena, next, view);
+	SCTEST_CHECK(TLV::ReadU32(view, u32));
+	SCTEST_CHECK_EQ(u32, 0xdeadbeef);
+	next = TLV::ReadView(arena, next, view);
+	SCTEST_CHECK(TLV::ReadU64(view, u64));
+	SCTEST_CHECK_EQ(u64, 0x0123456789abcdef);
+
+	// Small varints take less space than their fixed-width versions.
+	next = TLV::ReadView(arena, next, view);
+	SCTEST_CHECK_EQ(view.Len, 2);
+	SCTEST_CHECK(TLV::ReadVarint(view, u64));
+	SCTEST_CHECK_EQ(u64, 300);
+	next = TLV::ReadView(arena, next, view);
+	SCTEST_CHECK_EQ(view.Len, 1);
+	SCTEST_CHECK(TLV::ReadSigned(view, i64));
+	SCTEST_CHECK_EQ(i64, -1);
+
+	next = TLV::ReadView(arena, next, view);
+	SCTEST_CHECK(TLV::ReadFloat(view, f));
+	SCTEST_CHECK_EQ(f, 1.5f);
+	next = TLV::ReadView(arena, next, view);
+	SCTEST_CHECK(TLV::ReadDouble(view, d));
+	SCTEST_CHECK_EQ(d, -0.1);
+	next = TLV::ReadView(arena, next, view);
+	SCTEST_CHECK(TLV::ReadDouble(view, d));
+	SCTEST_CHECK(std::isinf(d));
+
+	// A varint with trailing bytes isn't a varint value.
+	const uint8_t	padded[] = {0x01, 0x00};
+	view.Val = padded;
+	view.Len = sizeof(padded);
+	SCTEST_CHECK_FALSE(TLV::ReadVarint(view, u64));
+	view.Len = 0;
+	SCTEST_CHECK_FALSE(TLV::ReadVarint(view, u64));
+
+	arena.Destroy();
+	return true;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	auto noReport = false;
+	auto quiet = false;
+	auto flags = new scsl::Flags("test_tlv_types",
+				     "This test validates typed TLV values.");
+	flags->Register("-n", false, "don't print the report");
+	flags->Register("-q", false, "suppress test output");
+
+	auto parsed = flags->Parse(argc, argv);
+	if (parsed != scsl::Flags::ParseStatus::OK) {
+		std::cerr << "Failed to parse flags: "
+			  << scsl::Flags::ParseStatusToString(parsed) << "\n";
+		exit(1);
+	}
+
+	sctest::SimpleSuite suite;
+	flags->GetBool("-n", noReport);
+	flags->GetBool("-q", quiet);
+	if (quiet) {
+		suite.Silence();
+	}
+
+	suite.AddTest("Varints", varintTest);
+	suite.AddTest("TypedRecords", typedRecordTest);
+
+	delete flags;
+	auto result = suite.Run();
+	if (!noReport) { std::cout << suite.GetReport() << "\n"; }
+	return result ? 0 : 1;
+}